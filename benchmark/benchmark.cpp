@@ -0,0 +1,1086 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <gl_handle.h>
+#include <camera.h>
+#include <model.h>
+#include <scene.h>
+#include <model_loader.h>
+#include <model_cache.h>
+#include <mesh_optimizer.h>
+#include <vertex_format.h>
+#include <texture_cache.h>
+#include <material_table.h>
+#include <sampler_cache.h>
+#include <texture_packer.h>
+#include <texture_streamer.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Settings
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+const int FRAMES = 100;
+
+// Directory of the executable, resources and shaders are found relative to it
+std::string dir;
+
+/**
+ * Runs a function a number of times and returns the average time in
+ * milliseconds. The GL pipeline is flushed before the timer is stopped
+ * so that deferred driver work is included.
+ *
+ * @param frames The number of times to run the function
+ * @param frame The function to time
+ * 
+ * @returns The average time per call in milliseconds
+ */
+double timeFrames(int frames, const std::function<void()>& frame) {
+    glFinish();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < frames; i++) {
+        frame();
+    }
+    glFinish();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+}
+
+/**
+ * Compares the per-frame cost of uploading the scene uniforms by name
+ * with uploading them through pre-resolved handles.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void uniformBenchmark(int count) {
+    Shader shader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Model model(dir + "/resources/objects/backpack/backpack.obj");
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+
+    std::vector<glm::mat4> matrices;
+    for (int i = 0; i < count; i++) {
+        matrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(i % 100, i / 100, 0.0f)));
+    }
+    const std::vector<Mesh>& meshes = model.GetMeshes();
+
+    // Uniform upload as it was done before the location cache
+    auto byName = [&]() {
+        for (int i = 0; i < count; i++) {
+            glUseProgram(shader.ID);
+            glUniform3fv(glGetUniformLocation(shader.ID, "viewPos"), 1, &camera.Position[0]);
+            glUniformMatrix4fv(glGetUniformLocation(shader.ID, "view"), 1, GL_FALSE, &view[0][0]);
+            glUniformMatrix4fv(glGetUniformLocation(shader.ID, "projection"), 1, GL_FALSE, &projection[0][0]);
+            glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, &matrices[i][0][0]);
+            for (const auto& mesh : meshes) {
+                unsigned int diffuseNr = 1;
+                unsigned int specularNr = 1;
+                for (unsigned int t = 0; t < mesh.textures.size(); t++) {
+                    std::string number;
+                    std::string name = mesh.textures[t].type;
+                    if (name == "texture_diffuse") {
+                        number = std::to_string(diffuseNr++);
+                    } else if (name == "texture_specular") {
+                        number = std::to_string(specularNr++);
+                    }
+                    glUniform1i(glGetUniformLocation(shader.ID, ("material." + name + number).c_str()), t);
+                }
+            }
+        }
+    };
+
+    // Uniform upload through handles resolved once up front
+    SceneUniforms uniforms;
+    uniforms.model = shader.GetUniform<glm::mat4>("model");
+    uniforms.view = shader.GetUniform<glm::mat4>("view");
+    uniforms.projection = shader.GetUniform<glm::mat4>("projection");
+    uniforms.viewPos = shader.GetUniform<glm::vec3>("viewPos");
+    std::vector<std::vector<UniformHandle<int>>> samplers;
+    for (const auto& mesh : meshes) {
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
+        std::vector<UniformHandle<int>> handles;
+        for (const auto& texture : mesh.textures) {
+            std::string number;
+            if (texture.type == "texture_diffuse") {
+                number = std::to_string(diffuseNr++);
+            } else if (texture.type == "texture_specular") {
+                number = std::to_string(specularNr++);
+            }
+            handles.push_back(shader.GetUniform<int>("material." + texture.type + number));
+        }
+        samplers.push_back(handles);
+    }
+    auto byHandle = [&]() {
+        for (int i = 0; i < count; i++) {
+            shader.use();
+            shader.set(uniforms.viewPos, camera.Position);
+            shader.set(uniforms.view, view);
+            shader.set(uniforms.projection, projection);
+            shader.set(uniforms.model, matrices[i]);
+            for (const auto& handles : samplers) {
+                for (unsigned int t = 0; t < handles.size(); t++) {
+                    shader.set(handles[t], (int)t);
+                }
+            }
+        }
+    };
+
+    double nameTime = timeFrames(FRAMES, byName);
+    double handleTime = timeFrames(FRAMES, byHandle);
+    std::cout << "Uniform upload, " << count << " models x " << meshes.size() << " meshes" << std::endl;
+    std::cout << "  by name:   " << nameTime << " ms/frame" << std::endl;
+    std::cout << "  by handle: " << handleTime << " ms/frame" << std::endl;
+}
+
+/**
+ * Measures the per-frame cost of updating and drawing a scene where
+ * every model shares the same model and shader.
+ *
+ * @param count The number of models in the scene
+ * @param vertexShader The name of the vertex shader to draw with
+ * @param multiDrawIndirect true to draw from the geometry pool with multi-draw indirect
+ * 
+ * @returns void
+ */
+void drawScene(int count, const std::string& vertexShader, bool multiDrawIndirect = false) {
+    Shader shader((dir + "/shaders/" + vertexShader).c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Model model(dir + "/resources/objects/backpack/backpack.obj");
+    Camera camera(glm::vec3(50.0f, 25.0f, 60.0f));
+
+    Scene scene;
+    scene.SetCamera(&camera);
+    scene.SetMultiDrawIndirect(multiDrawIndirect);
+    for (int i = 0; i < count; i++) {
+        glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3((i % 100) * 4.0f, (i / 100) * 4.0f, 0.0f));
+        scene.AddModel(&model, matrix, &shader);
+    }
+
+    double frameTime = timeFrames(FRAMES, [&]() {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+        scene.Draw();
+    });
+    std::cout << "Scene draw with " << vertexShader << (multiDrawIndirect ? " (multi-draw indirect)" : "") << ", " << count << " models x " << model.GetMeshes().size() << " meshes" << std::endl;
+    std::cout << "  frame: " << frameTime << " ms/frame" << std::endl;
+
+    const RenderStats& stats = scene.GetRenderStats();
+    std::cout << "  draw calls:         " << stats.drawCalls << std::endl;
+    std::cout << "  program changes:    " << stats.programChanges << std::endl;
+    std::cout << "  texture binds:      " << stats.textureBinds << std::endl;
+    std::cout << "  sampler binds:      " << stats.samplerBinds << std::endl;
+    std::cout << "  vertex array binds: " << stats.vertexArrayBinds << std::endl;
+    std::cout << "  buffer range binds: " << stats.bufferRangeBinds << std::endl;
+    std::cout << "  uniform uploads:    " << stats.uniformUploads << std::endl;
+    std::cout << "  redundant skipped:  " << stats.redundantChanges << std::endl;
+}
+
+/**
+ * Draws a scene with one draw call per mesh and model.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void sceneBenchmark(int count) {
+    drawScene(count, "light_shader.vs");
+}
+
+/**
+ * Draws a scene with one instanced draw call per mesh.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void instancingBenchmark(int count) {
+    drawScene(count, "light_shader_instanced.vs");
+}
+
+/**
+ * Draws a scene from the geometry pool with multi-draw indirect.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void multiDrawBenchmark(int count) {
+    drawScene(count, "light_shader_instanced.vs", true);
+}
+
+/**
+ * Draws a scene with textures bound per mesh, then with the material
+ * table in texture array mode and in bindless mode if the driver
+ * supports it.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void materialsBenchmark(int count) {
+    std::cout << "Textures bound per mesh" << std::endl;
+    drawScene(count, "light_shader.vs");
+
+    MaterialTable::Enable((GLADloadproc)glfwGetProcAddress, false);
+    std::cout << "Material table with texture arrays" << std::endl;
+    drawScene(count, "light_shader.vs");
+    MaterialStats stats = MaterialTable::GetStats();
+    std::cout << "  " << stats.materials << " materials, " << stats.arrayLayers << " layers in " << stats.arrays << " arrays, "
+        << stats.missingTextures << " textures left out" << std::endl;
+
+    if (MaterialTable::IsBindlessSupported()) {
+        MaterialTable::Enable((GLADloadproc)glfwGetProcAddress, true);
+        std::cout << "Material table with bindless textures" << std::endl;
+        drawScene(count, "light_shader.vs");
+        std::cout << "  " << MaterialTable::GetStats().residentHandles << " resident handles" << std::endl;
+    } else {
+        std::cout << "Bindless textures are not supported" << std::endl;
+    }
+    MaterialTable::Disable();
+}
+
+/**
+ * Draws a scene with the textures of the model as they were loaded, then
+ * packed into texture arrays and atlases, and reports what the packing
+ * did to the model.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void packingBenchmark(int count) {
+    std::cout << "Textures as loaded" << std::endl;
+    drawScene(count, "light_shader.vs");
+
+    TexturePacker::SetEnabled(true);
+    std::cout << "Packed textures" << std::endl;
+    drawScene(count, "light_shader.vs");
+    Model model(dir + "/resources/objects/backpack/backpack.obj");
+    const TexturePackingStats& stats = model.GetTexturePackingStats();
+    std::cout << "  " << stats.arrayLayers << " layers in " << stats.arrays << " arrays, "
+        << stats.atlasTextures << " textures in " << stats.atlases << " atlases, "
+        << stats.texturesReleased << " textures released" << std::endl;
+    std::cout << "  binds per pass over the materials: " << stats.bindsBefore << " -> " << stats.bindsAfter << std::endl;
+    TexturePacker::SetEnabled(false);
+}
+
+/**
+ * Measures the cost of culling the bounds of many objects spread around
+ * the camera against the view frustum.
+ *
+ * @param count The number of objects to cull
+ * 
+ * @returns void
+ */
+void cullingBenchmark(int count) {
+    Camera camera(glm::vec3(0.0f, 0.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    Frustum frustum;
+    frustum.Extract(projection * camera.GetViewMatrix());
+
+    BoundsArray bounds;
+    srand(0);
+    for (int i = 0; i < count; i++) {
+        glm::vec3 center(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f);
+        bounds.Add(center, glm::vec3(1.0f));
+    }
+
+    std::vector<uint8_t> results;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < FRAMES; i++) {
+        bounds.Cull(frustum, results);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double cullTime = std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+
+    int visible = 0;
+    for (uint8_t result : results) {
+        visible += result != CULL_OUTSIDE;
+    }
+    std::cout << "Frustum culling, " << count << " objects" << std::endl;
+    std::cout << "  cull:    " << cullTime << " ms/frame" << std::endl;
+    std::cout << "  visible: " << visible << std::endl;
+}
+
+/**
+ * Compares picking through the scene's BVH with testing the ray against
+ * every model in turn.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void pickingBenchmark(int count) {
+    Shader shader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Model model(dir + "/resources/objects/backpack/backpack.obj");
+    Camera camera(glm::vec3(0.0f, 0.0f, 0.0f));
+
+    Scene scene;
+    scene.SetCamera(&camera);
+    srand(0);
+    for (int i = 0; i < count; i++) {
+        glm::vec3 position(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f);
+        scene.AddModel(&model, glm::translate(glm::mat4(1.0f), position), &shader);
+    }
+    scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+
+    const int PICKS = 1000;
+    std::vector<glm::ivec2> positions(PICKS);
+    for (auto& position : positions) {
+        position = glm::ivec2(rand() % SCR_WIDTH, rand() % SCR_HEIGHT);
+    }
+
+    // The first pick builds the BVH
+    auto start = std::chrono::high_resolution_clock::now();
+    scene.Pick(0, 0);
+    auto end = std::chrono::high_resolution_clock::now();
+    double buildTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+    int bvhHits = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (const auto& position : positions) {
+        bvhHits += scene.Pick(position.x, position.y) >= 0;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double bvhTime = std::chrono::duration<double, std::micro>(end - start).count() / PICKS;
+
+    int linearHits = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (const auto& position : positions) {
+        glm::vec3 origin, direction;
+        scene.ScreenPosToWorldRay(position.x, position.y, SCR_WIDTH, SCR_HEIGHT, origin, direction);
+        float nearest = FLT_MAX;
+        int picked = -1;
+        for (int i = 0; i < count; i++) {
+            float distance;
+            if (scene.IsRayOBBIntersecting(origin, direction, scene.GetModel(i).modelMatrix,
+                model.GetMinCoords(), model.GetMaxCoords(), distance) && distance < nearest) {
+                nearest = distance;
+                picked = i;
+            }
+        }
+        linearHits += picked >= 0;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double linearTime = std::chrono::duration<double, std::micro>(end - start).count() / PICKS;
+
+    std::cout << "Picking, " << count << " models" << std::endl;
+    std::cout << "  bvh build: " << buildTime << " ms" << std::endl;
+    std::cout << "  bvh:       " << bvhTime << " us/pick (" << bvhHits << " hits)" << std::endl;
+    std::cout << "  linear:    " << linearTime << " us/pick (" << linearHits << " hits)" << std::endl;
+}
+
+/**
+ * Compares ray casts against the triangles of a model through triangle
+ * BVHs with testing every triangle. The rays are aimed at random points
+ * inside the bounds of the model.
+ *
+ * @param count The number of rays to cast
+ * 
+ * @returns void
+ */
+void raycastBenchmark(int count) {
+    // Testing every triangle and building the BVHs after loading need the CPU copies
+    Mesh::SetKeepCPUData(true);
+    Model model(dir + "/resources/objects/backpack/backpack.obj");
+    Model bvhModel(dir + "/resources/objects/backpack/backpack.obj");
+    Mesh::SetKeepCPUData(false);
+    size_t triangles = 0;
+    for (const auto& mesh : model.GetMeshes()) {
+        triangles += mesh.GetIndexCount() / 3;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    bvhModel.BuildBVH();
+    auto end = std::chrono::high_resolution_clock::now();
+    double buildTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+    srand(0);
+    glm::vec3 center = (model.GetMinCoords() + model.GetMaxCoords()) * 0.5f;
+    glm::vec3 size = model.GetMaxCoords() - model.GetMinCoords();
+    float radius = glm::length(size);
+    std::vector<glm::vec3> origins(count), directions(count);
+    for (int i = 0; i < count; i++) {
+        glm::vec3 direction = glm::normalize(glm::vec3(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f) + 0.01f);
+        glm::vec3 target = model.GetMinCoords() + size * glm::vec3(rand() % 100, rand() % 100, rand() % 100) / 100.0f;
+        origins[i] = center - direction * radius;
+        directions[i] = glm::normalize(target - origins[i]);
+    }
+
+    auto timeRays = [&](const Model& target, int rays, int& hits_out) {
+        hits_out = 0;
+        auto rayStart = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < rays; i++) {
+            RaycastHit hit;
+            hits_out += target.Raycast(origins[i], directions[i], hit);
+        }
+        auto rayEnd = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::micro>(rayEnd - rayStart).count() / rays;
+    };
+    int bvhHits, linearHits;
+    double bvhTime = timeRays(bvhModel, count, bvhHits);
+    int linearRays = std::min(count, 100);
+    double linearTime = timeRays(model, linearRays, linearHits);
+
+    std::cout << "Ray casts, " << count << " rays against " << triangles << " triangles" << std::endl;
+    std::cout << "  bvh build: " << buildTime << " ms" << std::endl;
+    std::cout << "  bvh:       " << bvhTime << " us/ray (" << bvhHits << " hits)" << std::endl;
+    std::cout << "  linear:    " << linearTime << " us/ray (" << linearHits << " hits of " << linearRays << ")" << std::endl;
+}
+
+/**
+ * Compares loading models on the render thread with loading them through
+ * a ModelLoader. For the loader the time until all models are ready and
+ * the longest time a frame spent in Update are reported.
+ *
+ * @param count The number of models to load
+ * 
+ * @returns void
+ */
+void loadingBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; i++) {
+        Model model(path);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double syncTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+    ModelLoader loader;
+    std::vector<std::shared_ptr<Model>> models;
+    double longestFrame = 0.0;
+    int frames = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; i++) {
+        models.push_back(loader.LoadAsync(path));
+    }
+    while (loader.GetPendingCount() > 0) {
+        auto frameStart = std::chrono::high_resolution_clock::now();
+        loader.Update(2.0);
+        auto frameEnd = std::chrono::high_resolution_clock::now();
+        longestFrame = std::max(longestFrame, std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        frames++;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double asyncTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+    std::cout << "Model loading, " << count << " models" << std::endl;
+    std::cout << "  render thread: " << syncTime << " ms blocked" << std::endl;
+    std::cout << "  loader:        " << asyncTime << " ms until ready over " << frames << " updates" << std::endl;
+    std::cout << "  longest update: " << longestFrame << " ms" << std::endl;
+}
+
+/**
+ * Compares loading a model through Assimp with loading it from its
+ * cooked file. Texture decoding and uploads are included in all times.
+ *
+ * @param count The number of times to load the model for each case
+ * 
+ * @returns void
+ */
+void cacheBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    auto timeLoads = [&](int loads) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < loads; i++) {
+            Model model(path);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / loads;
+    };
+
+    ModelCache::SetEnabled(false);
+    double assimpTime = timeLoads(count);
+
+    ModelCache::SetEnabled(true);
+    std::error_code error;
+    std::filesystem::remove(ModelCache::GetCachePath(path), error);
+    double cookTime = timeLoads(1);
+    double cookedTime = timeLoads(count);
+
+    std::cout << "Model cache, " << count << " loads" << std::endl;
+    std::cout << "  assimp:       " << assimpTime << " ms/load" << std::endl;
+    std::cout << "  first cooked: " << cookTime << " ms (assimp and write)" << std::endl;
+    std::cout << "  cooked:       " << cookedTime << " ms/load" << std::endl;
+    std::cout << "  cooked size:  " << std::filesystem::file_size(ModelCache::GetCachePath(path), error) / 1024 << " KiB" << std::endl;
+}
+
+/**
+ * Reports the decode and upload time of each texture of a model loaded
+ * on the render thread and through a ModelLoader, which stages the
+ * uploads through its pixel buffer ring. The models share their
+ * textures, so only the first model decodes and uploads them.
+ *
+ * @param count The number of models to load for each case
+ * 
+ * @returns void
+ */
+void texturesBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    auto printTimings = [](const char* name, const Model& model, double totalTime) {
+        std::cout << "  " << name << ": " << totalTime << " ms until ready, "
+            << TextureCache::GetTextureCount() << " textures in use" << std::endl;
+        for (const TextureTiming& timing : model.GetTextureTimings()) {
+            std::cout << "    " << timing.path << " " << timing.width << "x" << timing.height
+                << " decode " << timing.decodeMilliseconds << " ms, upload " << timing.uploadMilliseconds << " ms"
+                << (timing.staged ? " (staged)" : "") << std::endl;
+        }
+    };
+
+    std::cout << "Texture loading, " << count << " models" << std::endl;
+
+    std::vector<std::unique_ptr<Model>> syncModels;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; i++) {
+        syncModels.push_back(std::make_unique<Model>(path));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    printTimings("render thread", *syncModels.front(), std::chrono::duration<double, std::milli>(end - start).count());
+    syncModels.clear();
+
+    ModelLoader loader;
+    std::vector<std::shared_ptr<Model>> models;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; i++) {
+        models.push_back(loader.LoadAsync(path));
+    }
+    while (loader.GetPendingCount() > 0) {
+        loader.Update(2.0);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    printTimings("loader", *models.front(), std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+/**
+ * Gets the memory used by a texture and all its mip levels, as reported
+ * by the driver for the internal format of each level.
+ *
+ * @param texture The texture to measure
+ * 
+ * @returns The size in bytes
+ */
+size_t getTextureMemory(GLuint texture) {
+    size_t size = 0;
+    for (GLint level = 0; level < 16; level++) {
+        GLint width = 0;
+        GLint height = 0;
+        GLint compressed = 0;
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &width);
+        if (width == 0) {
+            break;
+        }
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &height);
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed) {
+            GLint levelSize = 0;
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelSize);
+            size += levelSize;
+        } else {
+            GLint bits = 0;
+            for (GLenum channel : {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE}) {
+                GLint channelBits = 0;
+                glGetTextureLevelParameteriv(texture, level, channel, &channelBits);
+                bits += channelBits;
+            }
+            size += (size_t)width * height * bits / 8;
+        }
+    }
+    return size;
+}
+
+/**
+ * Compares the backpack with its images decoded to uncompressed textures
+ * against the backpack with the KTX2 or DDS files next to the images.
+ * Reports the texture memory and the frame time of drawing the model in
+ * count layers that all pass the depth test, which is bound by texture
+ * sampling.
+ *
+ * @param count The number of layers to draw
+ * 
+ * @returns void
+ */
+void compressionBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    Shader shader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+
+    std::cout << "Texture compression, " << count << " layers" << std::endl;
+    auto measure = [&](const char* name, bool compressed) {
+        TextureCache::SetCompressedEnabled(compressed);
+        Model model(path);
+        std::vector<GLuint> textures;
+        for (const Mesh& mesh : model.GetMeshes()) {
+            for (const Texture& texture : mesh.textures) {
+                if (std::find(textures.begin(), textures.end(), texture.id) == textures.end()) {
+                    textures.push_back(texture.id);
+                }
+            }
+        }
+        size_t memory = 0;
+        int compressedCount = 0;
+        for (GLuint texture : textures) {
+            GLint isCompressed = 0;
+            glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_COMPRESSED, &isCompressed);
+            compressedCount += isCompressed;
+            memory += getTextureMemory(texture);
+        }
+
+        Scene scene;
+        scene.SetCamera(&camera);
+        for (int i = 0; i < count; i++) {
+            scene.AddModel(&model, glm::mat4(1.0f), &shader);
+        }
+        glDepthFunc(GL_ALWAYS);
+        double frameTime = timeFrames(FRAMES, [&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+            scene.Draw();
+        });
+        glDepthFunc(GL_LESS);
+
+        std::cout << "  " << name << ": " << memory / 1024 << " KiB in " << textures.size() << " textures ("
+            << compressedCount << " compressed), " << frameTime << " ms/frame" << std::endl;
+        return compressedCount;
+    };
+
+    measure("uncompressed", false);
+    if (measure("compressed  ", true) == 0) {
+        std::cout << "  no KTX2 or DDS files were found next to the backpack textures" << std::endl;
+    }
+    TextureCache::SetCompressedEnabled(true);
+}
+
+/**
+ * Compares the backpack as Assimp imports it with its meshes optimized
+ * for the vertex cache and overdraw. Reports the import time, the ACMR
+ * and ATVR of each mesh and the frame time of drawing the model count
+ * times, which is bound by vertex processing at this size.
+ *
+ * @param count The number of models to draw
+ * 
+ * @returns void
+ */
+void optimizerBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    Shader shader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+
+    std::cout << "Mesh optimization, " << count << " models" << std::endl;
+    ModelCache::SetEnabled(false);
+    for (bool optimized : {false, true}) {
+        MeshOptimizer::SetEnabled(optimized);
+        auto start = std::chrono::high_resolution_clock::now();
+        Model model(path);
+        auto end = std::chrono::high_resolution_clock::now();
+        double loadTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+        Scene scene;
+        scene.SetCamera(&camera);
+        glm::mat4 modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(0.05f));
+        for (int i = 0; i < count; i++) {
+            scene.AddModel(&model, modelMatrix, &shader);
+        }
+        double frameTime = timeFrames(FRAMES, [&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+            scene.Draw();
+        });
+
+        std::cout << "  " << (optimized ? "optimized" : "as imported") << ": " << loadTime << " ms import, "
+            << frameTime << " ms/frame" << std::endl;
+        if (optimized) {
+            const std::vector<MeshOptimizationStats>& stats = model.GetMeshOptimizationStats();
+            for (size_t i = 0; i < stats.size(); i++) {
+                std::cout << "    mesh " << i << ": ACMR " << stats[i].acmrBefore << " -> " << stats[i].acmrAfter
+                    << ", ATVR " << stats[i].atvrBefore << " -> " << stats[i].atvrAfter << std::endl;
+            }
+        }
+    }
+    ModelCache::SetEnabled(true);
+}
+
+/**
+ * Imports the backpack count times with each weld mode and reports the
+ * average import time and the vertex count of each mesh before and
+ * after welding, with the cooked model files disabled.
+ *
+ * @param count The number of times to import the model
+ * 
+ * @returns void
+ */
+void weldingBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    const char* names[] = {"none", "exact", "epsilon"};
+
+    std::cout << "Vertex welding, " << count << " imports" << std::endl;
+    ModelCache::SetEnabled(false);
+    for (WeldMode mode : {WELD_NONE, WELD_EXACT, WELD_EPSILON}) {
+        MeshOptimizer::SetWeldMode(mode);
+        std::vector<MeshOptimizationStats> stats;
+        double loadTime = 0.0;
+        for (int i = 0; i < count; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            Model model(path);
+            auto end = std::chrono::high_resolution_clock::now();
+            loadTime += std::chrono::duration<double, std::milli>(end - start).count();
+            stats = model.GetMeshOptimizationStats();
+        }
+
+        size_t before = 0;
+        size_t after = 0;
+        for (const MeshOptimizationStats& mesh : stats) {
+            before += mesh.verticesBefore;
+            after += mesh.verticesAfter;
+        }
+        std::cout << "  " << names[mode] << ": " << loadTime / count << " ms import, " << before << " -> "
+            << after << " vertices" << std::endl;
+        for (size_t i = 0; i < stats.size(); i++) {
+            std::cout << "    mesh " << i << ": " << stats[i].verticesBefore << " -> " << stats[i].verticesAfter
+                << " vertices" << std::endl;
+        }
+    }
+    MeshOptimizer::SetWeldMode(WELD_EXACT);
+    ModelCache::SetEnabled(true);
+}
+
+/**
+ * Draws the backpack count times with its meshes uploaded in each vertex
+ * layout. The models are scaled down so that the frame time is bound by
+ * vertex fetch and processing rather than by pixels. Reports the size of
+ * the vertex buffers and the frame time of each layout.
+ *
+ * @param count The number of models to draw
+ * 
+ * @returns void
+ */
+void vertexLayoutBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    Shader shader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    const char* names[] = {"float", "quantized, 8-bit normals", "quantized, 16-bit normals"};
+
+    std::cout << "Vertex layouts, " << count << " models" << std::endl;
+    for (VertexLayout layout : {VERTEX_LAYOUT_FLOAT, VERTEX_LAYOUT_QUANTIZED_OCT8, VERTEX_LAYOUT_QUANTIZED_OCT16}) {
+        VertexFormat::SetLayout(layout);
+        Model model(path);
+        size_t vertexMemory = 0;
+        for (const Mesh& mesh : model.GetMeshes()) {
+            vertexMemory += (size_t)mesh.GetVertexCount() * (mesh.GetVertexStride() + mesh.GetPositionStride());
+        }
+
+        Scene scene;
+        scene.SetCamera(&camera);
+        glm::mat4 modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(0.05f));
+        for (int i = 0; i < count; i++) {
+            scene.AddModel(&model, modelMatrix, &shader);
+        }
+        double frameTime = timeFrames(FRAMES, [&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+            scene.Draw();
+        });
+
+        std::cout << "  " << names[layout] << ": " << VertexFormat::GetStride(layout) << " bytes per vertex, "
+            << vertexMemory / 1024 << " KiB vertices, " << frameTime << " ms/frame" << std::endl;
+    }
+    VertexFormat::SetLayout(VERTEX_LAYOUT_FLOAT);
+}
+
+/**
+ * Loads the backpack with 32-bit indices only, with 16-bit indices where
+ * meshes fit them and with 8-bit indices allowed as well. Reports the
+ * index memory of the model and how much of it is saved against 32-bit
+ * indices, then draws count models from the geometry pool with
+ * multi-draw indirect.
+ *
+ * @param count The number of models in the scene
+ * 
+ * @returns void
+ */
+void indicesBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    const char* names[] = {"32-bit", "16-bit", "8-bit"};
+    int n = 0;
+    for (GLenum type : {GL_UNSIGNED_INT, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE}) {
+        Mesh::SetSmallestIndexType(type);
+        IndexMemoryStats stats;
+        {
+            Model model(path);
+            stats = model.GetIndexMemoryStats();
+            std::cout << "Smallest index type " << names[n++] << ": " << model.GetMeshes().size() << " meshes, "
+                << stats.shortMeshes << " with 16-bit and " << stats.byteMeshes << " with 8-bit indices" << std::endl;
+        }
+        std::cout << "  index memory: " << stats.indexBytes / 1024 << " KiB, " << stats.GetSavedBytes() / 1024
+            << " KiB saved" << std::endl;
+        drawScene(count, "light_shader_instanced.vs", true);
+    }
+    Mesh::SetSmallestIndexType(GL_UNSIGNED_SHORT);
+}
+
+/**
+ * Draws a depth prepass of the backpack count times with a shader that
+ * only reads positions, with the vertices interleaved and with the
+ * positions in a separate stream, for float and quantized vertices. The
+ * models are scaled down so that the pass is bound by vertex fetch.
+ *
+ * @param count The number of models to draw
+ * 
+ * @returns void
+ */
+void depthPrepassBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    Shader shader((dir + "/shaders/depth_shader.vs").c_str(), (dir + "/shaders/depth_shader.fs").c_str());
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+
+    std::cout << "Depth prepass, " << count << " models" << std::endl;
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    for (VertexLayout layout : {VERTEX_LAYOUT_FLOAT, VERTEX_LAYOUT_QUANTIZED_OCT8}) {
+        for (bool positionStream : {false, true}) {
+            VertexFormat::SetLayout(layout);
+            VertexFormat::SetPositionStream(positionStream);
+            Model model(path);
+
+            Scene scene;
+            scene.SetCamera(&camera);
+            glm::mat4 modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(0.05f));
+            for (int i = 0; i < count; i++) {
+                scene.AddModel(&model, modelMatrix, &shader);
+            }
+            double frameTime = timeFrames(FRAMES, [&]() {
+                glClear(GL_DEPTH_BUFFER_BIT);
+                scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+                scene.Draw();
+            });
+
+            GLsizei fetched = positionStream ? model.GetMeshes()[0].GetPositionStride() :
+                (GLsizei)VertexFormat::GetStride(layout);
+            std::cout << "  " << (layout == VERTEX_LAYOUT_FLOAT ? "float" : "quantized")
+                << (positionStream ? ", position stream: " : ", interleaved: ") << fetched
+                << " bytes per vertex fetched, " << frameTime << " ms/frame" << std::endl;
+        }
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    VertexFormat::SetLayout(VERTEX_LAYOUT_FLOAT);
+    VertexFormat::SetPositionStream(false);
+}
+
+/**
+ * Loads the backpack count times with the CPU copies of the meshes freed
+ * after upload and with them kept, and reports the bytes of mesh data
+ * resident on the CPU while the models are loaded.
+ *
+ * @param count The number of models to load
+ * 
+ * @returns void
+ */
+void meshMemoryBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    std::cout << "Resident CPU mesh data, " << count << " models" << std::endl;
+    for (bool keep : {false, true}) {
+        Mesh::SetKeepCPUData(keep);
+        size_t before = Mesh::GetResidentCPUBytes();
+        std::vector<std::unique_ptr<Model>> models;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; i++) {
+            models.push_back(std::make_unique<Model>(path));
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double loadTime = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "  " << (keep ? "kept:    " : "released: ") << (Mesh::GetResidentCPUBytes() - before) / 1024
+            << " KiB, " << loadTime / count << " ms per model" << std::endl;
+    }
+    Mesh::SetKeepCPUData(false);
+}
+
+/**
+ * Loads the backpack into a scene drawn from the geometry pool, draws a
+ * few frames, clears the scene and destroys the model, count times.
+ * Reports the live GL objects and the vertices in the pool after each
+ * cycle, which stay flat when unloading releases everything.
+ *
+ * @param count The number of load and unload cycles
+ * 
+ * @returns void
+ */
+void unloadingBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    Shader shader((dir + "/shaders/light_shader_instanced.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    Scene scene;
+    scene.SetCamera(&camera);
+    scene.SetMultiDrawIndirect(true);
+
+    std::cout << "Live GL objects after unloading, " << count << " cycles" << std::endl;
+    size_t baseline = GLObjectTracker::GetLiveCount();
+    int reports = std::min(count, 10);
+    for (int i = 0; i < count; i++) {
+        {
+            Model model(path);
+            scene.AddModel(&model, glm::mat4(1.0f), &shader);
+            for (int frame = 0; frame < 3; frame++) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+                scene.Draw();
+            }
+            scene.ClearModels();
+        }
+        glFinish();
+        if ((i + 1) % std::max(count / reports, 1) == 0) {
+            std::cout << "  cycle " << i + 1 << ": " << GLObjectTracker::GetLiveCount() - baseline << " objects, "
+                << GLObjectTracker::GetLiveCount(GL_OBJECT_BUFFER) << " buffers, "
+                << GLObjectTracker::GetLiveCount(GL_OBJECT_TEXTURE) << " textures, "
+                << TextureCache::GetTextureCount() << " cached textures" << std::endl;
+        }
+    }
+}
+
+/**
+ * Streams the textures of the backpack drawn count times along a line
+ * going away from the camera, with a budget of a quarter of the full
+ * textures. Reports the streaming counters every few frames while the
+ * levels come in, and the texture memory the same models take when
+ * loaded whole.
+ *
+ * @param count The number of models to draw
+ * 
+ * @returns void
+ */
+void streamingBenchmark(int count) {
+    std::string path = dir + "/resources/objects/backpack/backpack.obj";
+    Shader shader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+
+    size_t fullMemory = 0;
+    {
+        Model model(path);
+        std::vector<GLuint> textures;
+        for (const Mesh& mesh : model.GetMeshes()) {
+            for (const Texture& texture : mesh.textures) {
+                if (std::find(textures.begin(), textures.end(), texture.id) == textures.end()) {
+                    textures.push_back(texture.id);
+                    fullMemory += getTextureMemory(texture.id);
+                }
+            }
+        }
+    }
+
+    TextureStreamer::SetEnabled(true);
+    TextureStreamer::SetBudget(fullMemory / 4);
+    {
+        Model model(path);
+        Scene scene;
+        scene.SetCamera(&camera);
+        for (int i = 0; i < count; i++) {
+            scene.AddModel(&model, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -4.0f * i)), &shader);
+        }
+
+        std::cout << "Texture streaming, " << count << " models, budget " << fullMemory / 4 / 1024
+            << " KiB of " << fullMemory / 1024 << " KiB" << std::endl;
+        unsigned int levelsLoaded = 0;
+        unsigned int evictions = 0;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            double frameTime = timeFrames(1, [&]() {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+                scene.Draw();
+            });
+            StreamingStats stats = TextureStreamer::GetStats();
+            levelsLoaded += stats.levelsLoaded;
+            evictions += stats.evictions;
+            if (frame % 10 == 0 || frame == FRAMES - 1) {
+                std::cout << "  frame " << frame << ": " << stats.residentBytes / 1024 << " KiB resident in "
+                    << stats.streamedTextures << " textures, " << stats.pendingRequests << " pending, "
+                    << levelsLoaded << " levels loaded, " << evictions << " evictions, "
+                    << frameTime << " ms" << std::endl;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    TextureStreamer::SetEnabled(false);
+}
+
+int main(int argc, char** argv) {
+    // Available benchmarks
+    std::map<std::string, std::function<void(int)>> benchmarks = {
+        {"uniforms", uniformBenchmark},
+        {"scene", sceneBenchmark},
+        {"instancing", instancingBenchmark},
+        {"multidraw", multiDrawBenchmark},
+        {"materials", materialsBenchmark},
+        {"packing", packingBenchmark},
+        {"culling", cullingBenchmark},
+        {"picking", pickingBenchmark},
+        {"raycast", raycastBenchmark},
+        {"loading", loadingBenchmark},
+        {"cache", cacheBenchmark},
+        {"optimizer", optimizerBenchmark},
+        {"welding", weldingBenchmark},
+        {"layouts", vertexLayoutBenchmark},
+        {"indices", indicesBenchmark},
+        {"prepass", depthPrepassBenchmark},
+        {"memory", meshMemoryBenchmark},
+        {"unloading", unloadingBenchmark},
+        {"textures", texturesBenchmark},
+        {"compression", compressionBenchmark},
+        {"streaming", streamingBenchmark},
+    };
+
+    if (argc < 2 || benchmarks.find(argv[1]) == benchmarks.end()) {
+        std::cout << "Usage: benchmark <name> [count]" << std::endl;
+        for (const auto& benchmark : benchmarks) {
+            std::cout << "  " << benchmark.first << std::endl;
+        }
+        return -1;
+    }
+    int count = argc > 2 ? std::stoi(argv[2]) : 5000;
+
+    // Initialize glfw with a hidden window, the benchmarks only need a context
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OGE Benchmark", NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    stbi_set_flip_vertically_on_load(true);
+    glEnable(GL_DEPTH_TEST);
+
+    // Every benchmark releases its GL objects before it returns
+    GLObjectTracker::SetLeakCheck(true);
+    dir = std::filesystem::weakly_canonical(std::filesystem::path(argv[0])).parent_path().string();
+    benchmarks[argv[1]](count);
+    SamplerCache::Clear();
+    GLObjectTracker::ReportLeaks();
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef BUFFER_RING_H
+#define BUFFER_RING_H
+
+#include <glad/glad.h>
+
+#include <gl_handle.h>
+
+#include <cstddef>
+
+// Number of frames the CPU may write ahead of the GPU
+const int BUFFER_RING_FRAMES = 3;
+
+/*
+* A persistently mapped buffer split into one region per frame in
+* flight. Each frame sub-allocates aligned ranges from its region and a
+* fence keeps the CPU from overwriting a region the GPU still reads.
+*/
+class BufferRing {
+ public:
+    // Constructor, an alignment of 0 uses the uniform buffer offset alignment
+    explicit BufferRing(GLint alignment = 0);
+
+    // Destructor releases the buffer and fences
+    ~BufferRing();
+
+    BufferRing(const BufferRing&) = delete;
+    BufferRing& operator=(const BufferRing&) = delete;
+
+    // Starts a new frame with room for at least size bytes
+    void BeginFrame(GLsizeiptr size);
+
+    // Ends the frame and fences its region
+    void EndFrame();
+
+    // Allocates an aligned range in the current frame region
+    GLintptr Allocate(GLsizeiptr size);
+
+    // Gets a CPU pointer to an allocated range
+    void* GetPointer(GLintptr offset);
+
+    // Gets the GL buffer
+    GLuint GetBuffer();
+
+    // Rounds a size up to the alignment of allocated ranges
+    GLsizeiptr Align(GLsizeiptr size);
+
+ private:
+    GLBuffer buffer;
+    unsigned char* mapped = nullptr;
+    GLint alignment = 0;
+    GLsizeiptr regionSize = 0;
+    int frame = 0;
+    GLintptr head = 0;
+    GLintptr regionEnd = 0;
+    GLsync fences[BUFFER_RING_FRAMES] = {};
+
+    // Creates the buffer with room for size bytes per frame
+    void allocate(GLsizeiptr size);
+
+    // Deletes the buffer and all fences
+    void release();
+};
+
+#endif  // BUFFER_RING_H
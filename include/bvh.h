@@ -0,0 +1,77 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <frustum.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// A node of a bounding volume hierarchy, a leaf if count > 0
+struct BVHNode {
+    glm::vec3 aabbMin;
+    uint32_t leftOrFirst;
+    glm::vec3 aabbMax;
+    uint32_t count;
+};
+
+/*
+* A bounding volume hierarchy over a set of boxes, used to find the
+* boxes hit by a ray without testing every box. The tree is built with
+* a binned surface area heuristic and can be refit in place when boxes
+* move without changing the tree structure. Large trees are built with
+* the subtrees of the top levels on separate threads.
+*/
+class BVH {
+ public:
+    // Constructor
+    BVH() = default;
+
+    // Builds the tree over all boxes in an array, nodes with at most
+    // maxLeafSize boxes are never split
+    void Build(const BoundsArray& bounds, unsigned int maxLeafSize = 2);
+
+    // Updates the node bounds after the boxes have moved
+    void Refit(const BoundsArray& bounds);
+
+    // Finds the nearest box for which the test function reports a hit
+    int Intersect(
+        const glm::vec3& rayOrigin,
+        const glm::vec3& rayDir,
+        const std::function<bool(unsigned int index, float& distance_out)>& test,
+        float& distance_out) const;
+
+    // Gets the number of nodes in the tree
+    size_t GetNodeCount() const;
+
+    // Gets the nodes, the root is the first node and children are stored after their parent
+    const std::vector<BVHNode>& GetNodes() const;
+
+    // Gets the box indices referenced by the leaves
+    const std::vector<unsigned int>& GetIndices() const;
+
+ private:
+    std::vector<BVHNode> nodes;
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> boxMin, boxMax, centroids;
+    unsigned int leafSize = 2;
+
+    // Copies the boxes from an array
+    void loadBoxes(const BoundsArray& bounds);
+
+    // Recomputes the bounds of a node from its boxes
+    void updateNodeBounds(BVHNode& node) const;
+
+    // Splits a node of a node list and recurses into its children
+    void subdivide(std::vector<BVHNode>& nodeList, unsigned int nodeIndex, int depth);
+
+    // Finds the cheapest split of a node with binned SAH
+    float findSplit(const BVHNode& node, int& axis_out, float& position_out) const;
+};
+
+// Tests a ray against an axis aligned box, returns the entry distance or a negative value on a miss
+float IntersectRayAABB(const glm::vec3& rayOrigin, const glm::vec3& invDir, const glm::vec3& aabbMin, const glm::vec3& aabbMax, float tMax);
+
+#endif  // BVH_H
@@ -0,0 +1,131 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <mapped_file.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// S3TC formats are an extension to core GL, supported by all desktop drivers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Vulkan format numbers of the block compressed formats a KTX2 file can hold
+const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+const uint32_t VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132;
+const uint32_t VK_FORMAT_BC1_RGBA_UNORM_BLOCK = 133;
+const uint32_t VK_FORMAT_BC1_RGBA_SRGB_BLOCK = 134;
+const uint32_t VK_FORMAT_BC3_UNORM_BLOCK = 137;
+const uint32_t VK_FORMAT_BC3_SRGB_BLOCK = 138;
+const uint32_t VK_FORMAT_BC5_UNORM_BLOCK = 141;
+const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+const uint32_t VK_FORMAT_BC7_SRGB_BLOCK = 146;
+
+// Identifier every KTX2 file starts with
+const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Header and index of a KTX2 file, followed by one KTX2Level per mip level
+struct KTX2Header {
+    unsigned char identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+// Location of a mip level in a KTX2 file
+struct KTX2Level {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// A mip level of a compressed texture, the offset is from the start of the file
+struct CompressedLevel {
+    size_t offset;
+    size_t size;
+    int width;
+    int height;
+};
+
+/*
+* A block compressed 2D texture with its mip chain, read from a KTX2 or
+* DDS file. BC1, BC3, BC5 and BC7 are supported. The file is mapped and
+* the levels are uploaded straight from it. Levels are uploaded as
+* stored, so the first row of blocks must be the bottom of the image as
+* GL expects. sRGB formats are read as their linear counterparts since
+* the engine shades in the color space of the textures.
+*/
+class CompressedTexture {
+ public:
+    // Constructor
+    CompressedTexture() = default;
+
+    // Maps a KTX2 or DDS file and reads its levels
+    bool Open(const std::string& path);
+
+    // Gets the GL internal format of the levels
+    GLenum GetFormat() const;
+
+    // Gets the size of the base level in pixels
+    int GetWidth() const;
+    int GetHeight() const;
+
+    // Gets the mip levels, the base level first
+    unsigned int GetLevelCount() const;
+    const CompressedLevel& GetLevel(unsigned int level) const;
+    const unsigned char* GetLevelData(unsigned int level) const;
+
+    // Gets the size of all levels in bytes
+    size_t GetDataSize() const;
+
+    // Checks if a path names a KTX2 or DDS file
+    static bool IsCompressedFile(const std::string& path);
+
+    // Gets a compressed file next to an image with the same name, empty if there is none
+    static std::string FindCompressedFile(const std::string& imagePath);
+
+    // Gets the size in bytes of a 4x4 block of a compressed format, 0 if unsupported
+    static size_t GetBlockSize(GLenum format);
+
+    // Gets the size in bytes of a level of a compressed format
+    static size_t GetLevelSize(GLenum format, int width, int height);
+
+    // Writes block compressed mip levels to a KTX2 file, the base level first
+    static bool WriteKTX2(const std::string& path, uint32_t vkFormat, int width, int height,
+        const std::vector<std::vector<unsigned char>>& levels);
+
+ private:
+    MappedFile file;
+    GLenum format = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<CompressedLevel> levels;
+
+    // Reads the levels of the mapped file
+    bool readKTX2();
+    bool readDDS();
+
+    // Checks that the levels lie inside the file and hold whole levels
+    bool validateLevels() const;
+};
+
+#endif  // COMPRESSED_TEXTURE_H
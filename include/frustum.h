@@ -0,0 +1,63 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Result of testing a bounding box against a frustum
+enum CullResult : uint8_t {
+    CULL_OUTSIDE = 0,
+    CULL_INTERSECTING = 1,
+    CULL_INSIDE = 2
+};
+
+// The six planes of a view frustum, normals pointing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Extracts the planes from a combined projection and view matrix
+    void Extract(const glm::mat4& viewProjection);
+
+    // Tests an axis aligned box given by its center and half extents
+    CullResult TestAABB(const glm::vec3& center, const glm::vec3& extent) const;
+};
+
+/*
+* World space axis aligned boxes of many objects, stored as separate
+* arrays per component so that they can be culled with SIMD.
+*/
+class BoundsArray {
+ public:
+    // Constructor
+    BoundsArray() = default;
+
+    // Adds a box and returns its index
+    unsigned int Add(const glm::vec3& center, const glm::vec3& extent);
+
+    // Replaces the box at an index
+    void Set(unsigned int index, const glm::vec3& center, const glm::vec3& extent);
+
+    // Removes all boxes
+    void Clear();
+
+    // Gets the number of boxes
+    size_t Size() const;
+
+    // Gets the min and max coordinates of a box
+    void GetBox(unsigned int index, glm::vec3& aabbMin_out, glm::vec3& aabbMax_out) const;
+
+    // Tests all boxes against a frustum, writing one CullResult per box
+    void Cull(const Frustum& frustum, std::vector<uint8_t>& results) const;
+
+ private:
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+};
+
+// Transforms a local box to the world space box that encloses it
+void TransformAABB(const glm::mat4& matrix, const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+    glm::vec3& center_out, glm::vec3& extent_out);
+
+#endif  // FRUSTUM_H
@@ -0,0 +1,85 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+
+#include <mesh.h>
+
+#include <cstddef>
+
+// Layout of a command in a GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/*
+* Shared vertex and index buffers that the geometry of many meshes is
+* sub-allocated from. All meshes in the pool are drawn through a single
+* vertex array, which lets them be submitted together with
+* glMultiDrawElementsIndirect. The pool takes the vertex layout, index
+* type and position stream of the first mesh added, meshes that differ
+* in any of them are not added. Indices are relative to the base vertex of their mesh, so
+* 16-bit indices suffice however large the pool grows.
+*/
+class GeometryPool {
+ public:
+    // Constructor
+    GeometryPool() = default;
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // Copies the geometry of a mesh into the pool, returns false if its format doesn't match
+    bool AddMesh(Mesh& mesh);
+
+    // Releases the buffers and vertex array, the pool is empty afterwards
+    void Clear();
+
+    // Binds an instance buffer to the INSTANCE_BINDING of the vertex array
+    void SetInstanceBuffer(GLuint buffer);
+
+    // Gets the vertex array that draws from the pool
+    GLuint GetVAO() const;
+
+    // Gets the layout of the vertices in the pool
+    VertexLayout GetVertexLayout() const;
+
+    // Gets the type of the indices in the pool
+    GLenum GetIndexType() const;
+
+    // Gets the number of vertices in the pool
+    GLsizeiptr GetVertexCount() const;
+
+    // Gets the number of indices in the pool
+    GLsizeiptr GetIndexCount() const;
+
+ private:
+    // Buffers and vertex array, deleted with the pool
+    GLVertexArray VAO;
+    GLBuffer VBO, EBO;
+    GLBuffer positionVBO;
+    VertexLayout layout = VERTEX_LAYOUT_FLOAT;
+    GLsizei stride = sizeof(Vertex);
+    GLsizei positionStride = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizei indexSize = sizeof(unsigned int);
+    GLsizeiptr vertexCapacity = 0;
+    GLsizeiptr vertexCount = 0;
+    GLsizeiptr indexCapacity = 0;
+    GLsizeiptr indexCount = 0;
+
+    // Creates the vertex array for the vertex format and index type of a mesh
+    void setupVertexArray(const Mesh& mesh);
+
+    // Grows the buffers to fit at least the given number of vertices and indices
+    void reserve(GLsizeiptr vertices, GLsizeiptr indices);
+
+    // Replaces a buffer with a larger copy of itself
+    void grow(GLBuffer& buffer, GLsizeiptr oldSize, GLsizeiptr newSize);
+};
+
+#endif  // GEOMETRY_POOL_H
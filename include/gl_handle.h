@@ -0,0 +1,128 @@
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Kinds of GL objects owned by GLHandle
+enum GLObjectType : uint8_t {
+    GL_OBJECT_BUFFER = 0,
+    GL_OBJECT_VERTEX_ARRAY = 1,
+    GL_OBJECT_TEXTURE = 2,
+    GL_OBJECT_PROGRAM = 3,
+    GL_OBJECT_SAMPLER = 4,
+    GL_OBJECT_TYPE_COUNT = 5
+};
+
+/*
+* Creates and deletes the GL objects owned by handles and counts how many
+* of each type are alive. Objects that are still alive when the leak
+* check runs were never released by their owner. Counting is always on,
+* the leak check mode only decides if ReportLeaks prints anything.
+* Objects must only be created and deleted on the render thread.
+*/
+class GLObjectTracker {
+ public:
+    // Creates an object of a type, textures are created with a target
+    static GLuint Create(GLObjectType type, GLenum target = 0);
+
+    // Deletes an object of a type and stops counting it
+    static void Delete(GLObjectType type, GLuint id);
+
+    // Counts an object that was created outside of the tracker
+    static void Track(GLObjectType type);
+
+    // Gets the number of live objects of a type
+    static size_t GetLiveCount(GLObjectType type);
+
+    // Gets the number of live objects of all types
+    static size_t GetLiveCount();
+
+    // Gets the name of a type for reports
+    static const char* GetTypeName(GLObjectType type);
+
+    // Enables printing live objects in ReportLeaks, off by default
+    static void SetLeakCheck(bool enabled);
+    static bool IsLeakCheckEnabled();
+
+    // Prints the live objects of each type if the leak check is enabled, returns their number
+    static size_t ReportLeaks();
+};
+
+/*
+* Owns a GL object of a type and deletes it when the handle is destroyed
+* or reset. Handles can be moved but not copied, so an object always has
+* exactly one owner. Converts to the name of the object, 0 if the handle
+* is empty, so it can be passed to GL calls as it is.
+*/
+template<GLObjectType Type>
+class GLHandle {
+ public:
+    // Constructor of an empty handle
+    GLHandle() = default;
+
+    // Constructor taking ownership of an object created outside of the tracker
+    explicit GLHandle(GLuint id) : id(id) {
+        if (id) {
+            GLObjectTracker::Track(Type);
+        }
+    }
+
+    // Destructor deletes the object
+    ~GLHandle() {
+        Reset();
+    }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) noexcept : id(other.id) {
+        other.id = 0;
+    }
+
+    GLHandle& operator=(GLHandle&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+
+    // Creates a new object, textures are created with a target
+    static GLHandle Create(GLenum target = 0) {
+        GLHandle handle;
+        handle.id = GLObjectTracker::Create(Type, target);
+        return handle;
+    }
+
+    // Gets the name of the object
+    GLuint Get() const {
+        return id;
+    }
+
+    operator GLuint() const {
+        return id;
+    }
+
+    // Deletes the object, the handle is empty afterwards
+    void Reset() {
+        if (id) {
+            GLObjectTracker::Delete(Type, id);
+            id = 0;
+        }
+    }
+
+ private:
+    GLuint id = 0;
+};
+
+typedef GLHandle<GL_OBJECT_BUFFER> GLBuffer;
+typedef GLHandle<GL_OBJECT_VERTEX_ARRAY> GLVertexArray;
+typedef GLHandle<GL_OBJECT_TEXTURE> GLTexture;
+typedef GLHandle<GL_OBJECT_PROGRAM> GLProgram;
+typedef GLHandle<GL_OBJECT_SAMPLER> GLSampler;
+
+#endif  // GL_HANDLE_H
@@ -0,0 +1,87 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+
+// Maximum number of texture units tracked by the cache
+const int MAX_CACHED_TEXTURE_UNITS = 32;
+
+// Counters of GL state changes and draw calls during a frame
+struct RenderStats {
+    unsigned int drawCalls = 0;
+    unsigned int programChanges = 0;
+    unsigned int textureBinds = 0;
+    unsigned int samplerBinds = 0;
+    unsigned int vertexArrayBinds = 0;
+    unsigned int bufferRangeBinds = 0;
+    unsigned int uniformUploads = 0;
+    unsigned int redundantChanges = 0;
+};
+
+/*
+* Shadows the GL state that is changed while drawing so that calls which
+* would not change anything are skipped. The cache assumes it is the
+* only one changing the tracked state between Reset calls.
+*/
+class GLStateCache {
+ public:
+    // Constructor
+    GLStateCache();
+
+    // Forgets all shadowed state, the next call of each kind always reaches GL
+    void Reset();
+
+    // Binds a program if it isn't already in use
+    void UseProgram(GLuint program);
+
+    // Binds a texture to a unit if it isn't already bound there
+    void BindTexture(GLuint unit, GLuint texture);
+
+    // Binds a sampler to a unit if it isn't already bound there
+    void BindSampler(GLuint unit, GLuint sampler);
+
+    // Binds a vertex array if it isn't already bound
+    void BindVertexArray(GLuint vertexArray);
+
+    // Binds a range of a uniform buffer if it isn't already bound
+    void BindUniformRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    // Sets an int uniform of the current program if its value differs
+    void SetUniform(GLint location, int value);
+
+    // Sets a mat4 uniform of the current program if its value differs
+    void SetUniform(GLint location, const glm::mat4& value);
+
+    // Counts a draw call
+    void CountDraw();
+
+    // Gets the counters
+    const RenderStats& GetStats() const;
+
+    // Clears the counters
+    void ResetStats();
+
+ private:
+    GLuint program;
+    GLuint vertexArray;
+    GLuint textures[MAX_CACHED_TEXTURE_UNITS];
+    GLuint samplers[MAX_CACHED_TEXTURE_UNITS];
+    GLuint uniformBuffers[2];
+    GLintptr uniformOffsets[2];
+    GLsizeiptr uniformSizes[2];
+
+    // Int uniform values per program and location
+    std::unordered_map<uint64_t, int> intUniforms;
+
+    // Matrix uniform values per program and location
+    std::unordered_map<uint64_t, glm::mat4> matrixUniforms;
+
+    RenderStats stats;
+};
+
+#endif  // GL_STATE_CACHE_H
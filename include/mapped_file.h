@@ -0,0 +1,48 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/*
+* A read-only view of a whole file mapped into memory. The pages are
+* read from disk on first access and the data is never copied.
+*/
+class MappedFile {
+ public:
+    // Constructor
+    MappedFile() = default;
+
+    // Destructor unmaps the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps a file, closing any file mapped before
+    bool Open(const std::string& path);
+
+    // Unmaps the file
+    void Close();
+
+    // Gets the mapped data, nullptr if no file is mapped
+    const unsigned char* GetData() const;
+
+    // Gets the size of the mapped file in bytes
+    size_t GetSize() const;
+
+    // Gets a name no other writer uses to write a file under before renaming it to path
+    static std::string GetTemporaryPath(const std::string& path);
+
+ private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int descriptor = -1;
+#endif
+};
+
+#endif  // MAPPED_FILE_H
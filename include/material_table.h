@@ -0,0 +1,86 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+// Binding point of the Materials shader storage block
+const GLuint MATERIAL_BUFFER_BINDING = 0;
+
+// Texture units of the materialArrays samplers of the texture array fallback
+const GLuint MATERIAL_ARRAY_FIRST_UNIT = 16;
+const int MAX_MATERIAL_ARRAYS = 8;
+
+// How meshes get the textures of their material
+enum MaterialMode : uint8_t {
+    MATERIAL_MODE_BINDINGS = 0,
+    MATERIAL_MODE_BINDLESS = 1,
+    MATERIAL_MODE_TEXTURE_ARRAYS = 2
+};
+
+// std430 layout of an entry of the Materials block. Textures are either
+// resident bindless handles, or an array and layer when handles are 0.
+// Arrays are -1 for missing textures.
+struct MaterialEntry {
+    GLuint64 diffuseHandle;
+    GLuint64 specularHandle;
+    GLint diffuseArray;
+    GLint diffuseLayer;
+    GLint specularArray;
+    GLint specularLayer;
+};
+
+// Counters of the material table
+struct MaterialStats {
+    unsigned int materials = 0;
+    unsigned int residentHandles = 0;
+    unsigned int arrays = 0;
+    unsigned int arrayLayers = 0;
+    unsigned int missingTextures = 0;
+};
+
+/*
+* Engine wide table of the materials of all meshes. Every distinct set of
+* textures is a material, and its index in the table is the material ID
+* of the meshes using it. Once enabled, the table is kept in a shader
+* storage buffer and shaders with a materialIndex uniform fetch their
+* textures from it, so drawing a mesh only sets that uniform instead of
+* binding its textures. With GL_ARB_bindless_texture the entries hold
+* resident texture handles. Without it, textures are copied into texture
+* arrays grouped by size and format, which are bound once per frame.
+* Both need immutable textures, so TextureStreamer and TexturePacker are
+* off while the table is enabled. Must only be used on the render thread.
+*/
+class MaterialTable {
+ public:
+    // Gets the material ID of a set of textures, adding it to the table if it is new
+    static unsigned int GetMaterial(const std::vector<Texture>& textures);
+
+    // Moves drawing to the material buffer, with bindless textures if allowed and supported
+    static MaterialMode Enable(GLADloadproc load, bool allowBindless = true);
+
+    // Frees the GL objects of the table and goes back to binding textures per mesh
+    static void Disable();
+
+    // Gets how meshes get their textures
+    static MaterialMode GetMode();
+
+    // Checks if the driver supports bindless textures, valid after Enable
+    static bool IsBindlessSupported();
+
+    // Brings the buffer up to date and binds it with the texture arrays, once per frame
+    static void Bind(GLStateCache* state = nullptr);
+
+    // Drops a texture that is about to be deleted from the table
+    static void ReleaseTexture(GLuint texture);
+
+    // Gets the counters of the table
+    static MaterialStats GetStats();
+};
+
+#endif  // MATERIAL_TABLE_H
@@ -7,7 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <shader.h>
+#include <gl_handle.h>
+#include <gl_state_cache.h>
+#include <vertex_format.h>
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -17,31 +22,246 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// Per-instance data read by instanced shaders, the model matrix from
+// attribute locations 3 to 6 and the normal matrix from 7 to 9
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+};
+
+// Vertex buffer binding points of the mesh vertex arrays, positions are
+// read from POSITION_BINDING when they are in a separate stream
+const GLuint VERTEX_BINDING = 0;
+const GLuint INSTANCE_BINDING = 1;
+const GLuint POSITION_BINDING = 2;
+
+class GeometryPool;
+class TriangleBVH;
+
+// Index memory of a set of meshes, and what the same indices take as
+// 32-bit indices
+struct IndexMemoryStats {
+    size_t indexBytes = 0;
+    size_t fullBytes = 0;
+    unsigned int byteMeshes = 0;
+    unsigned int shortMeshes = 0;
+    unsigned int intMeshes = 0;
+
+    // Adds the indices of a mesh
+    void Add(GLsizei indexCount, GLenum indexType);
+
+    // Gets the bytes saved against 32-bit indices
+    size_t GetSavedBytes() const;
+};
+
+// A texture of a mesh. Textures packed into a texture array have the
+// array as id and their layer in it, layer is -1 for 2D textures.
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
+    int layer = -1;
+};
+
+// Adds a number of bytes to the process-wide total of CPU mesh data for
+// as long as it lives. Moves hand the bytes over to the new counter.
+class ResidentBytes {
+ public:
+    ResidentBytes() = default;
+    ResidentBytes(const ResidentBytes&) = delete;
+    ResidentBytes& operator=(const ResidentBytes&) = delete;
+    ResidentBytes(ResidentBytes&& other) noexcept;
+    ResidentBytes& operator=(ResidentBytes&& other) noexcept;
+    ~ResidentBytes();
+
+    // Replaces the counted bytes
+    void Set(size_t bytes);
+
+    // Gets the bytes counted by all live counters
+    static size_t GetTotal();
+
+ private:
+    size_t bytes = 0;
 };
 
 class Mesh {
  public:
-    // Mesh data
+    // Mesh data, the vertices and indices are empty unless CPU copies are kept
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
 
-    // Constructor
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+    // Constructor taking over the data, uploading the vertices in a layout, optionally with positions in their own stream
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+        VertexLayout layout = VERTEX_LAYOUT_FLOAT, bool positionStream = false);
+
+    // Constructor uploading vertex and index data in place, copying it only if CPU copies are kept
+    Mesh(
+        const Vertex* vertexData,
+        size_t vertexCount,
+        const unsigned int* indexData,
+        size_t indexCount,
+        std::vector<Texture> textures,
+        glm::vec3 aabbMin,
+        glm::vec3 aabbMax,
+        VertexLayout layout = VERTEX_LAYOUT_FLOAT,
+        bool positionStream = false);
+
+    // Meshes own their buffers and vertex array, they can be moved but not copied
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
 
     // Render mesh
-    void Draw(Shader shader);
+    void Draw(const Shader& shader);
+
+    // Render mesh, skipping state changes the cache already has applied
+    void Draw(const Shader& shader, GLStateCache& state);
+
+    // Render count instances of the mesh with instance data from a buffer
+    void DrawInstanced(const Shader& shader, GLStateCache& state, GLuint instanceBuffer, GLintptr offset, GLsizei count);
+
+    // Binds the textures of the mesh, or sets its material index, through a state cache
+    void BindTextures(const Shader& shader, GLStateCache& state);
+
+    // Sets the uniforms that decode the vertex layout of the mesh through a state cache
+    void BindVertexDecode(const Shader& shader, GLStateCache& state);
+
+    // Gets the vertex array of the mesh
+    unsigned int GetVAO() const;
+
+    // Gets the number of indices of the mesh
+    GLuint GetIndexCount() const;
+
+    // Gets the number of vertices of the mesh
+    GLuint GetVertexCount() const;
+
+    // Gets the buffers holding the vertices and indices of the mesh
+    unsigned int GetVertexBuffer() const;
+    unsigned int GetIndexBuffer() const;
+
+    // Gets the type and size of the indices in the index buffer
+    GLenum GetIndexType() const;
+    GLsizei GetIndexSize() const;
+
+    // Gets the layout of the vertex buffer and the size of its vertices
+    VertexLayout GetVertexLayout() const;
+    GLsizei GetVertexStride() const;
+
+    // Gets the buffer holding the positions and the size of a position, 0 without a position stream
+    unsigned int GetPositionBuffer() const;
+    GLsizei GetPositionStride() const;
+
+    // Checks if the positions are in a separate stream
+    bool HasPositionStream() const;
+
+    // Gets the matrix the shaders map the positions in the vertex buffer to model space with
+    const glm::mat4& GetPositionDecode() const;
+
+    // Gets the min and max coordinates of the mesh in each direction
+    glm::vec3 GetMinCoords() const;
+    glm::vec3 GetMaxCoords() const;
+
+    // Records where the mesh was placed in a geometry pool
+    void SetPoolRange(GeometryPool* pool, GLint baseVertex, GLuint firstIndex);
+
+    // Gets the geometry pool of the mesh, nullptr if it is not in one
+    GeometryPool* GetPool() const;
+
+    // Gets the first vertex and first index of the mesh in its pool
+    GLint GetPoolBaseVertex() const;
+    GLuint GetPoolFirstIndex() const;
+
+    // Sets up a vertex array to read vertices of a layout from VERTEX_BINDING and POSITION_BINDING
+    static void SetupVertexFormat(GLuint vertexArray, VertexLayout layout = VERTEX_LAYOUT_FLOAT,
+        bool positionStream = false);
+
+    // Sets up a vertex array to read InstanceData from INSTANCE_BINDING
+    static void SetupInstanceFormat(GLuint vertexArray);
+
+    // Sets the smallest index type meshes created afterwards may use, GL_UNSIGNED_SHORT by default
+    static void SetSmallestIndexType(GLenum type);
+    static GLenum GetSmallestIndexType();
+
+    // Gets the smallest allowed index type that can address a number of vertices
+    static GLenum ChooseIndexType(size_t vertexCount);
+
+    // Gets the size of an index of a type in bytes
+    static GLsizei GetIndexTypeSize(GLenum type);
+
+    // Frees the CPU copies of the vertices and indices
+    void ReleaseCPUData();
+
+    // Checks if the mesh keeps CPU copies of its vertices and indices
+    bool HasCPUData() const;
+
+    // Keeps CPU copies of the vertices and indices of meshes created afterwards, off by default
+    static void SetKeepCPUData(bool keep);
+    static bool IsKeepingCPUData();
+
+    // Gets the bytes of vertices and indices all meshes keep on the CPU
+    static size_t GetResidentCPUBytes();
+
+    // Gets the ID shared by all meshes with the same set of textures, its index in the material table
+    unsigned int GetMaterialID() const;
+
+    // Builds a triangle BVH from the CPU copies of the vertices and indices for ray casts, false without them
+    bool BuildBVH();
+
+    // Sets a triangle BVH built from the vertices and indices of the mesh
+    void SetBVH(std::shared_ptr<const TriangleBVH> triangleBVH);
+
+    // Gets the triangle BVH of the mesh, nullptr if it hasn't been built
+    const TriangleBVH* GetBVH() const;
 
  private:
-    // Render data
-    unsigned int VAO, VBO, EBO;
+    // Render data, deleted with the mesh
+    GLVertexArray VAO;
+    GLBuffer VBO, EBO;
+    GLBuffer positionVBO;
+    GLsizei vertexCount = 0;
+    GLsizei indexCount = 0;
+    unsigned int materialID;
+    bool instanceAttributes = false;
+    glm::vec3 aabbMin;
+    glm::vec3 aabbMax;
+    GLenum indexType = GL_UNSIGNED_INT;
+    VertexLayout layout = VERTEX_LAYOUT_FLOAT;
+    bool positionStream = false;
+    glm::mat4 positionDecode = glm::mat4(1.0f);
+
+    // Location of the mesh in a geometry pool
+    GeometryPool* pool = nullptr;
+    GLint poolBaseVertex = 0;
+    GLuint poolFirstIndex = 0;
+
+    // Size of the CPU copies in the process-wide total
+    ResidentBytes residentBytes;
+
+    // Triangle BVH, shared with the pending mesh it was built for
+    std::shared_ptr<const TriangleBVH> bvh;
+
+    // Sampler uniforms resolved for the generation of the last shader used to draw the mesh
+    uint64_t samplerShaderGeneration = 0;
+    std::vector<UniformHandle<int>> samplerHandles;
+    std::vector<UniformHandle<int>> layerHandles;
+    std::vector<GLint> arrayUnits;
+    UniformHandle<int> materialHandle;
+    UniformHandle<glm::mat4> positionDecodeHandle;
+    UniformHandle<int> octahedralNormalsHandle;
+
+    // Resolves the sampler, array unit and layer uniforms of each texture for a shader
+    void resolveSamplers(const Shader& shader);
+
+    // Enables the instance attributes in the vertex array
+    void setupInstanceAttributes();
 
     // Sets up the mesh and binds buffers
-    void setupMesh();
+    void setupMesh(const Vertex* vertexData, const unsigned int* indexData);
+
+    // Counts the CPU copies if they are kept, frees them otherwise
+    void keepOrReleaseCPUData();
 };
 
 #endif  // MESH_H
\ No newline at end of file
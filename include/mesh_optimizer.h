@@ -0,0 +1,99 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+// Size of the LRU cache the vertex cache optimization scores vertices with
+const unsigned int OPTIMIZER_CACHE_SIZE = 32;
+
+// Size of the FIFO cache ACMR and ATVR are measured with, close to the
+// post-transform caches of current GPUs
+const unsigned int ANALYSIS_CACHE_SIZE = 16;
+
+// How much worse than the vertex cache order the ACMR of a cluster may be
+// for it to be split off for overdraw ordering
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+// Most vertices a part of a split mesh may have, so its indices fit 16 bits
+const size_t MAX_SPLIT_VERTICES = 65536;
+
+// Default distance within which attributes are welded in epsilon mode
+const float DEFAULT_WELD_EPSILON = 1e-5f;
+
+// How identical vertices of imported meshes are merged
+enum WeldMode : uint8_t {
+    WELD_NONE = 0,
+    WELD_EXACT = 1,
+    WELD_EPSILON = 2
+};
+
+// Vertex cache efficiency of a mesh before and after optimization. ACMR
+// is the transformed vertices per triangle, ATVR the transformed
+// vertices per vertex, 1.0 is the ideal. They are 0 if the mesh wasn't
+// optimized. The vertex counts are from before and after welding.
+struct MeshOptimizationStats {
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+    float atvrBefore = 0.0f;
+    float atvrAfter = 0.0f;
+    unsigned int verticesBefore = 0;
+    unsigned int verticesAfter = 0;
+};
+
+// A run of the triangles of a split mesh with the vertices they use
+struct MeshPart {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+/*
+* Reorders the triangles and vertices of indexed triangle meshes for the
+* GPU. Triangles are ordered for the post-transform vertex cache with
+* Tom Forsyth's linear-speed algorithm, then split into clusters that
+* are ordered so that outward facing ones are drawn first to reduce
+* overdraw, and vertices are reordered in the order they are first used
+* to improve vertex fetch locality. Before that, identical vertices can
+* be welded into one, either when all their attributes are bitwise equal
+* or when they are within an epsilon of each other. Meshes with too many
+* vertices for 16-bit indices can be split into parts. Makes no GL calls.
+*/
+class MeshOptimizer {
+ public:
+    // Runs all stages on a mesh and returns its cache efficiency before and after
+    static MeshOptimizationStats Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    // Reorders triangles for the post-transform vertex cache
+    static void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+    // Reorders clusters of vertex cache ordered triangles to reduce overdraw
+    static void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices);
+
+    // Reorders vertices in the order the indices first use them, dropping unused vertices
+    static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    // Merges identical vertices and remaps the indices, returns the number of vertices left
+    static size_t WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+        WeldMode mode, float epsilon = DEFAULT_WELD_EPSILON);
+
+    // Splits a mesh into runs of triangles that each use at most maxVertices vertices
+    static std::vector<MeshPart> SplitMesh(const std::vector<Vertex>& vertices,
+        const std::vector<unsigned int>& indices, size_t maxVertices = MAX_SPLIT_VERTICES);
+
+    // Measures the ACMR and ATVR of indices with a FIFO cache of ANALYSIS_CACHE_SIZE
+    static void AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+        float& acmr_out, float& atvr_out);
+
+    // Enables or disables optimizing meshes as models are imported, enabled by default
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // Sets how the vertices of imported meshes are welded, exact by default
+    static void SetWeldMode(WeldMode mode, float epsilon = DEFAULT_WELD_EPSILON);
+    static WeldMode GetWeldMode();
+    static float GetWeldEpsilon();
+};
+
+#endif  // MESH_OPTIMIZER_H
@@ -11,25 +11,74 @@
 #include <assimp/postprocess.h>
 
 #include <mesh.h>
+#include <mesh_optimizer.h>
 #include <shader.h>
+#include <texture_cache.h>
+#include <texture_packer.h>
+#include <upload_ring.h>
 
+#include <chrono>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
+// Nearest triangle hit by a ray cast against a model
+struct RaycastHit {
+    int mesh = -1;
+    unsigned int triangle = 0;
+    glm::vec2 barycentrics = glm::vec2(0.0f);
+    float distance = 0.0f;
+};
+
+// Time spent loading a texture of a model, decoding runs on a worker
+// thread and uploading on the render thread
+struct TextureTiming {
+    std::string path;
+    int width;
+    int height;
+    double decodeMilliseconds;
+    double uploadMilliseconds;
+    bool staged;
+};
+
+// Mesh data waiting for its GL objects, the textures are indices into
+// the loaded textures of the model, replaced by packedTextures once the
+// textures have been packed. Meshes converted from Assimp own their
+// vertices and indices, meshes of a cooked model point into the mapped
+// cooked file instead.
+struct PendingMesh {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> textures;
+    std::vector<Texture> packedTextures;
+    std::shared_ptr<const TriangleBVH> bvh;
+    const Vertex* vertexData = nullptr;
+    const unsigned int* indexData = nullptr;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    glm::vec3 aabbMin = glm::vec3(0.0f);
+    glm::vec3 aabbMax = glm::vec3(0.0f);
+    MeshOptimizationStats optimization;
+};
+
+class ModelLoader;
+class ModelCache;
+
 class Model {
  public:
     // Default constructor
     Model() = default;
 
-    // Constructor with path to the model dir 
-    Model(std::string const& path);
+    // Constructor with path to the model dir, optionally building triangle BVHs for ray casts
+    Model(std::string const& path, bool buildBVH = false);
 
     // Renders the model
-    void Draw(Shader& shader);
+    void Draw(const Shader& shader);
 
     // Gets max coordinate in each direction
     glm::vec3 GetMaxCoords();
@@ -37,21 +86,103 @@ class Model {
     // Gets min coordinate in each direction
     glm::vec3 GetMinCoords();
 
+    // Gets the meshes of the model
+    const std::vector<Mesh>& GetMeshes() const;
+    std::vector<Mesh>& GetMeshes();
+
+    // Builds the triangle BVHs of all meshes that don't have one, false if a mesh
+    // has no CPU data to build from. Needs Mesh::SetKeepCPUData(true) at load
+    // time, otherwise load the model with Model(path, true) instead.
+    bool BuildBVH();
+
+    // Checks if all meshes have a triangle BVH
+    bool HasBVH() const;
+
+    // Finds the nearest triangle hit by a ray in model space. Meshes without a
+    // BVH are only tested if they keep CPU data, see Mesh::SetKeepCPUData.
+    bool Raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDir, RaycastHit& hit_out) const;
+
+    // Checks if the model has been uploaded and can be drawn
+    bool IsReady() const;
+
+    // Gets the decode and upload times of the textures the model uploaded
+    const std::vector<TextureTiming>& GetTextureTimings() const;
+
+    // Gets the counters of packing the textures of the model, all 0 if they weren't packed
+    const TexturePackingStats& GetTexturePackingStats() const;
+
+    // Gets the vertex cache efficiency of each mesh before and after it was optimized
+    const std::vector<MeshOptimizationStats>& GetMeshOptimizationStats() const;
+
+    // Gets the index memory of the meshes and how much smaller index types saved
+    IndexMemoryStats GetIndexMemoryStats() const;
+
+    // Gets the textures the materials of a model use without loading the model
+    static std::vector<Texture> GetMaterialTextures(const std::string& path);
+
  private:
+    friend class ModelLoader;
+
     std::vector<Mesh> meshes;
     std::string directory;
     std::vector<Texture> loaded_textures;
     glm::vec3 aabb_max = glm::vec3(-1000.0f, -1000.0f, -1000.0f);
     glm::vec3 aabb_min = glm::vec3(1000.0f, 1000.0f, 1000.0f);
 
+    // Shared textures of the model, one per loaded texture, and the
+    // indices of the loaded textures by their path in the model. Reading
+    // only the materials doesn't acquire the textures.
+    std::vector<std::shared_ptr<CachedTexture>> cachedTextures;
+    std::unordered_map<std::string, unsigned int> textureIndices;
+    bool acquireTextures = true;
+
+    // Texture arrays and atlases the textures of the model were packed into
+    std::vector<std::shared_ptr<CachedTexture>> packedTextures;
+    TexturePackingStats packingStats;
+    bool texturesPacked = false;
+
+    // Imported data waiting to be uploaded
+    bool ready = false;
+    std::vector<PendingMesh> pendingMeshes;
+    size_t uploadedImages = 0;
+    std::vector<TextureTiming> textureTimings;
+    std::vector<MeshOptimizationStats> meshOptimization;
+
+    // Cooked file the pending meshes point into, kept mapped until they are uploaded
+    std::shared_ptr<ModelCache> cookedModel;
+
     // Loads a model from specified path
-    void loadModel(std::string path);
+    void loadModel(std::string path, bool buildBVH);
+
+    // Imports the model and decodes its textures without any GL calls
+    void importModel(std::string path, bool buildBVH);
+
+    // Reads the meshes from the cooked file of a model if it is up to date, checking indices if asked
+    bool importCookedModel(const std::string& path, bool validateIndices);
+
+    // Optimizes the pending meshes for the vertex cache and overdraw in parallel
+    void optimizePendingMeshes();
+
+    // Splits pending meshes with too many vertices for 16-bit indices
+    void splitPendingMeshes();
+
+    // Builds triangle BVHs for the pending meshes in parallel
+    void buildPendingBVHs();
+
+    // Creates the GL objects of the imported data until the deadline has
+    // passed, staging texture uploads through a ring if one is given
+    bool finishLoading(std::chrono::steady_clock::time_point deadline, UploadRing* ring = nullptr);
+
+    // Packs the uploaded textures into texture arrays and atlases for the pending meshes
+    void packTextures();
 
     // Recursively processes all the child nodes and meshes of a node
     void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
-    unsigned int TextureFromFile(const char *path, const std::string &directory);
+    PendingMesh processMesh(aiMesh* mesh, const aiScene* scene);
+    std::vector<unsigned int> processMaterial(aiMaterial* material);
+    std::vector<unsigned int> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    void acquireTexture(const std::string &path);
+    bool uploadTexture(ImageData& image, UploadRing* ring, GLTexture& id_out, TextureTiming& timing_out);
 };
 
 #endif  // MODEL_H
\ No newline at end of file
@@ -0,0 +1,137 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <model.h>
+#include <mapped_file.h>
+#include <mesh_optimizer.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Identifies a cooked model file and the version of its layout
+const char MODEL_CACHE_MAGIC[4] = {'O', 'G', 'E', 'C'};
+const uint32_t MODEL_CACHE_VERSION = 4;
+
+// Flags of a cooked model file, how its meshes were processed on import
+const uint32_t MODEL_CACHE_OPTIMIZED = 1;
+const uint32_t MODEL_CACHE_WELD_EXACT = 2;
+const uint32_t MODEL_CACHE_WELD_EPSILON = 4;
+const uint32_t MODEL_CACHE_SPLIT = 8;
+
+// Start of a cooked model file. The source size, modification time and
+// content hash identify the source file the model was cooked from.
+struct ModelCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t textureIndexCount;
+    uint32_t flags;
+    float weldEpsilon;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    float aabbMin[3];
+    float aabbMax[3];
+};
+
+// A mesh of a cooked model, offsets are from the start of the file and
+// textures index the texture indices that follow the mesh table. The
+// optimization stats are 0 if the mesh wasn't optimized.
+struct ModelCacheMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    float aabbMin[3];
+    float aabbMax[3];
+    MeshOptimizationStats optimization;
+};
+
+// A texture reference of a cooked model, offsets are into the string table
+struct ModelCacheTexture {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+/*
+* A cooked model file stored next to its source as <source>.ogecache.
+* It holds the vertices, indices, bounds and texture references of the
+* meshes exactly as Model produces them, so a model can be loaded by
+* memory-mapping the file and uploading the vertex data in place. The
+* file is stale when the size of the source changes, or when both its
+* modification time and content hash change, or when its meshes weren't
+* welded, optimized and split the way they are currently imported.
+* Material files are not tracked, remove the cooked file after editing one.
+*/
+class ModelCache {
+ public:
+    // Constructor
+    ModelCache() = default;
+
+    // Maps the cooked file of a source file, fails if it is missing or stale
+    bool Open(const std::string& sourcePath);
+
+    // Unmaps the cooked file
+    void Close();
+
+    // Gets the min and max coordinates of the whole model
+    glm::vec3 GetMinCoords() const;
+    glm::vec3 GetMaxCoords() const;
+
+    // Gets the meshes of the cooked model
+    unsigned int GetMeshCount() const;
+    const ModelCacheMesh& GetMesh(unsigned int index) const;
+    const Vertex* GetVertices(unsigned int meshIndex) const;
+    const unsigned int* GetIndices(unsigned int meshIndex) const;
+    const uint32_t* GetTextureIndices(unsigned int meshIndex) const;
+
+    // Checks that the indices of a mesh are in range, before they are used on the CPU
+    bool ValidateIndices(unsigned int meshIndex) const;
+
+    // Gets the texture references of the cooked model
+    unsigned int GetTextureCount() const;
+    void GetTexture(unsigned int index, std::string& type_out, std::string& path_out) const;
+
+    // Writes the cooked file of a source file from imported meshes
+    static bool Write(
+        const std::string& sourcePath,
+        const std::vector<PendingMesh>& meshes,
+        const std::vector<Texture>& textures,
+        glm::vec3 aabbMin,
+        glm::vec3 aabbMax);
+
+    // Gets the path of the cooked file of a source file
+    static std::string GetCachePath(const std::string& sourcePath);
+
+    // Enables or disables reading and writing cooked files, enabled by default
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+ private:
+    MappedFile file;
+    const ModelCacheHeader* header = nullptr;
+    const ModelCacheMesh* meshes = nullptr;
+    const ModelCacheTexture* textures = nullptr;
+    const uint32_t* textureIndices = nullptr;
+    const char* strings = nullptr;
+
+    // Maps a cooked file and checks its header and tables
+    bool mapFile(const std::string& cachePath);
+
+    // Checks that all tables and arrays of the mapped file are inside it
+    bool validate() const;
+};
+
+#endif  // MODEL_CACHE_H
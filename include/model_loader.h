@@ -0,0 +1,47 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <model.h>
+#include <thread_pool.h>
+#include <upload_ring.h>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+* Loads models without blocking the render thread. The Assimp import,
+* mesh conversion and texture decoding of a model run on a worker
+* thread, then the GL objects are created on the render thread by
+* Update in slices of bounded time. Texture uploads are staged through
+* a ring of persistently mapped pixel buffers.
+*/
+class ModelLoader {
+ public:
+    // Constructor, 0 threads uses one thread less than the hardware has
+    explicit ModelLoader(unsigned int threadCount = 0);
+
+    // Starts loading a model, it can be drawn once IsReady returns true
+    std::shared_ptr<Model> LoadAsync(const std::string& path, bool buildBVH = false);
+
+    // Finishes loaded models on the render thread for about budgetMilliseconds
+    void Update(double budgetMilliseconds = 2.0);
+
+    // Gets the number of models that are not ready yet
+    size_t GetPendingCount() const;
+
+ private:
+    // A model being loaded and the import running for it on a worker
+    struct PendingModel {
+        std::shared_ptr<Model> model;
+        std::future<void> import;
+        bool imported;
+    };
+
+    ThreadPool pool;
+    UploadRing uploadRing;
+    std::vector<PendingModel> pending;
+};
+
+#endif  // MODEL_LOADER_H
@@ -0,0 +1,62 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <mesh.h>
+#include <shader.h>
+
+#include <cstdint>
+#include <vector>
+
+// A mesh draw gathered for the frame, instanced if instanceCount > 0 and
+// drawn from the scene's geometry pool if pooled
+struct DrawItem {
+    uint64_t key;
+    Shader* shader_p;
+    Mesh* mesh_p;
+    unsigned int modelIndex;
+    GLintptr objectOffset;
+    GLsizeiptr objectSize;
+    GLintptr instanceOffset;
+    GLsizei instanceCount;
+    bool pooled;
+};
+
+/*
+* Collects the draws of a frame and orders them by a 64-bit sort key so
+* that draws sharing a program, material and vertex array are submitted
+* next to each other.
+*/
+class RenderQueue {
+ public:
+    // Constructor
+    RenderQueue() = default;
+
+    // Builds a sort key from the state a draw needs
+    static uint64_t MakeKey(GLuint program, unsigned int materialID, GLuint vertexArray);
+
+    // Removes all items, keeping the allocated memory
+    void Clear();
+
+    // Adds an item to the queue
+    void Add(const DrawItem& item);
+
+    // Sorts the items by key
+    void Sort();
+
+    // Gets the items, sorted if Sort has been called
+    const std::vector<DrawItem>& GetItems() const;
+
+ private:
+    std::vector<DrawItem> items;
+    std::vector<DrawItem> sorted;
+
+    // Scratch buffers for the radix sort
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> tempKeys;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> tempIndices;
+};
+
+#endif  // RENDER_QUEUE_H
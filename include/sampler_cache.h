@@ -0,0 +1,52 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Anisotropic filtering, core in GL 4.6 and an extension before
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+
+// Filtering and wrapping of a sampler object
+struct SamplerState {
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;
+    float maxAnisotropy = 1.0f;
+
+    bool operator==(const SamplerState& other) const;
+};
+
+/*
+* Engine wide cache of sampler objects. Textures only hold their images,
+* how they are filtered and wrapped comes from the sampler bound to their
+* texture unit. A few samplers are shared by all textures, so the same
+* state is not duplicated in every texture. Material textures are drawn
+* with the material sampler, changing its state changes the filtering
+* of every model at once. Samplers are never modified after creation.
+* Must only be used on the render thread.
+*/
+class SamplerCache {
+ public:
+    // Gets the sampler with a state, it is created on first use
+    static GLuint Get(const SamplerState& state);
+
+    // Gets the sampler material textures are drawn with
+    static GLuint GetMaterialSampler();
+
+    // Changes the filtering and wrapping of all material textures
+    static void SetMaterialState(const SamplerState& state);
+    static const SamplerState& GetMaterialState();
+
+    // Gets the number of samplers that have been created
+    static size_t GetSamplerCount();
+
+    // Deletes all samplers, must be called before the context is destroyed
+    static void Clear();
+};
+
+#endif  // SAMPLER_CACHE_H
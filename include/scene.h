@@ -3,7 +3,15 @@
 
 #include <model.h>
 #include <camera.h>
+#include <uniform_buffer.h>
+#include <buffer_ring.h>
+#include <render_queue.h>
+#include <gl_state_cache.h>
+#include <geometry_pool.h>
+#include <frustum.h>
+#include <bvh.h>
 
+#include <cstring>
 #include <vector>
 #include <iostream>
 
@@ -11,6 +19,23 @@ template<typename T>
 struct UniformData {
     std::string name;
     T value;
+    UniformHandle<T> handle;
+    GLint offset = -1;
+};
+
+// Offsets of the members of a shader's Object uniform block
+struct ObjectBlockLayout {
+    GLint size = 0;
+    GLint model = -1;
+    GLint normalMatrix = -1;
+};
+
+// Handles to plain uniforms the scene sets for shaders without uniform blocks
+struct SceneUniforms {
+    UniformHandle<glm::mat4> model;
+    UniformHandle<glm::mat4> view;
+    UniformHandle<glm::mat4> projection;
+    UniformHandle<glm::vec3> viewPos;
 };
 
 struct ModelData {
@@ -18,6 +43,27 @@ struct ModelData {
     glm::mat4 modelMatrix;
     Shader* shader_p;
     std::vector<UniformData<glm::vec3>> vec3_uniforms;
+    SceneUniforms uniforms;
+    ObjectBlockLayout objectBlock;
+    glm::mat4 normalMatrix;
+    bool instanced;
+};
+
+// Counters of the frustum culling of the last drawn frame, culled meshes
+// are the meshes culled on their own inside visible models
+struct CullingStats {
+    unsigned int visibleModels = 0;
+    unsigned int culledModels = 0;
+    unsigned int visibleMeshes = 0;
+    unsigned int culledMeshes = 0;
+};
+
+// Models with the same model, shader and uniforms that are drawn with
+// one instanced draw call per mesh
+struct InstanceGroup {
+    Model* model_p;
+    Shader* shader_p;
+    std::vector<unsigned int> modelIndices;
 };
 
 class Scene {
@@ -44,14 +90,27 @@ class Scene {
     // Renders the scene
     void Draw();
 
-    // Adds a model to the scene
-    void AddModel(
+    // Finds the nearest model under screenX, screenY (from bottom left), -1 if there is none
+    int Pick(int screenX, int screenY);
+
+    // Finds the nearest model under screenX, screenY and the triangle that was hit
+    int Pick(int screenX, int screenY, RaycastHit& hit_out);
+
+    // Adds a model to the scene and returns its index, models that are
+    // still loading are skipped until they are ready
+    unsigned int AddModel(
         Model* model_p,
         glm::mat4 modelMatrix,
         Shader* shader_p,
         std::vector<UniformData<glm::vec3>> vec3_uniforms = {});
 
-    // Clears the vector of model data
+    // Moves a model, its bounds are refit in the picking BVH on the next pick
+    void SetModelMatrix(unsigned int index, glm::mat4 modelMatrix);
+
+    // Gets the data of a model added to the scene
+    const ModelData& GetModel(unsigned int index) const;
+
+    // Clears the vector of model data and empties the geometry pool
     void ClearModels();
 
     // Sets the scene's camera
@@ -60,14 +119,104 @@ class Scene {
     // Updates the view and projection matrices
     void UpdateMatrices(int screenWidth, int screenHeight);
 
+    // Gets the state change counters of the last drawn frame
+    const RenderStats& GetRenderStats() const;
+
+    // Draws instanced models from a shared geometry pool with multi-draw indirect
+    void SetMultiDrawIndirect(bool enabled);
+
+    // Skips models and meshes outside the view frustum, enabled by default
+    void SetFrustumCulling(bool enabled);
+
+    // Updates texture streaming at the end of Draw, enabled by default, only the last scene of a frame should
+    void SetStreamingUpdate(bool enabled);
+
+    // Gets the culling counters of the last drawn frame
+    const CullingStats& GetCullingStats() const;
+
+    // Gets the index memory of the distinct models in the scene
+    IndexMemoryStats GetIndexMemoryStats() const;
+
  private:
     std::vector<ModelData> models;
     Camera* camera;
     glm::mat4 projection;
     glm::mat4 view;
+    int screenWidth = 0;
+    int screenHeight = 0;
+
+    // World space bounds of every model and the frustum they are culled against
+    bool frustumCulling = true;
+    Frustum frustum;
+    BoundsArray modelBounds;
+    std::vector<uint8_t> modelVisibility;
+    CullingStats cullingStats;
+
+    // Whether Draw ends with TextureStreamer::Update
+    bool streamingUpdate = true;
+
+    // Hierarchy over the model bounds for picking, rebuilt when models are
+    // added and refit when they move
+    BVH pickingBVH;
+    bool pickingBVHDirty = true;
+    bool pickingBVHMoved = false;
+
+    // Models that were not ready when they were added
+    std::vector<unsigned int> pendingModels;
+
+    // Models drawn with an instanced shader, grouped for instancing
+    std::vector<InstanceGroup> instanceGroups;
+    unsigned int instancedModelCount = 0;
+
+    // Uniform buffers for the Camera block and the per-object Object blocks
+    GLBuffer cameraBuffer;
+    BufferRing objectRing;
+    GLint maxObjectBlockSize = 0;
+
+    // Instance data of the instance groups
+    BufferRing instanceRing{sizeof(InstanceData)};
+
+    // Geometry and indirect commands of the multi-draw indirect path
+    bool multiDrawIndirect = false;
+    GeometryPool geometryPool;
+    BufferRing indirectRing{sizeof(DrawElementsIndirectCommand)};
+
+    // Draws of the current frame and the state they are submitted through
+    RenderQueue queue;
+    GLStateCache state;
+
+    // Sets the plain uniforms for a model
+    void SetModelUniforms(const ModelData& modelData);
+
+    // Writes the Object block of a model to the ring
+    GLintptr WriteObjectBlock(const ModelData& modelData);
+
+    // Writes the instance data of the visible models of a group to the ring
+    GLintptr WriteInstanceData(const InstanceGroup& group, GLsizei& count_out);
+
+    // Sets up the models that have become ready since the last frame
+    void UpdatePendingModels();
+
+    // Updates the world space bounds of a model from its model matrix
+    void UpdateModelBounds(unsigned int index);
+
+    // Tests all models against the frustum
+    void CullModels();
+
+    // Checks if a mesh of a partially visible model is inside the frustum
+    bool IsMeshVisible(const ModelData& modelData, const Mesh& mesh);
+
+    // Requests the streamed textures of the visible models at their size on screen
+    void RequestTextures();
+
+    // Adds a model drawn with an instanced shader to a matching group
+    void AddToInstanceGroup(unsigned int modelIndex);
+
+    // Draws a run of pooled items with one multi-draw indirect call
+    void SubmitIndirect(const std::vector<DrawItem>& items, size_t begin, size_t end);
 
-    // Sets uniforms for a model
-    void SetModelUniforms(Shader* shader_p, std::vector<UniformData<glm::vec3>> vec3_uniforms);
+    // Checks if two pooled items can be drawn by the same indirect call
+    bool CanShareIndirectDraw(const DrawItem& first, const DrawItem& item);
 };
 
 #endif  // SCENE_H
\ No newline at end of file
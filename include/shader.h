@@ -3,30 +3,108 @@
 
 #include <glad/glad.h>
 
+#include <gl_handle.h>
+
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Pre-resolved location of a uniform of type T
+template<typename T>
+struct UniformHandle {
+    GLint location = -1;
+
+    bool IsValid() const { return location >= 0; }
+};
+
+// An active uniform reflected from a linked program, uniforms in a
+// uniform block have no location but an offset into the block
+struct UniformInfo {
+    std::string name;
+    GLenum type;
+    GLint size;
+    GLint location;
+    GLint blockIndex;
+    GLint offset;
+};
+
 class Shader {
  public:
-    // Program ID
-    unsigned int ID;
+    // Program ID, deleted with the shader
+    GLProgram ID;
 
     // Constructor reads the shader file and builds
     Shader(const char* vertexPath, const char* fragmentPath);
 
+    // Shaders own their program, they can be moved but not copied
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    Shader(Shader&&) = default;
+    Shader& operator=(Shader&&) = default;
+
     // Sets the shader as active
     void use();
 
+    // Gets a typed handle to a uniform, invalid if the uniform is not active
+    template<typename T>
+    UniformHandle<T> GetUniform(const std::string &name) const {
+        return UniformHandle<T>{GetUniformLocation(name)};
+    }
+
+    // Gets the location of a uniform from the reflected table
+    GLint GetUniformLocation(const std::string &name) const;
+
+    // Gets the byte offset of a uniform inside its uniform block
+    GLint GetUniformOffset(const std::string &name) const;
+
+    // Gets the data size of a uniform block, 0 if the block is not active
+    GLint GetUniformBlockSize(const std::string &blockName) const;
+
+    // Gets all active uniforms of the program
+    const std::vector<UniformInfo>& GetUniforms() const;
+
+    // Gets the number that identifies the shader, never reused unlike program names
+    uint64_t GetGeneration() const;
+
+    // Checks if the program has an active vertex attribute
+    bool HasAttribute(const std::string &name) const;
+
+    // Gets the texture unit a sampler uniform reads from, -1 if the uniform is not active
+    GLint GetSamplerUnit(const std::string &name) const;
+
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
     void setMat4(const std::string &name, glm::mat4 value) const;
     void setVec3(const std::string &name, glm::vec3 value) const;
     void setVec3(const std::string &name, float x, float y, float z) const;
+
+    // Setters for pre-resolved handles, these never touch strings
+    void set(UniformHandle<bool> handle, bool value) const;
+    void set(UniformHandle<int> handle, int value) const;
+    void set(UniformHandle<float> handle, float value) const;
+    void set(UniformHandle<glm::mat4> handle, const glm::mat4 &value) const;
+    void set(UniformHandle<glm::vec3> handle, const glm::vec3 &value) const;
+
+ private:
+    // Flat table of active uniforms and a name index into it
+    std::vector<UniformInfo> uniforms;
+    std::unordered_map<std::string, int> uniformIndices;
+
+    // Number of the shader, taken from a process-wide counter
+    uint64_t generation;
+
+    // Queries all active uniforms after linking
+    void reflectUniforms();
+
+    // Adds an entry to the uniform table
+    void addUniform(const std::string &name, GLenum type, GLint size, GLint location, GLint blockIndex = -1, GLint offset = -1);
 };
 
-#endif  // SHADER_H
\ No newline at end of file
+#endif  // SHADER_H
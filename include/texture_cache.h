@@ -0,0 +1,76 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <compressed_texture.h>
+#include <gl_handle.h>
+
+#include <future>
+#include <memory>
+#include <string>
+
+// Decoded pixels of a texture waiting to be uploaded, the pixels are
+// freed with the image. Block compressed images hold their mapped file
+// instead of pixels. Images prepared for streaming hold the pixels of
+// their start level and the file their higher levels are loaded from,
+// width and height are always those of the full image.
+struct ImageData {
+    std::unique_ptr<unsigned char, void (*)(void*)> pixels{nullptr, stbi_image_free};
+    std::unique_ptr<CompressedTexture> compressed;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    double decodeMilliseconds = 0.0;
+    std::string streamFilename;
+    int startLevel = 0;
+    int levelCount = 0;
+};
+
+// A texture shared through the texture cache. It is decoded on a worker
+// thread and uploaded by the first model that finishes loading it, the
+// GL texture is deleted when the last reference goes away.
+struct CachedTexture {
+    std::string path;
+    GLTexture id;
+    bool uploaded = false;
+    bool decoded = false;
+    ImageData image;
+    std::future<ImageData> decoding;
+};
+
+/*
+* Engine wide cache of the textures used by models, keyed by the
+* canonical path of the image file. Models referencing the same image
+* share one decode and one GL texture. Images with a compressed KTX2 or
+* DDS file next to them are loaded from that file instead. The cache only holds weak
+* references, a texture is freed once no model uses it anymore.
+* Acquire may be called from any thread, the GL texture of an entry is
+* only created and used on the render thread.
+*/
+class TextureCache {
+ public:
+    // Gets the texture of an image file, decoding starts if it is not cached
+    static std::shared_ptr<CachedTexture> Acquire(const std::string& imageFilename);
+
+    // Takes ownership of a texture created on the render thread that has no image file
+    static std::shared_ptr<CachedTexture> Adopt(unsigned int id);
+
+    // Gets the number of textures that are in use
+    static size_t GetTextureCount();
+
+    // Decodes an image file into memory, compressed files are only mapped
+    static ImageData Decode(const std::string& filename);
+
+    // Enables or disables loading compressed files in place of images
+    static void SetCompressedEnabled(bool enabled);
+    static bool IsCompressedEnabled();
+
+ private:
+    // Removes an entry that is no longer used and deletes its GL texture
+    static void release(CachedTexture* texture);
+};
+
+#endif  // TEXTURE_CACHE_H
@@ -0,0 +1,71 @@
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+
+#include <vector>
+
+// Textures are only packed if neither side is larger than this
+const int MAX_PACKED_TEXTURE_SIZE = 512;
+
+// Width of the atlases, and the pixels of repeated edge around each
+// texture in them. Atlases only get the mip levels the gutter covers.
+const int ATLAS_WIDTH = 2048;
+const int ATLAS_GUTTER = 8;
+const int ATLAS_LEVELS = 4;
+
+// Texture coordinates this far outside [0, 1] still count as inside, the
+// gutter covers them
+const float ATLAS_TEXCOORD_TOLERANCE = 0.001f;
+
+// Counters of the packing of a model's textures. Binds are the texture
+// binds needed to draw every material once in sorted order.
+struct TexturePackingStats {
+    unsigned int arrays = 0;
+    unsigned int arrayLayers = 0;
+    unsigned int atlases = 0;
+    unsigned int atlasTextures = 0;
+    unsigned int texturesReleased = 0;
+    unsigned int bindsBefore = 0;
+    unsigned int bindsAfter = 0;
+};
+
+// The textures used together by meshes. The textures are replaced by
+// their packed versions, and meshes of a material packed into an atlas
+// must transform their texture coordinates with uvTransform, scale in
+// xy and offset in zw.
+struct PackedMaterial {
+    std::vector<Texture> textures;
+    bool unitTexCoords = false;
+    glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+/*
+* Packs the small textures of a model so that its meshes share fewer
+* textures. Textures with the same size, format and mip count are copied
+* into the layers of a texture array, which shaders read through a
+* sampler2DArray and a layer uniform. Materials whose textures have a
+* size of their own are packed into atlases with a gutter of repeated
+* edge pixels around each texture, as long as their meshes keep their
+* texture coordinates within [0, 1]. The copies are made on the GPU from
+* uploaded textures. Packing only happens while textures are bound per
+* mesh, models loaded with the material table enabled are not packed.
+*/
+class TexturePacker {
+ public:
+    // Packs the textures of materials, returns the arrays and atlases that were created
+    static std::vector<GLuint> Pack(std::vector<PackedMaterial>& materials, TexturePackingStats& stats_out);
+
+    // Counts the texture binds needed to draw every material once in sorted order
+    static unsigned int CountBinds(const std::vector<PackedMaterial>& materials);
+
+    // Enables or disables packing the textures of models as they are loaded
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+};
+
+#endif  // TEXTURE_PACKER_H
@@ -0,0 +1,75 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <texture_cache.h>
+
+#include <cstddef>
+#include <string>
+
+// Streamed textures start resident with their largest level no larger than this
+const int STREAMING_START_SIZE = 64;
+
+// Default budget of the levels of streamed textures
+const size_t DEFAULT_STREAMING_BUDGET = 256 * 1024 * 1024;
+
+// Number of textures loading levels on the streaming thread at once
+const unsigned int MAX_STREAMING_LOADS = 4;
+
+// Counters of texture streaming, levels and evictions are of the last
+// update. Resident bytes are the estimated size of the resident levels
+// of streamed textures.
+struct StreamingStats {
+    size_t residentBytes = 0;
+    size_t budgetBytes = 0;
+    unsigned int streamedTextures = 0;
+    unsigned int pendingRequests = 0;
+    unsigned int levelsLoaded = 0;
+    unsigned int evictions = 0;
+};
+
+/*
+* Engine wide streaming of the mip levels of large textures. Once
+* enabled, textures are decoded at full size on the decoding thread but
+* only uploaded from the level no larger than STREAMING_START_SIZE down.
+* Every frame the scene requests each texture at the size its models
+* cover on screen, and the higher levels are loaded on a streaming thread
+* and uploaded in the next update. The resident levels of streamed
+* textures are kept within a budget by evicting the top levels of the
+* least recently used textures. Streamed textures have mutable storage
+* with a base level, so levels can be freed while the texture keeps its
+* name. They are only streamed while textures are bound per mesh, the
+* material table can't use them. Must only be used on the render thread,
+* except PrepareImage.
+*/
+class TextureStreamer {
+ public:
+    // Enables or disables streaming of textures loaded from then on
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // Sets the budget of the resident levels of streamed textures in bytes
+    static void SetBudget(size_t bytes);
+    static size_t GetBudget();
+
+    // Reduces a decoded image to the level its texture starts at, called on the decoding thread
+    static void PrepareImage(ImageData& image, const std::string& filename);
+
+    // Uploads the first levels of a prepared image and starts streaming the texture
+    static void Upload(GLuint texture, ImageData& image);
+
+    // Requests a texture for this frame at the size in pixels it covers on screen
+    static void Request(GLuint texture, float screenSize);
+
+    // Uploads loaded levels, evicts levels over the budget and starts new loads, once per frame, called by Scene::Draw
+    static void Update();
+
+    // Stops streaming a texture that is about to be deleted
+    static void ReleaseTexture(GLuint texture);
+
+    // Gets the counters of streaming
+    static StreamingStats GetStats();
+};
+
+#endif  // TEXTURE_STREAMER_H
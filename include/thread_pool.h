@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+* A fixed set of worker threads that run submitted tasks in the order
+* they were submitted. Tasks must not make GL calls, the GL context is
+* only current on the render thread.
+*/
+class ThreadPool {
+ public:
+    // Constructor, 0 threads uses one thread less than the hardware has
+    explicit ThreadPool(unsigned int threadCount = 0);
+
+    // Destructor finishes the queued tasks and joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a task and returns a future for its result
+    template<typename F>
+    auto Submit(F&& task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([packaged]() { (*packaged)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    // Gets the number of worker threads
+    unsigned int GetThreadCount() const;
+
+ private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    // Runs queued tasks until the pool is destroyed
+    void workerLoop();
+};
+
+#endif  // THREAD_POOL_H
@@ -0,0 +1,66 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <bvh.h>
+
+#include <vector>
+
+// Four triangles stored component by component so that a ray can be
+// tested against all of them at once, unused lanes are degenerate
+struct TrianglePacket {
+    float v0x[4], v0y[4], v0z[4];
+    float e1x[4], e1y[4], e1z[4];
+    float e2x[4], e2y[4], e2z[4];
+    unsigned int triangle[4];
+};
+
+/*
+* A bounding volume hierarchy over the triangles of a mesh for exact ray
+* casts. The leaves hold packets of up to four triangles that are tested
+* against the ray with SIMD.
+*/
+class TriangleBVH {
+ public:
+    // Constructor
+    TriangleBVH() = default;
+
+    // Builds the tree over the triangles of indexed vertices
+    void Build(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+    void Build(const Vertex* vertices, const unsigned int* indices, size_t indexCount);
+
+    // Finds the nearest triangle hit by a ray closer than tMax
+    bool Intersect(
+        const glm::vec3& rayOrigin,
+        const glm::vec3& rayDir,
+        float tMax,
+        unsigned int& triangle_out,
+        glm::vec2& barycentrics_out,
+        float& distance_out) const;
+
+    // Gets the number of triangles in the tree
+    size_t GetTriangleCount() const;
+
+    // Gets the number of nodes in the tree
+    size_t GetNodeCount() const;
+
+ private:
+    // Nodes of the tree, a leaf holds count packets starting at leftOrFirst
+    std::vector<BVHNode> nodes;
+    std::vector<TrianglePacket> packets;
+    size_t triangleCount = 0;
+};
+
+// Tests a ray against a triangle, distances are in units of the ray direction
+bool IntersectRayTriangle(
+    const glm::vec3& rayOrigin,
+    const glm::vec3& rayDir,
+    const glm::vec3& v0,
+    const glm::vec3& v1,
+    const glm::vec3& v2,
+    float& distance_out,
+    glm::vec2& barycentrics_out);
+
+#endif  // TRIANGLE_BVH_H
@@ -0,0 +1,19 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+// Binding points of the uniform blocks shared by the engine shaders
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint OBJECT_BLOCK_BINDING = 1;
+
+// std140 layout of the Camera uniform block
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 viewPos;
+};
+
+#endif  // UNIFORM_BUFFER_H
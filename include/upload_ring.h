@@ -0,0 +1,63 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <glad/glad.h>
+
+#include <gl_handle.h>
+
+#include <cstddef>
+#include <deque>
+
+/*
+* A persistently mapped buffer used as a ring of staging ranges for
+* uploads, for example as a pixel unpack buffer. Ranges are handed out
+* in order and fenced once the commands reading them are issued. Space
+* is only reclaimed from ranges whose fence has already signaled, the
+* ring never waits for the GPU and reports that it is full instead.
+*/
+class UploadRing {
+ public:
+    // Constructor, the buffer is created on first use
+    explicit UploadRing(GLsizeiptr size = 64 * 1024 * 1024);
+
+    // Destructor releases the buffer and fences
+    ~UploadRing();
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // Allocates a staging range, -1 if the ring has no room right now
+    GLintptr Allocate(GLsizeiptr size);
+
+    // Fences the ranges allocated since the last commit
+    void Commit();
+
+    // Gets a CPU pointer to an allocated range
+    void* GetPointer(GLintptr offset);
+
+    // Gets the GL buffer
+    GLuint GetBuffer();
+
+    // Gets the size of the ring in bytes, larger uploads never fit
+    GLsizeiptr GetSize() const;
+
+ private:
+    // An allocated range, the newest range of each commit holds the
+    // fence of the commands reading the ranges of that commit
+    struct Range {
+        GLintptr offset;
+        GLsync fence;
+        bool committed;
+    };
+
+    GLBuffer buffer;
+    unsigned char* mapped = nullptr;
+    GLsizeiptr size;
+    GLintptr head = 0;
+    std::deque<Range> ranges;
+
+    // Frees the oldest ranges whose fences have signaled
+    void retire();
+};
+
+#endif  // UPLOAD_RING_H
@@ -0,0 +1,84 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// How the vertices of a mesh are stored in its vertex buffer
+enum VertexLayout : uint8_t {
+    VERTEX_LAYOUT_FLOAT = 0,
+    VERTEX_LAYOUT_QUANTIZED_OCT8 = 1,
+    VERTEX_LAYOUT_QUANTIZED_OCT16 = 2
+};
+
+// A vertex of VERTEX_LAYOUT_QUANTIZED_OCT8, 12 bytes. Positions are
+// 16-bit unsigned normalized relative to the bounds of the mesh, normals
+// are octahedral encoded in two 8-bit signed normalized values and
+// texture coordinates are half floats.
+struct QuantizedVertexOct8 {
+    uint16_t position[3];
+    int8_t normal[2];
+    uint16_t texCoords[2];
+};
+
+// A vertex of VERTEX_LAYOUT_QUANTIZED_OCT16, 16 bytes, the same as
+// QuantizedVertexOct8 with 16-bit octahedral normals
+struct QuantizedVertexOct16 {
+    uint16_t position[3];
+    uint16_t padding;
+    int16_t normal[2];
+    uint16_t texCoords[2];
+};
+
+/*
+* Converts Vertex data into the compact layouts meshes can be uploaded
+* in. Quantized positions are decoded in the vertex shader with a matrix
+* mapping the unit cube onto the bounds of the mesh, normals with an
+* octahedral decode, and texture coordinates are read as half floats by
+* the vertex fetch. Positions come first in every layout, so they can be
+* split off into a tightly packed stream of their own for passes that
+* only read positions. Makes no GL calls.
+*/
+class VertexFormat {
+ public:
+    // Gets the size of a vertex in a layout
+    static size_t GetStride(VertexLayout layout);
+
+    // Gets the size of a position in a layout, the stride of a separate position stream
+    static size_t GetPositionSize(VertexLayout layout);
+
+    // Gets the offset of the first attribute after the position in a layout
+    static size_t GetAttributesOffset(VertexLayout layout);
+
+    // Encodes vertices into a layout with positions relative to the given bounds
+    static std::vector<uint8_t> Encode(const Vertex* vertices, size_t count, VertexLayout layout,
+        glm::vec3 aabbMin, glm::vec3 aabbMax);
+
+    // Splits encoded vertices into a position stream and a stream of the other attributes
+    static void SplitPositions(const std::vector<uint8_t>& encoded, VertexLayout layout,
+        std::vector<uint8_t>& positions_out, std::vector<uint8_t>& attributes_out);
+
+    // Gets the matrix that maps encoded positions back to the given bounds
+    static glm::mat4 GetPositionDecode(VertexLayout layout, glm::vec3 aabbMin, glm::vec3 aabbMax);
+
+    // Encodes a unit vector onto the octahedron, both coordinates in [-1, 1]
+    static glm::vec2 EncodeOctahedral(glm::vec3 normal);
+
+    // Decodes a unit vector encoded with EncodeOctahedral
+    static glm::vec3 DecodeOctahedral(glm::vec2 encoded);
+
+    // Sets the layout of the meshes of models that are loaded afterwards, float by default
+    static void SetLayout(VertexLayout layout);
+    static VertexLayout GetLayout();
+
+    // Makes the meshes of models loaded afterwards keep positions in a separate stream, off by default
+    static void SetPositionStream(bool enabled);
+    static bool IsPositionStreamEnabled();
+};
+
+#endif  // VERTEX_FORMAT_H
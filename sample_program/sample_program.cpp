@@ -6,12 +6,18 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <shader.h>
+#include <gl_handle.h>
 #include <camera.h>
 #include <model.h>
 #include <scene.h>
+#include <model_loader.h>
+#include <material_table.h>
+#include <texture_streamer.h>
+#include <sampler_cache.h>
 
 #include <iostream>
 #include <filesystem>
+#include <string>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -67,70 +73,104 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+    // Stream the mip levels of large textures with --stream, streamed
+    // textures are bound per mesh. Otherwise fetch material textures from
+    // the material table, bindless where supported.
+    bool streaming = argc > 1 && std::string(argv[1]) == "--stream";
+    if (streaming) {
+        TextureStreamer::SetEnabled(true);
+        std::cout << "Material textures: streamed" << std::endl;
+    } else {
+        MaterialMode materialMode = MaterialTable::Enable((GLADloadproc)glfwGetProcAddress);
+        std::cout << "Material textures: " << (materialMode == MATERIAL_MODE_BINDLESS ? "bindless" : "texture arrays") << std::endl;
+    }
+
     // Flip loaded textures on y-axis before loading model
     stbi_set_flip_vertically_on_load(true);
 
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
 
-    // Build and compile the shader program
-    std::string dir = std::filesystem::weakly_canonical(std::filesystem::path(argv[0])).parent_path().string();
-    Shader modelShader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
+    // Report GL objects that are still alive at shutdown
+    GLObjectTracker::SetLeakCheck(true);
+
+    // The shader, model and scene release their GL objects at the end of
+    // this block, while the context still exists
+    {
+        // Build and compile the shader program
+        std::string dir = std::filesystem::weakly_canonical(std::filesystem::path(argv[0])).parent_path().string();
+        Shader modelShader((dir + "/shaders/light_shader.vs").c_str(), (dir + "/shaders/light_shader.fs").c_str());
     
-    // Load the model
-    Model model(dir + "/resources/objects/backpack/backpack.obj");
-    glm::mat4 modelMat = glm::mat4(1.0f);
-    Scene scene;
-    std::vector<UniformData<glm::vec3>> vec3_uniforms;
-    scene.AddModel(&model, modelMat, &modelShader, vec3_uniforms);
-    scene.SetCamera(&camera);
-
-    // Uncomment to set wireframe mode on
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Time logic
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        // Load the model with triangle BVHs for picking in the background,
+        // the scene draws it once it is ready
+        ModelLoader loader;
+        std::shared_ptr<Model> model = loader.LoadAsync(dir + "/resources/objects/backpack/backpack.obj", true);
+        glm::mat4 modelMat = glm::mat4(1.0f);
+        Scene scene;
+        std::vector<UniformData<glm::vec3>> vec3_uniforms;
+        scene.AddModel(model.get(), modelMat, &modelShader, vec3_uniforms);
+        scene.SetCamera(&camera);
+
+        // Uncomment to set wireframe mode on
+        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        // Render loop
+        while (!glfwWindowShouldClose(window)) {
+            // Time logic
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
         
-        // Input
-        processInput(window);
+            // Input
+            processInput(window);
 
-        // Render
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            // Upload loaded models for at most 2 ms per frame
+            loader.Update(2.0);
+
+            // Render
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
-        // Activate shader
-        modelShader.use();
-
-        // Set lighting params
-        modelShader.setVec3("viewPos", camera.Position);
-        modelShader.setFloat("material.shininess", 0.3f);
-        modelShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        modelShader.setVec3("dirLight.ambient", glm::vec3(0.05f));
-        modelShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
-        modelShader.setVec3("dirLight.specular", glm::vec3(0.5f));
-
-        modelShader.setVec3("pointLights[0].position", 0.0f, 0.0f, 3.0f);
-        modelShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        modelShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        modelShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        modelShader.setFloat("pointLights[0].constant", 1.0f);
-        modelShader.setFloat("pointLights[0].linear", 0.09f);
-        modelShader.setFloat("pointLights[0].quadratic", 0.032f);
-
-        // Update matrices in the scene
-        scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
-
-        // Draw scene
-        scene.Draw();
-
-        // Swap buffers and poll for IO events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+            // Activate shader
+            modelShader.use();
+
+            // Set lighting params
+            modelShader.setFloat("material.shininess", 0.3f);
+            modelShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
+            modelShader.setVec3("dirLight.ambient", glm::vec3(0.05f));
+            modelShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
+            modelShader.setVec3("dirLight.specular", glm::vec3(0.5f));
+
+            modelShader.setVec3("pointLights[0].position", 0.0f, 0.0f, 3.0f);
+            modelShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
+            modelShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
+            modelShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
+            modelShader.setFloat("pointLights[0].constant", 1.0f);
+            modelShader.setFloat("pointLights[0].linear", 0.09f);
+            modelShader.setFloat("pointLights[0].quadratic", 0.032f);
+
+            // Update matrices in the scene
+            scene.UpdateMatrices(SCR_WIDTH, SCR_HEIGHT);
+
+            // Draw scene
+            scene.Draw();
+
+            // Pick the model under the cursor on click
+            if (markObject) {
+                RaycastHit hit;
+                int picked = scene.Pick((int)lastX, SCR_HEIGHT - (int)lastY, hit);
+                std::cout << "Picked model: " << picked << ", mesh: " << hit.mesh << ", triangle: " << hit.triangle << std::endl;
+                markObject = false;
+            }
+
+            // Swap buffers and poll for IO events
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
     }
-    
+    MaterialTable::Disable();
+    SamplerCache::Clear();
+    GLObjectTracker::ReportLeaks();
+
     // Deallocate all allocated glfw resources
     glfwTerminate();
     return 0;
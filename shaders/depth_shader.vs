@@ -0,0 +1,21 @@
+#version 450 core
+
+layout (location = 0) in vec3 aPos;
+
+layout (std140, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+};
+layout (std140, binding = 1) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+// Decode of quantized positions, set by the mesh. Positions are relative
+// to the bounds of the mesh.
+uniform mat4 positionDecode = mat4(1.0);
+
+void main() {
+    gl_Position = projection * view * model * positionDecode * vec4(aPos, 1.0);
+}
\ No newline at end of file
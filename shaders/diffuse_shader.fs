@@ -7,6 +7,14 @@ in vec2 TexCoords;
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 
+// Packed diffuse texture, read instead when its layer is set
+layout (binding = 24) uniform sampler2DArray texture_diffuse1_array;
+uniform int texture_diffuse1_layer = -1;
+
 void main() {
-    FragColor = texture(texture_diffuse1, TexCoords);
+    if (texture_diffuse1_layer < 0) {
+        FragColor = texture(texture_diffuse1, TexCoords);
+    } else {
+        FragColor = texture(texture_diffuse1_array, vec3(TexCoords, texture_diffuse1_layer));
+    }
 }
\ No newline at end of file
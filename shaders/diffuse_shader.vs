@@ -6,11 +6,21 @@ layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+};
+layout (std140, binding = 1) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+// Decode of quantized positions, set by the mesh. Positions are relative
+// to the bounds of the mesh.
+uniform mat4 positionDecode = mat4(1.0);
 
 void main() {
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * positionDecode * vec4(aPos, 1.0);
 }
\ No newline at end of file
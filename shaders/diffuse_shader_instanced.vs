@@ -0,0 +1,23 @@
+#version 450 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+
+layout (std140, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+};
+
+// Decode of quantized positions, set by the mesh. Positions are relative
+// to the bounds of the mesh.
+uniform mat4 positionDecode = mat4(1.0);
+
+void main() {
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * aInstanceModel * positionDecode * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 450 core
+#extension GL_ARB_bindless_texture : enable
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
@@ -29,31 +30,84 @@ in vec2 TexCoords;
 
 out vec4 FragColor;
 
-uniform vec3 viewPos;
+layout (std140, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+};
 uniform Material material;
+
+// Packed textures, read instead of the material samplers when their layer is set
+layout (binding = 24) uniform sampler2DArray texture_diffuse1_array;
+layout (binding = 25) uniform sampler2DArray texture_specular1_array;
+uniform int texture_diffuse1_layer = -1;
+uniform int texture_specular1_layer = -1;
+
+// Material table, read instead of the material samplers when materialIndex is set
+struct MaterialEntry {
+    uvec2 diffuseHandle;
+    uvec2 specularHandle;
+    int diffuseArray;
+    int diffuseLayer;
+    int specularArray;
+    int specularLayer;
+};
+layout (std430, binding = 0) readonly buffer Materials {
+    MaterialEntry materials[];
+};
+layout (binding = 16) uniform sampler2DArray materialArrays[8];
+uniform int materialIndex = -1;
+
 uniform DirLight dirLight;
 #define NR_POINT_LIGHTS 1
 uniform PointLight pointLights[NR_POINT_LIGHTS];
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 SampleMaterial(uvec2 handle, int array, int layer);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor);
 
 void main() {
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+
+    // Material colors, from the bound samplers, packed arrays or the material table
+    vec3 diffuseColor;
+    vec3 specularColor;
+    if (materialIndex < 0) {
+        diffuseColor = texture_diffuse1_layer < 0 ? vec3(texture(material.texture_diffuse1, TexCoords)) :
+            vec3(texture(texture_diffuse1_array, vec3(TexCoords, texture_diffuse1_layer)));
+        specularColor = texture_specular1_layer < 0 ? vec3(texture(material.texture_specular1, TexCoords)) :
+            vec3(texture(texture_specular1_array, vec3(TexCoords, texture_specular1_layer)));
+    } else {
+        MaterialEntry entry = materials[materialIndex];
+        diffuseColor = SampleMaterial(entry.diffuseHandle, entry.diffuseArray, entry.diffuseLayer);
+        specularColor = SampleMaterial(entry.specularHandle, entry.specularArray, entry.specularLayer);
+    }
 
     // Directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, diffuseColor, specularColor);
 
     // Point lights
     for(int i = 0; i < NR_POINT_LIGHTS; i++){
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir, diffuseColor, specularColor);
     }   
 
     FragColor = vec4(result, 1.0);
 }
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
+vec3 SampleMaterial(uvec2 handle, int array, int layer) {
+#ifdef GL_ARB_bindless_texture
+    if (handle != uvec2(0)) {
+        return vec3(texture(sampler2D(handle), TexCoords));
+    }
+#endif
+    if (array < 0) {
+        return vec3(0.0);
+    }
+    return vec3(texture(materialArrays[array], vec3(TexCoords, layer)));
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor) {
     vec3 lightDir = normalize(-light.direction);
     // Diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -61,13 +115,13 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // Combine
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     return (ambient + diffuse + specular);
 }
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor) {
     vec3 lightDir = normalize(light.position - FragPos);
     // Diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -78,9 +132,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     float dist = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist);
     // Combine
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -8,13 +8,36 @@ out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+};
+layout (std140, binding = 1) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+// Decode of quantized vertices, set by the mesh. Positions are relative
+// to the bounds of the mesh and normals octahedral encoded.
+uniform mat4 positionDecode = mat4(1.0);
+uniform bool octahedralNormals = false;
+
+vec3 decodeNormal(vec3 normal) {
+    if (!octahedralNormals) {
+        return normal;
+    }
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec4 position = positionDecode * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * position;
     TexCoords = aTexCoords;
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(normalMatrix) * decodeNormal(aNormal);
+    FragPos = vec3(model * position);
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#version 450 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aInstanceModel;
+layout (location = 7) in mat3 aInstanceNormal;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+
+layout (std140, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+};
+
+// Decode of quantized vertices, set by the mesh. Positions are relative
+// to the bounds of the mesh and normals octahedral encoded.
+uniform mat4 positionDecode = mat4(1.0);
+uniform bool octahedralNormals = false;
+
+vec3 decodeNormal(vec3 normal) {
+    if (!octahedralNormals) {
+        return normal;
+    }
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+void main() {
+    vec4 position = positionDecode * vec4(aPos, 1.0);
+    gl_Position = projection * view * aInstanceModel * position;
+    TexCoords = aTexCoords;
+    Normal = aInstanceNormal * decodeNormal(aNormal);
+    FragPos = vec3(aInstanceModel * position);
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <buffer_ring.h>
+
+BufferRing::BufferRing(GLint alignment) : alignment(alignment) {}
+
+BufferRing::~BufferRing() {
+    release();
+}
+
+/**
+ * Starts a new frame. Waits until the GPU is done with the region that
+ * is about to be reused, growing the buffer first if the region is too
+ * small for the frame.
+ *
+ * @param size The number of bytes the frame needs, use Align to account
+ *             for the padding of each range
+ *
+ * @returns void
+ */
+void BufferRing::BeginFrame(GLsizeiptr size) {
+    if (size > regionSize) {
+        allocate(size);
+    }
+
+    frame = (frame + 1) % BUFFER_RING_FRAMES;
+    if (fences[frame]) {
+        glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fences[frame]);
+        fences[frame] = 0;
+    }
+    head = frame * regionSize;
+    regionEnd = head + regionSize;
+}
+
+/**
+ * Ends the frame by fencing its region.
+ *
+ * @returns void
+ */
+void BufferRing::EndFrame() {
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * Allocates a range in the current frame region, aligned so that it can
+ * be bound with glBindBufferRange.
+ *
+ * @param size The size of the range in bytes
+ *
+ * @returns The offset of the range in the buffer, -1 if the region is full
+ */
+GLintptr BufferRing::Allocate(GLsizeiptr size) {
+    GLintptr offset = head;
+    GLintptr end = offset + Align(size);
+    if (end > regionEnd) {
+        return -1;
+    }
+    head = end;
+    return offset;
+}
+
+/**
+ * Gets a CPU pointer to a range in the mapped buffer.
+ *
+ * @param offset The offset of the range
+ *
+ * @returns A pointer to the range
+ */
+void* BufferRing::GetPointer(GLintptr offset) {
+    return mapped + offset;
+}
+
+/**
+ * Gets the GL buffer backing the ring.
+ *
+ * @returns The buffer name
+ */
+GLuint BufferRing::GetBuffer() {
+    return buffer;
+}
+
+/**
+ * Creates an immutable, persistently mapped buffer with one region of
+ * at least size bytes per frame in flight. Any previous buffer is
+ * released once the GPU is done with it.
+ *
+ * @param size The minimum size of a frame region in bytes
+ *
+ * @returns void
+ */
+void BufferRing::allocate(GLsizeiptr size) {
+    release();
+
+    // Round up so that every region starts aligned
+    regionSize = Align(size);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    buffer = GLBuffer::Create();
+    glNamedBufferStorage(buffer, regionSize * BUFFER_RING_FRAMES, NULL, flags);
+    mapped = (unsigned char*)glMapNamedBufferRange(buffer, 0, regionSize * BUFFER_RING_FRAMES, flags);
+}
+
+/**
+ * Waits for all frames in flight and deletes the buffer.
+ *
+ * @returns void
+ */
+void BufferRing::release() {
+    for (int i = 0; i < BUFFER_RING_FRAMES; i++) {
+        if (fences[i]) {
+            glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+    }
+    if (buffer) {
+        glUnmapNamedBuffer(buffer);
+        buffer.Reset();
+        mapped = nullptr;
+    }
+    regionSize = 0;
+}
+
+/**
+ * Rounds a size up to a multiple of the range alignment. Ranges returned
+ * from Allocate take up their aligned size in the frame region.
+ *
+ * @param size The size in bytes
+ *
+ * @returns The aligned size in bytes
+ */
+GLsizeiptr BufferRing::Align(GLsizeiptr size) {
+    if (alignment == 0) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    }
+    return ((size + alignment - 1) / alignment) * alignment;
+}
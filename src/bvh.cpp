@@ -0,0 +1,410 @@
+#include <bvh.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <future>
+
+// Number of bins used to evaluate split candidates along an axis
+const int BVH_BINS = 12;
+
+// Subtrees of nodes with at least this many boxes in the top levels of
+// the tree are built on their own thread
+const unsigned int BVH_PARALLEL_SIZE = 50000;
+const int BVH_PARALLEL_DEPTH = 3;
+
+/**
+ * Appends the nodes of a subtree built on its own to a node list. The
+ * root of the subtree replaces a placeholder node and the child indices
+ * of the other nodes are offset to where they end up in the list.
+ *
+ * @param nodeList The node list to append to
+ * @param rootIndex The index of the placeholder node for the subtree root
+ * @param subtree The nodes of the subtree, root first
+ * 
+ * @returns void
+ */
+static void appendSubtree(std::vector<BVHNode>& nodeList, unsigned int rootIndex, const std::vector<BVHNode>& subtree) {
+    // Subtree node i > 0 ends up at base + i - 1
+    unsigned int base = nodeList.size();
+    for (size_t i = 0; i < subtree.size(); i++) {
+        BVHNode node = subtree[i];
+        if (node.count == 0) {
+            node.leftOrFirst = base + node.leftOrFirst - 1;
+        }
+        if (i == 0) {
+            nodeList[rootIndex] = node;
+        } else {
+            nodeList.push_back(node);
+        }
+    }
+}
+
+/**
+ * Gets the surface area of a box.
+ *
+ * @param aabbMin The min coordinates of the box
+ * @param aabbMax The max coordinates of the box
+ * 
+ * @returns The surface area, 0 for an empty box
+ */
+static float surfaceArea(const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+    glm::vec3 extent = aabbMax - aabbMin;
+    if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+/**
+ * Tests a ray against an axis aligned box with the slab method.
+ *
+ * @param rayOrigin The origin of the ray
+ * @param invDir The reciprocal of each component of the ray direction
+ * @param aabbMin The min coordinates of the box
+ * @param aabbMax The max coordinates of the box
+ * @param tMax The distance beyond which hits are ignored
+ * 
+ * @returns The distance to where the ray enters the box, 0 if the origin
+ *          is inside it and -1 if the ray misses it
+ */
+float IntersectRayAABB(const glm::vec3& rayOrigin, const glm::vec3& invDir, const glm::vec3& aabbMin, const glm::vec3& aabbMax, float tMax) {
+    glm::vec3 t1 = (aabbMin - rayOrigin) * invDir;
+    glm::vec3 t2 = (aabbMax - rayOrigin) * invDir;
+    glm::vec3 tNear = glm::min(t1, t2);
+    glm::vec3 tFar = glm::max(t1, t2);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return enter <= exit ? enter : -1.0f;
+}
+
+/**
+ * Builds the tree over all boxes in an array, replacing any previous tree.
+ *
+ * @param bounds The boxes to build the tree over
+ * @param maxLeafSize Nodes with at most this many boxes are never split
+ * 
+ * @returns void
+ */
+void BVH::Build(const BoundsArray& bounds, unsigned int maxLeafSize) {
+    leafSize = maxLeafSize > 0 ? maxLeafSize : 1;
+    loadBoxes(bounds);
+    size_t count = boxMin.size();
+    indices.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        indices[i] = i;
+    }
+
+    nodes.clear();
+    if (count == 0) {
+        return;
+    }
+    nodes.reserve(2 * count);
+    BVHNode root;
+    root.leftOrFirst = 0;
+    root.count = count;
+    nodes.push_back(root);
+    updateNodeBounds(nodes[0]);
+    subdivide(nodes, 0, 0);
+}
+
+/**
+ * Updates the bounds of all nodes after the boxes have moved. The tree
+ * structure is kept, so the tree gets less efficient the further the
+ * boxes move from where they were when it was built. Must be called with
+ * the same number of boxes the tree was built with.
+ *
+ * @param bounds The moved boxes
+ * 
+ * @returns void
+ */
+void BVH::Refit(const BoundsArray& bounds) {
+    loadBoxes(bounds);
+    // Children are always stored after their parent
+    for (size_t i = nodes.size(); i-- > 0;) {
+        BVHNode& node = nodes[i];
+        if (node.count > 0) {
+            updateNodeBounds(node);
+        } else {
+            const BVHNode& left = nodes[node.leftOrFirst];
+            const BVHNode& right = nodes[node.leftOrFirst + 1];
+            node.aabbMin = glm::min(left.aabbMin, right.aabbMin);
+            node.aabbMax = glm::max(left.aabbMax, right.aabbMax);
+        }
+    }
+}
+
+/**
+ * Finds the nearest box hit by a ray for which a test function also
+ * reports a hit. Nodes are visited near to far and skipped when they are
+ * further away than the nearest hit so far, so most boxes are never
+ * tested.
+ *
+ * @param rayOrigin The origin of the ray
+ * @param rayDir The direction of the ray
+ * @param test Exact test of the object in a box, returns true on a hit
+ *             and writes the distance to the hit
+ * @param distance_out Output for the distance to the nearest hit,
+ *                     undefined if there's no hit
+ * 
+ * @returns The index of the nearest box that was hit, -1 if none was
+ */
+int BVH::Intersect(
+    const glm::vec3& rayOrigin,
+    const glm::vec3& rayDir,
+    const std::function<bool(unsigned int index, float& distance_out)>& test,
+    float& distance_out) const {
+    int nearest = -1;
+    float nearestDistance = FLT_MAX;
+    if (nodes.empty()) {
+        return nearest;
+    }
+    glm::vec3 invDir = 1.0f / rayDir;
+
+    unsigned int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BVHNode& node = nodes[stack[--stackSize]];
+        if (IntersectRayAABB(rayOrigin, invDir, node.aabbMin, node.aabbMax, nearestDistance) < 0.0f) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+                unsigned int index = indices[i];
+                if (IntersectRayAABB(rayOrigin, invDir, boxMin[index], boxMax[index], nearestDistance) < 0.0f) {
+                    continue;
+                }
+                float distance;
+                if (test(index, distance) && distance < nearestDistance) {
+                    nearest = index;
+                    nearestDistance = distance;
+                }
+            }
+            continue;
+        }
+
+        // Push the far child first so that the near child is visited first
+        unsigned int left = node.leftOrFirst;
+        unsigned int right = node.leftOrFirst + 1;
+        float leftDistance = IntersectRayAABB(rayOrigin, invDir, nodes[left].aabbMin, nodes[left].aabbMax, nearestDistance);
+        float rightDistance = IntersectRayAABB(rayOrigin, invDir, nodes[right].aabbMin, nodes[right].aabbMax, nearestDistance);
+        if (leftDistance > rightDistance) {
+            std::swap(left, right);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance >= 0.0f && stackSize < 64) {
+            stack[stackSize++] = right;
+        }
+        if (leftDistance >= 0.0f && stackSize < 64) {
+            stack[stackSize++] = left;
+        }
+    }
+
+    distance_out = nearestDistance;
+    return nearest;
+}
+
+/**
+ * Gets the number of nodes in the tree.
+ * 
+ * @returns The node count
+ */
+size_t BVH::GetNodeCount() const {
+    return nodes.size();
+}
+
+/**
+ * Gets the nodes of the tree. The root is the first node and the two
+ * children of a node are stored next to each other after their parent.
+ * 
+ * @returns The nodes
+ */
+const std::vector<BVHNode>& BVH::GetNodes() const {
+    return nodes;
+}
+
+/**
+ * Gets the box indices referenced by the leaves, a leaf holds the
+ * indices from leftOrFirst to leftOrFirst + count.
+ * 
+ * @returns The box indices
+ */
+const std::vector<unsigned int>& BVH::GetIndices() const {
+    return indices;
+}
+
+/**
+ * Copies the boxes and their centroids from an array.
+ *
+ * @param bounds The boxes to copy
+ * 
+ * @returns void
+ */
+void BVH::loadBoxes(const BoundsArray& bounds) {
+    size_t count = bounds.Size();
+    boxMin.resize(count);
+    boxMax.resize(count);
+    centroids.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        bounds.GetBox(i, boxMin[i], boxMax[i]);
+        centroids[i] = (boxMin[i] + boxMax[i]) * 0.5f;
+    }
+}
+
+/**
+ * Recomputes the bounds of a leaf node from the boxes it holds.
+ *
+ * @param node The node to update
+ * 
+ * @returns void
+ */
+void BVH::updateNodeBounds(BVHNode& node) const {
+    node.aabbMin = glm::vec3(FLT_MAX);
+    node.aabbMax = glm::vec3(-FLT_MAX);
+    for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+        node.aabbMin = glm::min(node.aabbMin, boxMin[indices[i]]);
+        node.aabbMax = glm::max(node.aabbMax, boxMax[indices[i]]);
+    }
+}
+
+/**
+ * Splits a node in two if that is cheaper than keeping it as a leaf,
+ * then recurses into the new children. Large nodes near the root have
+ * their left subtree built on another thread into a separate node list
+ * that is appended when both subtrees are done. The threads work on
+ * disjoint ranges of the box indices.
+ *
+ * @param nodeList The node list the node is stored in
+ * @param nodeIndex The index of the node to split
+ * @param depth The depth of the node in the tree
+ * 
+ * @returns void
+ */
+void BVH::subdivide(std::vector<BVHNode>& nodeList, unsigned int nodeIndex, int depth) {
+    BVHNode node = nodeList[nodeIndex];
+    if (node.count <= leafSize) {
+        return;
+    }
+
+    int axis;
+    float position;
+    float splitCost = findSplit(node, axis, position);
+    float leafCost = node.count * surfaceArea(node.aabbMin, node.aabbMax);
+    if (splitCost >= leafCost) {
+        return;
+    }
+
+    // Partition the boxes around the split position
+    unsigned int* first = indices.data() + node.leftOrFirst;
+    unsigned int* last = first + node.count;
+    unsigned int* middle = std::partition(first, last, [&](unsigned int index) {
+        return centroids[index][axis] < position;
+    });
+    unsigned int leftCount = middle - first;
+    if (leftCount == 0 || leftCount == node.count) {
+        return;
+    }
+
+    unsigned int leftIndex = nodeList.size();
+    BVHNode left;
+    left.leftOrFirst = node.leftOrFirst;
+    left.count = leftCount;
+    BVHNode right;
+    right.leftOrFirst = node.leftOrFirst + leftCount;
+    right.count = node.count - leftCount;
+    updateNodeBounds(left);
+    updateNodeBounds(right);
+    nodeList.push_back(left);
+    nodeList.push_back(right);
+    nodeList[nodeIndex].leftOrFirst = leftIndex;
+    nodeList[nodeIndex].count = 0;
+
+    if (depth < BVH_PARALLEL_DEPTH && node.count >= BVH_PARALLEL_SIZE) {
+        std::vector<BVHNode> leftTree = {left};
+        std::vector<BVHNode> rightTree = {right};
+        leftTree.reserve(2 * left.count);
+        rightTree.reserve(2 * right.count);
+        auto leftTask = std::async(std::launch::async, [&]() {
+            subdivide(leftTree, 0, depth + 1);
+        });
+        subdivide(rightTree, 0, depth + 1);
+        leftTask.get();
+        appendSubtree(nodeList, leftIndex, leftTree);
+        appendSubtree(nodeList, leftIndex + 1, rightTree);
+        return;
+    }
+    subdivide(nodeList, leftIndex, depth + 1);
+    subdivide(nodeList, leftIndex + 1, depth + 1);
+}
+
+/**
+ * Finds the cheapest split of a node. The centroids are sorted into bins
+ * along each axis and the surface area heuristic is evaluated at every
+ * bin boundary.
+ *
+ * @param node The node to split
+ * @param axis_out Output for the axis to split along
+ * @param position_out Output for the split position along the axis
+ * 
+ * @returns The cost of the split, FLT_MAX if the node can't be split
+ */
+float BVH::findSplit(const BVHNode& node, int& axis_out, float& position_out) const {
+    float bestCost = FLT_MAX;
+    axis_out = 0;
+    position_out = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float centroidMin = FLT_MAX;
+        float centroidMax = -FLT_MAX;
+        for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+            centroidMin = std::min(centroidMin, centroids[indices[i]][axis]);
+            centroidMax = std::max(centroidMax, centroids[indices[i]][axis]);
+        }
+        if (centroidMin == centroidMax) {
+            continue;
+        }
+
+        // Sort the boxes into bins
+        glm::vec3 binMin[BVH_BINS], binMax[BVH_BINS];
+        unsigned int binCount[BVH_BINS] = {};
+        for (int b = 0; b < BVH_BINS; b++) {
+            binMin[b] = glm::vec3(FLT_MAX);
+            binMax[b] = glm::vec3(-FLT_MAX);
+        }
+        float scale = BVH_BINS / (centroidMax - centroidMin);
+        for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+            unsigned int index = indices[i];
+            int b = std::min(BVH_BINS - 1, (int)((centroids[index][axis] - centroidMin) * scale));
+            binCount[b]++;
+            binMin[b] = glm::min(binMin[b], boxMin[index]);
+            binMax[b] = glm::max(binMax[b], boxMax[index]);
+        }
+
+        // Sweep from both sides to get the area and count left and right of each boundary
+        float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+        unsigned int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+        glm::vec3 leftMin(FLT_MAX), leftMax(-FLT_MAX), rightMin(FLT_MAX), rightMax(-FLT_MAX);
+        unsigned int leftSum = 0, rightSum = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            leftSum += binCount[b];
+            leftCount[b] = leftSum;
+            leftMin = glm::min(leftMin, binMin[b]);
+            leftMax = glm::max(leftMax, binMax[b]);
+            leftArea[b] = surfaceArea(leftMin, leftMax);
+            rightSum += binCount[BVH_BINS - 1 - b];
+            rightCount[BVH_BINS - 2 - b] = rightSum;
+            rightMin = glm::min(rightMin, binMin[BVH_BINS - 1 - b]);
+            rightMax = glm::max(rightMax, binMax[BVH_BINS - 1 - b]);
+            rightArea[BVH_BINS - 2 - b] = surfaceArea(rightMin, rightMax);
+        }
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                axis_out = axis;
+                position_out = centroidMin + (b + 1) / scale;
+            }
+        }
+    }
+    return bestCost;
+}
@@ -0,0 +1,554 @@
+#include <compressed_texture.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// Fields of a DDS file, offsets are from the start of the file
+const size_t DDS_HEADER_SIZE = 128;
+const size_t DDS_DX10_HEADER_SIZE = 20;
+const size_t DDS_FLAGS = 8;
+const size_t DDS_HEIGHT = 12;
+const size_t DDS_WIDTH = 16;
+const size_t DDS_DEPTH = 24;
+const size_t DDS_MIPMAP_COUNT = 28;
+const size_t DDS_PIXEL_FORMAT_FLAGS = 80;
+const size_t DDS_FOURCC = 84;
+const size_t DDS_DXGI_FORMAT = 128;
+const size_t DDS_RESOURCE_DIMENSION = 132;
+const size_t DDS_ARRAY_SIZE = 140;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDSD_DEPTH = 0x800000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+// Data format descriptor values of the block compressed formats
+const uint32_t KHR_DF_MODEL_BC1A = 128;
+const uint32_t KHR_DF_MODEL_BC3 = 130;
+const uint32_t KHR_DF_MODEL_BC5 = 132;
+const uint32_t KHR_DF_MODEL_BC7 = 134;
+const uint32_t KHR_DF_CHANNEL_COLOR = 0;
+const uint32_t KHR_DF_CHANNEL_GREEN = 1;
+const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+// Levels in a written KTX2 file start at multiples of this
+const size_t KTX2_LEVEL_ALIGNMENT = 16;
+
+// Largest supported texture size and its number of mip levels
+const int MAX_TEXTURE_SIZE = 16384;
+const unsigned int MAX_LEVELS = 15;
+
+/**
+ * Reads a little endian 32 bit value from a file.
+ *
+ * @param data The file data
+ * @param offset The offset of the value
+ *
+ * @returns The value
+ */
+static uint32_t readUint32(const unsigned char* data, size_t offset) {
+    uint32_t value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+/**
+ * Makes the four character code of a DDS pixel format.
+ *
+ * @param code The four characters
+ *
+ * @returns The code as stored in a DDS file
+ */
+static uint32_t fourCC(const char* code) {
+    return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+}
+
+/**
+ * Maps a KTX2 file and reads its mip levels, or a DDS file if the path
+ * has a .dds extension. The file stays mapped until the texture is
+ * destroyed.
+ *
+ * @param path The path to the KTX2 or DDS file
+ *
+ * @returns true if the file holds a supported 2D texture, false otherwise
+ */
+bool CompressedTexture::Open(const std::string& path) {
+    levels.clear();
+    format = 0;
+    if (!file.Open(path)) {
+        return false;
+    }
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    bool valid = extension == ".dds" ? readDDS() : readKTX2();
+    if (!valid || !validateLevels()) {
+        levels.clear();
+        format = 0;
+        file.Close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reads the levels of a mapped KTX2 file. Supercompressed files, arrays,
+ * cube maps and 3D textures are not supported.
+ *
+ * @returns true if the file holds a supported texture, false otherwise
+ */
+bool CompressedTexture::readKTX2() {
+    const unsigned char* data = file.GetData();
+    if (file.GetSize() < sizeof(KTX2Header)) {
+        return false;
+    }
+    KTX2Header header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+        header.supercompressionScheme != 0 || header.pixelDepth != 0 ||
+        header.layerCount > 1 || header.faceCount != 1) {
+        return false;
+    }
+
+    switch (header.vkFormat) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            break;
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            format = GL_COMPRESSED_RG_RGTC2;
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+            break;
+        default:
+            return false;
+    }
+    width = header.pixelWidth;
+    height = header.pixelHeight;
+
+    // A level count of 0 asks for mips to be generated, which compressed textures can't
+    unsigned int levelCount = std::max(header.levelCount, 1u);
+    if (levelCount > MAX_LEVELS || file.GetSize() < sizeof(KTX2Header) + levelCount * sizeof(KTX2Level)) {
+        return false;
+    }
+    for (unsigned int i = 0; i < levelCount; i++) {
+        KTX2Level index;
+        memcpy(&index, data + sizeof(KTX2Header) + i * sizeof(KTX2Level), sizeof(index));
+        CompressedLevel level;
+        level.offset = index.byteOffset;
+        level.size = index.byteLength;
+        level.width = std::max(width >> i, 1);
+        level.height = std::max(height >> i, 1);
+        levels.push_back(level);
+    }
+    return true;
+}
+
+/**
+ * Reads the levels of a mapped DDS file, with or without the DX10
+ * header. The levels follow the headers tightly packed.
+ *
+ * @returns true if the file holds a supported texture, false otherwise
+ */
+bool CompressedTexture::readDDS() {
+    const unsigned char* data = file.GetData();
+    if (file.GetSize() < DDS_HEADER_SIZE || memcmp(data, "DDS ", 4) != 0) {
+        return false;
+    }
+    uint32_t flags = readUint32(data, DDS_FLAGS);
+    if ((flags & DDSD_DEPTH) && readUint32(data, DDS_DEPTH) > 1) {
+        return false;
+    }
+    if (!(readUint32(data, DDS_PIXEL_FORMAT_FLAGS) & DDPF_FOURCC)) {
+        return false;
+    }
+
+    size_t offset = DDS_HEADER_SIZE;
+    uint32_t code = readUint32(data, DDS_FOURCC);
+    if (code == fourCC("DXT1")) {
+        format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    } else if (code == fourCC("DXT5")) {
+        format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    } else if (code == fourCC("ATI2") || code == fourCC("BC5U")) {
+        format = GL_COMPRESSED_RG_RGTC2;
+    } else if (code == fourCC("DX10")) {
+        offset += DDS_DX10_HEADER_SIZE;
+        if (file.GetSize() < offset || readUint32(data, DDS_RESOURCE_DIMENSION) != DDS_DIMENSION_TEXTURE2D ||
+            readUint32(data, DDS_ARRAY_SIZE) > 1) {
+            return false;
+        }
+        switch (readUint32(data, DDS_DXGI_FORMAT)) {
+            case 71:  // DXGI_FORMAT_BC1_UNORM
+            case 72:  // DXGI_FORMAT_BC1_UNORM_SRGB
+                format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+                break;
+            case 77:  // DXGI_FORMAT_BC3_UNORM
+            case 78:  // DXGI_FORMAT_BC3_UNORM_SRGB
+                format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+                break;
+            case 83:  // DXGI_FORMAT_BC5_UNORM
+                format = GL_COMPRESSED_RG_RGTC2;
+                break;
+            case 98:  // DXGI_FORMAT_BC7_UNORM
+            case 99:  // DXGI_FORMAT_BC7_UNORM_SRGB
+                format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+                break;
+            default:
+                return false;
+        }
+    } else {
+        return false;
+    }
+    width = readUint32(data, DDS_WIDTH);
+    height = readUint32(data, DDS_HEIGHT);
+
+    unsigned int levelCount = (flags & DDSD_MIPMAPCOUNT) ? readUint32(data, DDS_MIPMAP_COUNT) : 1;
+    levelCount = std::max(levelCount, 1u);
+    if (levelCount > MAX_LEVELS) {
+        return false;
+    }
+    for (unsigned int i = 0; i < levelCount; i++) {
+        CompressedLevel level;
+        level.offset = offset;
+        level.width = std::max(width >> i, 1);
+        level.height = std::max(height >> i, 1);
+        level.size = GetLevelSize(format, level.width, level.height);
+        levels.push_back(level);
+        offset += level.size;
+    }
+    return true;
+}
+
+/**
+ * Checks that the texture has a size, no more levels than its mip chain
+ * and that every level lies inside the file and holds all its blocks.
+ *
+ * @returns true if the levels are valid, false otherwise
+ */
+bool CompressedTexture::validateLevels() const {
+    if (width <= 0 || height <= 0 || width > MAX_TEXTURE_SIZE || height > MAX_TEXTURE_SIZE) {
+        return false;
+    }
+    int maxLevels = 1;
+    while ((std::max(width, height) >> maxLevels) > 0) {
+        maxLevels++;
+    }
+    if (levels.empty() || levels.size() > (size_t)maxLevels) {
+        return false;
+    }
+    for (const CompressedLevel& level : levels) {
+        if (level.size < GetLevelSize(format, level.width, level.height) ||
+            level.offset > file.GetSize() || level.size > file.GetSize() - level.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Gets the GL internal format of the texture.
+ *
+ * @returns The compressed internal format, 0 if no texture is open
+ */
+GLenum CompressedTexture::GetFormat() const {
+    return format;
+}
+
+/**
+ * Gets the width of the base level.
+ *
+ * @returns The width in pixels
+ */
+int CompressedTexture::GetWidth() const {
+    return width;
+}
+
+/**
+ * Gets the height of the base level.
+ *
+ * @returns The height in pixels
+ */
+int CompressedTexture::GetHeight() const {
+    return height;
+}
+
+/**
+ * Gets the number of mip levels stored in the file.
+ *
+ * @returns The number of levels
+ */
+unsigned int CompressedTexture::GetLevelCount() const {
+    return levels.size();
+}
+
+/**
+ * Gets a mip level, level 0 is the base level.
+ *
+ * @param level The index of the level
+ *
+ * @returns The level
+ */
+const CompressedLevel& CompressedTexture::GetLevel(unsigned int level) const {
+    return levels[level];
+}
+
+/**
+ * Gets the mapped data of a mip level.
+ *
+ * @param level The index of the level
+ *
+ * @returns A pointer to the blocks of the level
+ */
+const unsigned char* CompressedTexture::GetLevelData(unsigned int level) const {
+    return file.GetData() + levels[level].offset;
+}
+
+/**
+ * Gets the size of all mip levels.
+ *
+ * @returns The size in bytes
+ */
+size_t CompressedTexture::GetDataSize() const {
+    size_t size = 0;
+    for (const CompressedLevel& level : levels) {
+        size += level.size;
+    }
+    return size;
+}
+
+/**
+ * Checks if a path has the extension of a KTX2 or DDS file.
+ *
+ * @param path The path to check
+ *
+ * @returns true if the path names a compressed file, false otherwise
+ */
+bool CompressedTexture::IsCompressedFile(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".ktx2" || extension == ".dds";
+}
+
+/**
+ * Finds a compressed version of an image, a KTX2 or DDS file in the same
+ * directory with the same name, for example diffuse.ktx2 for diffuse.jpg.
+ * KTX2 files are preferred.
+ *
+ * @param imagePath The path to the image
+ *
+ * @returns The path to the compressed file, empty if there is none
+ */
+std::string CompressedTexture::FindCompressedFile(const std::string& imagePath) {
+    std::error_code error;
+    for (const char* extension : {".ktx2", ".dds"}) {
+        std::filesystem::path path = std::filesystem::path(imagePath).replace_extension(extension);
+        if (std::filesystem::is_regular_file(path, error)) {
+            return path.string();
+        }
+    }
+    return "";
+}
+
+/**
+ * Gets the size of a 4x4 block of a compressed format.
+ *
+ * @param format The GL internal format
+ *
+ * @returns The size in bytes, 0 if the format is not supported
+ */
+size_t CompressedTexture::GetBlockSize(GLenum format) {
+    switch (format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            return 8;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Gets the size of a level of a compressed format, partial blocks at
+ * the edges take a whole block.
+ *
+ * @param format The GL internal format
+ * @param width The width of the level in pixels
+ * @param height The height of the level in pixels
+ *
+ * @returns The size in bytes
+ */
+size_t CompressedTexture::GetLevelSize(GLenum format, int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+/**
+ * Builds the data format descriptor of a block compressed format, one
+ * basic descriptor block with a sample per 64 bit half of the block.
+ *
+ * @param vkFormat The Vulkan format number
+ * @param dfd_out Output for the descriptor, including its total size
+ *
+ * @returns true if the format is supported, false otherwise
+ */
+static bool buildDataFormatDescriptor(uint32_t vkFormat, std::vector<uint32_t>& dfd_out) {
+    uint32_t model;
+    uint32_t blockSize = 16;
+    std::vector<uint32_t> channels;
+    switch (vkFormat) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            model = KHR_DF_MODEL_BC1A;
+            blockSize = 8;
+            channels = {KHR_DF_CHANNEL_COLOR};
+            break;
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            model = KHR_DF_MODEL_BC1A;
+            blockSize = 8;
+            channels = {KHR_DF_CHANNEL_ALPHA};
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            model = KHR_DF_MODEL_BC3;
+            channels = {KHR_DF_CHANNEL_ALPHA, KHR_DF_CHANNEL_COLOR};
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            model = KHR_DF_MODEL_BC5;
+            channels = {KHR_DF_CHANNEL_COLOR, KHR_DF_CHANNEL_GREEN};
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            model = KHR_DF_MODEL_BC7;
+            channels = {KHR_DF_CHANNEL_COLOR};
+            break;
+        default:
+            return false;
+    }
+    bool srgb = vkFormat == VK_FORMAT_BC1_RGB_SRGB_BLOCK || vkFormat == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+        vkFormat == VK_FORMAT_BC3_SRGB_BLOCK || vkFormat == VK_FORMAT_BC7_SRGB_BLOCK;
+
+    uint32_t blockWords = 6 + 4 * channels.size();
+    dfd_out.clear();
+    dfd_out.push_back((1 + blockWords) * 4);
+    dfd_out.push_back(0);
+    dfd_out.push_back(2 | ((blockWords * 4) << 16));
+    dfd_out.push_back(model | (KHR_DF_PRIMARIES_BT709 << 8) |
+        ((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+    dfd_out.push_back(3 | (3 << 8));
+    dfd_out.push_back(blockSize);
+    dfd_out.push_back(0);
+    uint32_t sampleBits = blockSize * 8 / channels.size();
+    for (size_t i = 0; i < channels.size(); i++) {
+        dfd_out.push_back((uint32_t)(i * sampleBits) | ((sampleBits - 1) << 16) | (channels[i] << 24));
+        dfd_out.push_back(0);
+        dfd_out.push_back(0);
+        dfd_out.push_back(0xFFFFFFFF);
+    }
+    return true;
+}
+
+/**
+ * Writes block compressed mip levels to a KTX2 file. The levels are
+ * stored smallest first as the format recommends, with the orientation
+ * marked as bottom up. The file is written next to the target under a
+ * name unique to the writer and renamed over it, so readers never see a
+ * partial file and concurrent writers never share one. The same input
+ * always gives the same file.
+ *
+ * @param path The path to write to
+ * @param vkFormat The Vulkan format number of the blocks
+ * @param width The width of the base level in pixels
+ * @param height The height of the base level in pixels
+ * @param levels The blocks of each level, the base level first
+ *
+ * @returns true if the file was written, false otherwise
+ */
+bool CompressedTexture::WriteKTX2(const std::string& path, uint32_t vkFormat, int width, int height,
+    const std::vector<std::vector<unsigned char>>& levels) {
+    std::vector<uint32_t> dfd;
+    if (!buildDataFormatDescriptor(vkFormat, dfd) || levels.empty()) {
+        std::cout << "ERROR::COMPRESSED_TEXTURE::UNSUPPORTED_FORMAT " << vkFormat << std::endl;
+        return false;
+    }
+
+    // Key and value pairs, each padded to four bytes
+    std::string key = "KTXorientation";
+    std::string value = "ru";
+    uint32_t pairSize = key.size() + 1 + value.size() + 1;
+    std::vector<unsigned char> kvd(sizeof(uint32_t) + ((pairSize + 3) & ~3u), 0);
+    memcpy(kvd.data(), &pairSize, sizeof(pairSize));
+    memcpy(kvd.data() + sizeof(uint32_t), key.c_str(), key.size() + 1);
+    memcpy(kvd.data() + sizeof(uint32_t) + key.size() + 1, value.c_str(), value.size() + 1);
+
+    KTX2Header header = {};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = levels.size();
+    header.dfdByteOffset = sizeof(KTX2Header) + levels.size() * sizeof(KTX2Level);
+    header.dfdByteLength = dfd.size() * sizeof(uint32_t);
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = kvd.size();
+
+    auto alignLevel = [](size_t offset) {
+        return (offset + KTX2_LEVEL_ALIGNMENT - 1) & ~(KTX2_LEVEL_ALIGNMENT - 1);
+    };
+    std::vector<KTX2Level> levelIndex(levels.size());
+    size_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (size_t i = levels.size(); i-- > 0;) {
+        offset = alignLevel(offset);
+        levelIndex[i].byteOffset = offset;
+        levelIndex[i].byteLength = levels[i].size();
+        levelIndex[i].uncompressedByteLength = levels[i].size();
+        offset += levels[i].size();
+    }
+
+    std::error_code error;
+    std::string temporaryPath = MappedFile::GetTemporaryPath(path);
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        const char padding[KTX2_LEVEL_ALIGNMENT] = {};
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)levelIndex.data(), levelIndex.size() * sizeof(KTX2Level));
+        out.write((const char*)dfd.data(), dfd.size() * sizeof(uint32_t));
+        out.write((const char*)kvd.data(), kvd.size());
+        for (size_t i = levels.size(); i-- > 0;) {
+            out.write(padding, levelIndex[i].byteOffset - (uint64_t)out.tellp());
+            out.write((const char*)levels[i].data(), levels[i].size());
+        }
+        if (!out) {
+            out.close();
+            std::filesystem::remove(temporaryPath, error);
+            std::cout << "ERROR::COMPRESSED_TEXTURE::WRITE_FAILED " << path << std::endl;
+            return false;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        std::cout << "ERROR::COMPRESSED_TEXTURE::WRITE_FAILED " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,226 @@
+#include <frustum.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cstring>
+
+/**
+ * Extracts the frustum planes from the rows of a combined projection
+ * and view matrix. The planes are normalized so that the distance of a
+ * point to a plane can be compared with box extents.
+ *
+ * @param viewProjection The projection matrix multiplied by the view matrix
+ * 
+ * @returns void
+ */
+void Frustum::Extract(const glm::mat4& viewProjection) {
+    glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    planes[0] = row3 + row0;  // Left
+    planes[1] = row3 - row0;  // Right
+    planes[2] = row3 + row1;  // Bottom
+    planes[3] = row3 - row1;  // Top
+    planes[4] = row3 + row2;  // Near
+    planes[5] = row3 - row2;  // Far
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+/**
+ * Tests an axis aligned box against the frustum.
+ *
+ * @param center The center of the box
+ * @param extent The half extents of the box
+ * 
+ * @returns Whether the box is outside, intersecting or inside the frustum
+ */
+CullResult Frustum::TestAABB(const glm::vec3& center, const glm::vec3& extent) const {
+    CullResult result = CULL_INSIDE;
+    for (int i = 0; i < 6; i++) {
+        glm::vec3 normal(planes[i]);
+        float distance = glm::dot(normal, center) + planes[i].w;
+        float radius = glm::dot(glm::abs(normal), extent);
+        if (distance + radius < 0.0f) {
+            return CULL_OUTSIDE;
+        }
+        if (distance - radius < 0.0f) {
+            result = CULL_INTERSECTING;
+        }
+    }
+    return result;
+}
+
+/**
+ * Adds a box to the array.
+ *
+ * @param center The center of the box
+ * @param extent The half extents of the box
+ * 
+ * @returns The index of the box
+ */
+unsigned int BoundsArray::Add(const glm::vec3& center, const glm::vec3& extent) {
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    extentX.push_back(extent.x);
+    extentY.push_back(extent.y);
+    extentZ.push_back(extent.z);
+    return centerX.size() - 1;
+}
+
+/**
+ * Replaces the box at an index.
+ *
+ * @param index The index of the box
+ * @param center The center of the box
+ * @param extent The half extents of the box
+ * 
+ * @returns void
+ */
+void BoundsArray::Set(unsigned int index, const glm::vec3& center, const glm::vec3& extent) {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extent.x;
+    extentY[index] = extent.y;
+    extentZ[index] = extent.z;
+}
+
+/**
+ * Removes all boxes from the array.
+ * 
+ * @returns void
+ */
+void BoundsArray::Clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+/**
+ * Gets the number of boxes in the array.
+ * 
+ * @returns The number of boxes
+ */
+size_t BoundsArray::Size() const {
+    return centerX.size();
+}
+
+/**
+ * Gets the min and max coordinates of a box.
+ *
+ * @param index The index of the box
+ * @param aabbMin_out Output for the min coordinates
+ * @param aabbMax_out Output for the max coordinates
+ * 
+ * @returns void
+ */
+void BoundsArray::GetBox(unsigned int index, glm::vec3& aabbMin_out, glm::vec3& aabbMax_out) const {
+    glm::vec3 center(centerX[index], centerY[index], centerZ[index]);
+    glm::vec3 extent(extentX[index], extentY[index], extentZ[index]);
+    aabbMin_out = center - extent;
+    aabbMax_out = center + extent;
+}
+
+/**
+ * Tests all boxes against a frustum. Four boxes are tested against all
+ * six planes at a time with SSE, reading the component arrays directly.
+ * The remaining boxes, or all boxes without SSE, are tested one by one.
+ *
+ * @param frustum The frustum to test against
+ * @param results Output with one CullResult per box
+ * 
+ * @returns void
+ */
+void BoundsArray::Cull(const Frustum& frustum, std::vector<uint8_t>& results) const {
+    size_t count = Size();
+    results.resize(count);
+    uint8_t* result = results.data();
+    const float* cx = centerX.data();
+    const float* cy = centerY.data();
+    const float* cz = centerZ.data();
+    const float* ex = extentX.data();
+    const float* ey = extentY.data();
+    const float* ez = extentZ.data();
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m128 absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        absX[p] = _mm_set1_ps(glm::abs(frustum.planes[p].x));
+        absY[p] = _mm_set1_ps(glm::abs(frustum.planes[p].y));
+        absZ[p] = _mm_set1_ps(glm::abs(frustum.planes[p].z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i inside = _mm_set1_epi32(CULL_INSIDE);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(cx + i);
+        __m128 y = _mm_loadu_ps(cy + i);
+        __m128 z = _mm_loadu_ps(cz + i);
+        __m128 extX = _mm_loadu_ps(ex + i);
+        __m128 extY = _mm_loadu_ps(ey + i);
+        __m128 extZ = _mm_loadu_ps(ez + i);
+
+        // Masks of boxes that are outside of, or crossing, any plane
+        __m128 outside = _mm_setzero_ps();
+        __m128 crossing = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(absX[p], extX), _mm_mul_ps(absY[p], extY)),
+                _mm_mul_ps(absZ[p], extZ));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+            crossing = _mm_or_ps(crossing, _mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+        }
+        // A box outside a plane also crosses it, so adding the all-ones
+        // masks to CULL_INSIDE gives the result without branches
+        __m128i boxResult = _mm_add_epi32(inside, _mm_add_epi32(_mm_castps_si128(outside), _mm_castps_si128(crossing)));
+        boxResult = _mm_packs_epi32(boxResult, boxResult);
+        boxResult = _mm_packus_epi16(boxResult, boxResult);
+        int packed = _mm_cvtsi128_si32(boxResult);
+        memcpy(result + i, &packed, 4);
+    }
+#endif
+    for (; i < count; i++) {
+        glm::vec3 center(cx[i], cy[i], cz[i]);
+        glm::vec3 extent(ex[i], ey[i], ez[i]);
+        result[i] = frustum.TestAABB(center, extent);
+    }
+}
+
+/**
+ * Transforms a box to world space and returns the axis aligned box that
+ * encloses the transformed box.
+ *
+ * @param matrix The model matrix
+ * @param aabbMin The minimum local coordinates of the box
+ * @param aabbMax The maximum local coordinates of the box
+ * @param center_out Output for the center of the world space box
+ * @param extent_out Output for the half extents of the world space box
+ * 
+ * @returns void
+ */
+void TransformAABB(const glm::mat4& matrix, const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+    glm::vec3& center_out, glm::vec3& extent_out) {
+    glm::vec3 center = (aabbMin + aabbMax) * 0.5f;
+    glm::vec3 extent = (aabbMax - aabbMin) * 0.5f;
+    glm::mat3 absolute(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+    center_out = glm::vec3(matrix * glm::vec4(center, 1.0f));
+    extent_out = absolute * extent;
+}
@@ -0,0 +1,199 @@
+#include <geometry_pool.h>
+
+// Number of vertices and indices to reserve the first time the pool grows
+const GLsizeiptr INITIAL_POOL_VERTICES = 1 << 16;
+const GLsizeiptr INITIAL_POOL_INDICES = 1 << 18;
+
+/**
+ * Copies the vertices and indices of a mesh to the end of the pool and
+ * records where they were placed in the mesh. Meshes that already are
+ * in the pool are skipped. Meshes with another vertex layout, index
+ * type or position stream than the pool are not added and keep drawing
+ * from their own buffers. Empty meshes have no buffers and are not added.
+ *
+ * @param mesh The mesh to add
+ * 
+ * @returns true if the mesh is in the pool, false otherwise
+ */
+bool GeometryPool::AddMesh(Mesh& mesh) {
+    if (mesh.GetPool() == this) {
+        return true;
+    }
+    if (mesh.GetIndexCount() == 0) {
+        return false;
+    }
+    if (!VAO) {
+        setupVertexArray(mesh);
+    } else if (mesh.GetVertexLayout() != layout || mesh.GetIndexType() != indexType ||
+        mesh.GetPositionStride() != positionStride) {
+        return false;
+    }
+    GLsizeiptr meshVertices = mesh.GetVertexCount();
+    GLsizeiptr meshIndices = mesh.GetIndexCount();
+    reserve(vertexCount + meshVertices, indexCount + meshIndices);
+
+    // Copy on the GPU from the mesh buffers, the mesh may not keep CPU copies
+    glCopyNamedBufferSubData(mesh.GetVertexBuffer(), VBO, 0, vertexCount * stride, meshVertices * stride);
+    if (positionVBO) {
+        glCopyNamedBufferSubData(mesh.GetPositionBuffer(), positionVBO, 0, vertexCount * positionStride,
+            meshVertices * positionStride);
+    }
+    glCopyNamedBufferSubData(mesh.GetIndexBuffer(), EBO, 0, indexCount * indexSize, meshIndices * indexSize);
+    mesh.SetPoolRange(this, (GLint)vertexCount, (GLuint)indexCount);
+
+    vertexCount += meshVertices;
+    indexCount += meshIndices;
+    return true;
+}
+
+/**
+ * Binds the buffer holding the instance data of the draws from the pool.
+ * Indirect commands select their instances through baseInstance, so the
+ * buffer is always bound from its start. The buffer is bound again every
+ * time, since a ring that grew may get the name of the buffer it freed.
+ *
+ * @param buffer The instance buffer
+ * 
+ * @returns void
+ */
+void GeometryPool::SetInstanceBuffer(GLuint buffer) {
+    glVertexArrayVertexBuffer(VAO, INSTANCE_BINDING, buffer, 0, sizeof(InstanceData));
+}
+
+/**
+ * Deletes the buffers and vertex array and empties the pool. The next
+ * mesh added decides the format again. Meshes that were in the pool
+ * must have their pool range reset first, or they are skipped when they
+ * are added again.
+ * 
+ * @returns void
+ */
+void GeometryPool::Clear() {
+    VAO.Reset();
+    VBO.Reset();
+    positionVBO.Reset();
+    EBO.Reset();
+    vertexCapacity = 0;
+    vertexCount = 0;
+    indexCapacity = 0;
+    indexCount = 0;
+}
+
+/**
+ * Gets the vertex array that draws from the pool.
+ * 
+ * @returns The vertex array
+ */
+GLuint GeometryPool::GetVAO() const {
+    return VAO;
+}
+
+/**
+ * Gets the layout of the vertices in the pool.
+ * 
+ * @returns The vertex layout
+ */
+VertexLayout GeometryPool::GetVertexLayout() const {
+    return layout;
+}
+
+/**
+ * Gets the type of the indices in the pool, the type to draw from it with.
+ * 
+ * @returns The index type
+ */
+GLenum GeometryPool::GetIndexType() const {
+    return indexType;
+}
+
+/**
+ * Gets the number of vertices in the pool.
+ * 
+ * @returns The vertex count
+ */
+GLsizeiptr GeometryPool::GetVertexCount() const {
+    return vertexCount;
+}
+
+/**
+ * Gets the number of indices in the pool.
+ * 
+ * @returns The index count
+ */
+GLsizeiptr GeometryPool::GetIndexCount() const {
+    return indexCount;
+}
+
+/**
+ * Creates the vertex array with the same attribute layout as the mesh
+ * vertex arrays, including the instance attributes.
+ *
+ * @param mesh The first mesh of the pool, which decides the vertex layout and index type
+ * 
+ * @returns void
+ */
+void GeometryPool::setupVertexArray(const Mesh& mesh) {
+    VAO = GLVertexArray::Create();
+    layout = mesh.GetVertexLayout();
+    stride = mesh.GetVertexStride();
+    positionStride = mesh.GetPositionStride();
+    indexType = mesh.GetIndexType();
+    indexSize = mesh.GetIndexSize();
+
+    Mesh::SetupVertexFormat(VAO, layout, mesh.HasPositionStream());
+    Mesh::SetupInstanceFormat(VAO);
+}
+
+/**
+ * Grows the vertex and index buffers so that they fit at least the given
+ * number of vertices and indices. The capacity is doubled to keep the
+ * number of copies low when many meshes are added.
+ *
+ * @param vertices The number of vertices the pool must fit
+ * @param indices The number of indices the pool must fit
+ * 
+ * @returns void
+ */
+void GeometryPool::reserve(GLsizeiptr vertices, GLsizeiptr indices) {
+    if (vertices > vertexCapacity) {
+        GLsizeiptr capacity = vertexCapacity > 0 ? vertexCapacity : INITIAL_POOL_VERTICES;
+        while (capacity < vertices) {
+            capacity *= 2;
+        }
+        grow(VBO, vertexCount * stride, capacity * stride);
+        glVertexArrayVertexBuffer(VAO, VERTEX_BINDING, VBO, 0, stride);
+        if (positionStride > 0) {
+            grow(positionVBO, vertexCount * positionStride, capacity * positionStride);
+            glVertexArrayVertexBuffer(VAO, POSITION_BINDING, positionVBO, 0, positionStride);
+        }
+        vertexCapacity = capacity;
+    }
+    if (indices > indexCapacity) {
+        GLsizeiptr capacity = indexCapacity > 0 ? indexCapacity : INITIAL_POOL_INDICES;
+        while (capacity < indices) {
+            capacity *= 2;
+        }
+        grow(EBO, indexCount * indexSize, capacity * indexSize);
+        indexCapacity = capacity;
+        glVertexArrayElementBuffer(VAO, EBO);
+    }
+}
+
+/**
+ * Creates a larger buffer, copies the used part of a buffer into it and
+ * replaces the buffer with it, which deletes the old buffer.
+ *
+ * @param buffer The buffer to grow, empty if there is none yet
+ * @param oldSize The number of bytes in use in the buffer
+ * @param newSize The size of the new buffer in bytes
+ * 
+ * @returns void
+ */
+void GeometryPool::grow(GLBuffer& buffer, GLsizeiptr oldSize, GLsizeiptr newSize) {
+    GLBuffer newBuffer = GLBuffer::Create();
+    glNamedBufferStorage(newBuffer, newSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+    if (buffer && oldSize > 0) {
+        glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, oldSize);
+    }
+    buffer = std::move(newBuffer);
+}
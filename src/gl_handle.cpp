@@ -0,0 +1,182 @@
+#include <gl_handle.h>
+
+#include <atomic>
+#include <iostream>
+
+static bool leakCheck = false;
+static std::atomic<size_t> liveObjects[GL_OBJECT_TYPE_COUNT];
+
+/**
+ * Creates a GL object of a type and counts it as alive.
+ *
+ * @param type The type of the object
+ * @param target The target of a texture, ignored for other types
+ *
+ * @returns The name of the new object
+ */
+GLuint GLObjectTracker::Create(GLObjectType type, GLenum target) {
+    GLuint id = 0;
+    switch (type) {
+        case GL_OBJECT_BUFFER:
+            glCreateBuffers(1, &id);
+            break;
+        case GL_OBJECT_VERTEX_ARRAY:
+            glCreateVertexArrays(1, &id);
+            break;
+        case GL_OBJECT_TEXTURE:
+            glCreateTextures(target, 1, &id);
+            break;
+        case GL_OBJECT_PROGRAM:
+            id = glCreateProgram();
+            break;
+        case GL_OBJECT_SAMPLER:
+            glCreateSamplers(1, &id);
+            break;
+        default:
+            return 0;
+    }
+    if (id) {
+        Track(type);
+    }
+    return id;
+}
+
+/**
+ * Deletes a GL object of a type that was counted as alive.
+ *
+ * @param type The type of the object
+ * @param id The name of the object
+ *
+ * @returns void
+ */
+void GLObjectTracker::Delete(GLObjectType type, GLuint id) {
+    switch (type) {
+        case GL_OBJECT_BUFFER:
+            glDeleteBuffers(1, &id);
+            break;
+        case GL_OBJECT_VERTEX_ARRAY:
+            glDeleteVertexArrays(1, &id);
+            break;
+        case GL_OBJECT_TEXTURE:
+            glDeleteTextures(1, &id);
+            break;
+        case GL_OBJECT_PROGRAM:
+            glDeleteProgram(id);
+            break;
+        case GL_OBJECT_SAMPLER:
+            glDeleteSamplers(1, &id);
+            break;
+        default:
+            return;
+    }
+    liveObjects[type]--;
+}
+
+/**
+ * Counts an object as alive that was created directly with GL, such as
+ * a texture made by the texture packer, when a handle takes it over.
+ *
+ * @param type The type of the object
+ *
+ * @returns void
+ */
+void GLObjectTracker::Track(GLObjectType type) {
+    if (type < GL_OBJECT_TYPE_COUNT) {
+        liveObjects[type]++;
+    }
+}
+
+/**
+ * Gets the number of objects of a type that are owned by handles.
+ *
+ * @param type The type of the objects
+ *
+ * @returns The number of live objects
+ */
+size_t GLObjectTracker::GetLiveCount(GLObjectType type) {
+    return type < GL_OBJECT_TYPE_COUNT ? liveObjects[type].load() : 0;
+}
+
+/**
+ * Gets the number of objects of all types that are owned by handles.
+ *
+ * @returns The number of live objects
+ */
+size_t GLObjectTracker::GetLiveCount() {
+    size_t count = 0;
+    for (int type = 0; type < GL_OBJECT_TYPE_COUNT; type++) {
+        count += liveObjects[type].load();
+    }
+    return count;
+}
+
+/**
+ * Gets the name of a type of objects as it is printed in reports.
+ *
+ * @param type The type of the objects
+ *
+ * @returns The plural name of the type
+ */
+const char* GLObjectTracker::GetTypeName(GLObjectType type) {
+    switch (type) {
+        case GL_OBJECT_BUFFER:
+            return "buffers";
+        case GL_OBJECT_VERTEX_ARRAY:
+            return "vertex arrays";
+        case GL_OBJECT_TEXTURE:
+            return "textures";
+        case GL_OBJECT_PROGRAM:
+            return "programs";
+        case GL_OBJECT_SAMPLER:
+            return "samplers";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * Enables or disables the leak check. While it is enabled, ReportLeaks
+ * prints the objects that are still alive.
+ *
+ * @param enabled true to print live objects, false to stay silent
+ *
+ * @returns void
+ */
+void GLObjectTracker::SetLeakCheck(bool enabled) {
+    leakCheck = enabled;
+}
+
+/**
+ * Checks if the leak check is enabled.
+ *
+ * @returns true if ReportLeaks prints live objects, false otherwise
+ */
+bool GLObjectTracker::IsLeakCheckEnabled() {
+    return leakCheck;
+}
+
+/**
+ * Reports the objects that are still alive. Called at shutdown after all
+ * models, meshes and shaders are destroyed, but while the context is
+ * still current, every object counted then has leaked.
+ *
+ * @returns The number of live objects
+ */
+size_t GLObjectTracker::ReportLeaks() {
+    size_t count = GetLiveCount();
+    if (!leakCheck) {
+        return count;
+    }
+    if (count == 0) {
+        std::cout << "GL leak check: no live objects" << std::endl;
+        return count;
+    }
+    std::cout << "GL leak check: " << count << " live objects" << std::endl;
+    for (int type = 0; type < GL_OBJECT_TYPE_COUNT; type++) {
+        size_t live = liveObjects[type].load();
+        if (live > 0) {
+            std::cout << "  " << GetTypeName((GLObjectType)type) << ": " << live << std::endl;
+        }
+    }
+    return count;
+}
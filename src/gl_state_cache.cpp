@@ -0,0 +1,206 @@
+#include <gl_state_cache.h>
+
+// Value of shadowed state that is unknown
+const GLuint UNKNOWN_STATE = 0xFFFFFFFF;
+
+GLStateCache::GLStateCache() {
+    Reset();
+}
+
+/**
+ * Forgets all shadowed state. Must be called whenever GL state may have
+ * been changed behind the cache's back, e.g. at the start of a frame.
+ * 
+ * @returns void
+ */
+void GLStateCache::Reset() {
+    program = UNKNOWN_STATE;
+    vertexArray = UNKNOWN_STATE;
+    for (int i = 0; i < MAX_CACHED_TEXTURE_UNITS; i++) {
+        textures[i] = UNKNOWN_STATE;
+        samplers[i] = UNKNOWN_STATE;
+    }
+    for (int i = 0; i < 2; i++) {
+        uniformBuffers[i] = UNKNOWN_STATE;
+        uniformOffsets[i] = -1;
+        uniformSizes[i] = -1;
+    }
+    intUniforms.clear();
+    matrixUniforms.clear();
+}
+
+/**
+ * Binds a program if it isn't already in use.
+ *
+ * @param program The program to use
+ * 
+ * @returns void
+ */
+void GLStateCache::UseProgram(GLuint program) {
+    if (this->program == program) {
+        stats.redundantChanges++;
+        return;
+    }
+    glUseProgram(program);
+    this->program = program;
+    stats.programChanges++;
+}
+
+/**
+ * Binds a texture to a texture unit if it isn't already bound there.
+ *
+ * @param unit The texture unit
+ * @param texture The texture to bind
+ * 
+ * @returns void
+ */
+void GLStateCache::BindTexture(GLuint unit, GLuint texture) {
+    if (unit < MAX_CACHED_TEXTURE_UNITS) {
+        if (textures[unit] == texture) {
+            stats.redundantChanges++;
+            return;
+        }
+        textures[unit] = texture;
+    }
+    glBindTextureUnit(unit, texture);
+    stats.textureBinds++;
+}
+
+/**
+ * Binds a sampler to a texture unit if it isn't already bound there.
+ *
+ * @param unit The texture unit
+ * @param sampler The sampler to bind
+ * 
+ * @returns void
+ */
+void GLStateCache::BindSampler(GLuint unit, GLuint sampler) {
+    if (unit < MAX_CACHED_TEXTURE_UNITS) {
+        if (samplers[unit] == sampler) {
+            stats.redundantChanges++;
+            return;
+        }
+        samplers[unit] = sampler;
+    }
+    glBindSampler(unit, sampler);
+    stats.samplerBinds++;
+}
+
+/**
+ * Binds a vertex array if it isn't already bound.
+ *
+ * @param vertexArray The vertex array to bind
+ * 
+ * @returns void
+ */
+void GLStateCache::BindVertexArray(GLuint vertexArray) {
+    if (this->vertexArray == vertexArray) {
+        stats.redundantChanges++;
+        return;
+    }
+    glBindVertexArray(vertexArray);
+    this->vertexArray = vertexArray;
+    stats.vertexArrayBinds++;
+}
+
+/**
+ * Binds a range of a buffer to a uniform block binding point if that
+ * range isn't already bound there. Only the first two binding points
+ * are shadowed, others are always bound.
+ *
+ * @param index The uniform block binding point
+ * @param buffer The buffer to bind
+ * @param offset The offset of the range
+ * @param size The size of the range
+ * 
+ * @returns void
+ */
+void GLStateCache::BindUniformRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    if (index < 2) {
+        if (uniformBuffers[index] == buffer && uniformOffsets[index] == offset && uniformSizes[index] == size) {
+            stats.redundantChanges++;
+            return;
+        }
+        uniformBuffers[index] = buffer;
+        uniformOffsets[index] = offset;
+        uniformSizes[index] = size;
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+    stats.bufferRangeBinds++;
+}
+
+/**
+ * Sets an int uniform of the program in use if it doesn't already have
+ * the value. Uniform values are program state, so they are shadowed per
+ * program and survive program switches.
+ *
+ * @param location The location of the uniform in the current program
+ * @param value The value to set
+ * 
+ * @returns void
+ */
+void GLStateCache::SetUniform(GLint location, int value) {
+    if (location < 0) {
+        return;
+    }
+    uint64_t key = ((uint64_t)program << 32) | (uint32_t)location;
+    auto it = intUniforms.find(key);
+    if (it != intUniforms.end() && it->second == value) {
+        stats.redundantChanges++;
+        return;
+    }
+    intUniforms[key] = value;
+    glUniform1i(location, value);
+    stats.uniformUploads++;
+}
+
+/**
+ * Sets a mat4 uniform of the current program if it doesn't already have
+ * the value.
+ *
+ * @param location The location of the uniform, ignored if -1
+ * @param value The value to set
+ * 
+ * @returns void
+ */
+void GLStateCache::SetUniform(GLint location, const glm::mat4& value) {
+    if (location < 0) {
+        return;
+    }
+    uint64_t key = ((uint64_t)program << 32) | (uint32_t)location;
+    auto it = matrixUniforms.find(key);
+    if (it != matrixUniforms.end() && it->second == value) {
+        stats.redundantChanges++;
+        return;
+    }
+    matrixUniforms[key] = value;
+    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+    stats.uniformUploads++;
+}
+
+/**
+ * Counts a draw call issued while the cache was in use.
+ * 
+ * @returns void
+ */
+void GLStateCache::CountDraw() {
+    stats.drawCalls++;
+}
+
+/**
+ * Gets the counters of state changes since they were last reset.
+ * 
+ * @returns The counters
+ */
+const RenderStats& GLStateCache::GetStats() const {
+    return stats;
+}
+
+/**
+ * Clears the counters.
+ * 
+ * @returns void
+ */
+void GLStateCache::ResetStats() {
+    stats = RenderStats();
+}
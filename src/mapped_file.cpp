@@ -0,0 +1,141 @@
+#include <mapped_file.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+/**
+ * Maps a whole file into memory for reading. Empty files can't be
+ * mapped and fail to open.
+ *
+ * @param path The path to the file
+ * 
+ * @returns true if the file was mapped, false otherwise
+ */
+bool MappedFile::Open(const std::string& path) {
+    Close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = (const unsigned char*)view;
+    size = fileSize.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    descriptor = fd;
+    data = (const unsigned char*)view;
+    size = info.st_size;
+#endif
+    return true;
+}
+
+/**
+ * Unmaps the file, pointers into the data become invalid.
+ * 
+ * @returns void
+ */
+void MappedFile::Close() {
+    if (data == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap((void*)data, size);
+    close(descriptor);
+    descriptor = -1;
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+/**
+ * Gets the mapped data.
+ * 
+ * @returns A pointer to the first byte of the file, nullptr if no file is mapped
+ */
+const unsigned char* MappedFile::GetData() const {
+    return data;
+}
+
+/**
+ * Gets the size of the mapped file.
+ * 
+ * @returns The size in bytes
+ */
+size_t MappedFile::GetSize() const {
+    return size;
+}
+
+/**
+ * Gets a path to write a file under before it is renamed over path. The
+ * name holds the process, the thread and a per-process counter, so two
+ * loaders writing the same file at once never write into each other's
+ * temporary file, and the rename of one never moves a file the other
+ * is still writing.
+ *
+ * @param path The path the file is renamed to when complete
+ * 
+ * @returns The temporary path next to it
+ */
+std::string MappedFile::GetTemporaryPath(const std::string& path) {
+    static std::atomic<unsigned int> counter{0};
+#ifdef _WIN32
+    int process = _getpid();
+#else
+    int process = getpid();
+#endif
+    size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return path + "." + std::to_string(process) + "." + std::to_string(thread) + "." +
+        std::to_string(counter++) + ".tmp";
+}
@@ -0,0 +1,490 @@
+#include <material_table.h>
+#include <sampler_cache.h>
+#include <texture_packer.h>
+#include <texture_streamer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+// Entry points of GL_ARB_bindless_texture, loaded by hand since glad
+// only covers GL 4.5 core
+typedef GLuint64 (APIENTRYP PFNGETTEXTURESAMPLERHANDLEPROC)(GLuint texture, GLuint sampler);
+typedef void (APIENTRYP PFNMAKETEXTUREHANDLERESIDENTPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNMAKETEXTUREHANDLENONRESIDENTPROC)(GLuint64 handle);
+
+static PFNGETTEXTURESAMPLERHANDLEPROC getTextureSamplerHandle = nullptr;
+static PFNMAKETEXTUREHANDLERESIDENTPROC makeTextureHandleResident = nullptr;
+static PFNMAKETEXTUREHANDLENONRESIDENTPROC makeTextureHandleNonResident = nullptr;
+
+// Layers the texture arrays start with, they double when full
+const GLsizei INITIAL_ARRAY_LAYERS = 8;
+
+// The textures of a material, 0 where the material has none. Materials
+// are released with their textures, their ID is then reused by the next
+// new material.
+struct Material {
+    GLuint diffuse;
+    GLuint specular;
+    bool resolved;
+    bool released;
+};
+
+// Where the shaders find a texture. Textures that could not be placed
+// keep an empty slot so they are not tried again every frame.
+struct TextureSlot {
+    GLuint64 handle = 0;
+    GLint array = -1;
+    GLint layer = -1;
+};
+
+// A texture array holding the textures of one size and format
+struct TextureArray {
+    GLTexture id;
+    GLenum internalFormat = 0;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLsizei levels = 0;
+    GLsizei capacity = 0;
+    GLsizei used = 0;
+    std::vector<GLint> freeLayers;
+};
+
+// Read by texture loads on worker threads while the render thread switches it
+static std::atomic<MaterialMode> mode{MATERIAL_MODE_BINDINGS};
+static bool bindlessSupported = false;
+static std::map<std::vector<std::pair<unsigned int, int>>, unsigned int> materialIDs;
+static std::vector<Material> materials;
+static std::vector<MaterialEntry> entries;
+
+// IDs of released materials to reuse, and of materials Bind has to place
+static std::vector<unsigned int> freeMaterials;
+static std::vector<unsigned int> dirtyMaterials;
+static std::unordered_map<GLuint, TextureSlot> slots;
+static TextureArray arrays[MAX_MATERIAL_ARRAYS];
+static int arrayCount = 0;
+
+// Buffer of the Materials block and the number of entries it has room for
+static GLBuffer buffer;
+static size_t bufferCapacity = 0;
+
+// Sampler the bindless handles were created with
+static GLuint handleSampler = 0;
+
+/**
+ * Checks if the current context supports an extension.
+ *
+ * @param name The name of the extension
+ *
+ * @returns true if the extension is supported, false otherwise
+ */
+static bool hasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Marks all materials to be placed again on the next Bind.
+ *
+ * @returns void
+ */
+static void invalidateMaterials() {
+    dirtyMaterials.clear();
+    for (unsigned int i = 0; i < materials.size(); i++) {
+        materials[i].resolved = false;
+        if (!materials[i].released) {
+            dirtyMaterials.push_back(i);
+        }
+    }
+}
+
+/**
+ * Frees the slot of a texture. Bindless handles are made non-resident
+ * and array layers are kept for the next texture of the same kind.
+ *
+ * @param slot The slot to free
+ *
+ * @returns void
+ */
+static void freeSlot(const TextureSlot& slot) {
+    if (slot.handle) {
+        makeTextureHandleNonResident(slot.handle);
+    }
+    if (slot.array >= 0) {
+        arrays[slot.array].freeLayers.push_back(slot.layer);
+    }
+}
+
+/**
+ * Frees all slots and texture arrays.
+ *
+ * @returns void
+ */
+static void freeSlots() {
+    for (const auto& entry : slots) {
+        if (entry.second.handle) {
+            makeTextureHandleNonResident(entry.second.handle);
+        }
+    }
+    slots.clear();
+    for (int i = 0; i < arrayCount; i++) {
+        arrays[i] = TextureArray();
+    }
+    arrayCount = 0;
+    invalidateMaterials();
+}
+
+/**
+ * Replaces the storage of a texture array with one of twice as many
+ * layers, copying the layers that are in use.
+ *
+ * @param array The array to grow
+ *
+ * @returns void
+ */
+static void growArray(TextureArray& array) {
+    GLsizei capacity = std::max(array.capacity * 2, INITIAL_ARRAY_LAYERS);
+    GLTexture id = GLTexture::Create(GL_TEXTURE_2D_ARRAY);
+    glTextureStorage3D(id, array.levels, array.internalFormat, array.width, array.height, capacity);
+    if (array.id) {
+        for (GLsizei level = 0; level < array.levels; level++) {
+            glCopyImageSubData(array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                std::max(array.width >> level, 1), std::max(array.height >> level, 1), array.used);
+        }
+    }
+    array.id = std::move(id);
+    array.capacity = capacity;
+}
+
+/**
+ * Copies a texture into a layer of the texture array of its size and
+ * format, creating the array if there is none. Textures without storage
+ * and textures that would need more than MAX_MATERIAL_ARRAYS arrays get
+ * no layer.
+ *
+ * @param texture The texture to copy
+ * @param slot_out Output for the array and layer of the texture
+ *
+ * @returns void
+ */
+static void placeInArray(GLuint texture, TextureSlot& slot_out) {
+    GLint width = 0;
+    GLint height = 0;
+    GLint internalFormat = 0;
+    GLint levels = 0;
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+    if (width == 0 || height == 0 || levels == 0) {
+        return;
+    }
+
+    int index = 0;
+    while (index < arrayCount && (arrays[index].width != width || arrays[index].height != height ||
+            arrays[index].internalFormat != (GLenum)internalFormat || arrays[index].levels != levels)) {
+        index++;
+    }
+    if (index == MAX_MATERIAL_ARRAYS) {
+        std::cout << "Material texture arrays are full, a " << width << "x" << height << " texture is left out" << std::endl;
+        return;
+    }
+    TextureArray& array = arrays[index];
+    if (index == arrayCount) {
+        array.internalFormat = internalFormat;
+        array.width = width;
+        array.height = height;
+        array.levels = levels;
+        arrayCount++;
+    }
+
+    GLint layer;
+    if (!array.freeLayers.empty()) {
+        layer = array.freeLayers.back();
+        array.freeLayers.pop_back();
+    } else {
+        if (array.used == array.capacity) {
+            growArray(array);
+        }
+        layer = array.used++;
+    }
+    for (GLint level = 0; level < levels; level++) {
+        glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0, array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+            std::max(width >> level, 1), std::max(height >> level, 1), 1);
+    }
+    slot_out.array = index;
+    slot_out.layer = layer;
+}
+
+/**
+ * Gets the slot of a texture, placing the texture the first time it is
+ * used. In bindless mode the texture gets a resident handle with the
+ * material sampler, otherwise it is copied into a texture array.
+ *
+ * @param texture The texture to get the slot of
+ *
+ * @returns The slot of the texture
+ */
+static const TextureSlot& getSlot(GLuint texture) {
+    auto it = slots.find(texture);
+    if (it != slots.end()) {
+        return it->second;
+    }
+    TextureSlot& slot = slots[texture];
+    if (mode == MATERIAL_MODE_BINDLESS) {
+        GLint width = 0;
+        glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+        if (width > 0) {
+            slot.handle = getTextureSamplerHandle(texture, handleSampler);
+            if (slot.handle) {
+                makeTextureHandleResident(slot.handle);
+            }
+        }
+    } else {
+        placeInArray(texture, slot);
+    }
+    return slot;
+}
+
+/**
+ * Gets the material ID of a set of textures. Meshes with the same
+ * textures in the same order share an ID, which lets draws be grouped
+ * by material and is the index of the material in the Materials block.
+ * New materials take the ID of a released material if there is one, so
+ * the table doesn't grow while models are loaded and unloaded.
+ * Layers of a packed texture array are told apart by their layer, the
+ * table has no entries for them and treats them as missing.
+ *
+ * @param textures The textures of a mesh
+ *
+ * @returns The material ID
+ */
+unsigned int MaterialTable::GetMaterial(const std::vector<Texture>& textures) {
+    std::vector<std::pair<unsigned int, int>> textureIDs;
+    for (const auto& texture : textures) {
+        textureIDs.push_back(std::make_pair(texture.id, texture.layer));
+    }
+    auto it = materialIDs.find(textureIDs);
+    if (it != materialIDs.end()) {
+        return it->second;
+    }
+
+    Material material = {0, 0, false, false};
+    for (const auto& texture : textures) {
+        if (texture.layer >= 0) {
+            continue;
+        }
+        if (texture.type == "texture_diffuse" && !material.diffuse) {
+            material.diffuse = texture.id;
+        } else if (texture.type == "texture_specular" && !material.specular) {
+            material.specular = texture.id;
+        }
+    }
+    unsigned int id;
+    if (!freeMaterials.empty()) {
+        id = freeMaterials.back();
+        freeMaterials.pop_back();
+        materials[id] = material;
+        entries[id] = MaterialEntry();
+    } else {
+        id = (unsigned int)materials.size();
+        materials.push_back(material);
+        entries.push_back(MaterialEntry());
+    }
+    materialIDs[textureIDs] = id;
+    dirtyMaterials.push_back(id);
+    return id;
+}
+
+/**
+ * Moves drawing to the material buffer. Bindless textures are used if
+ * they are allowed and the driver supports them, otherwise textures are
+ * copied into texture arrays. Materials are placed on the next Bind.
+ * Texture streaming and packing only work while textures are bound per
+ * mesh, a warning is printed if either of them is enabled.
+ *
+ * @param load The function to load GL entry points with
+ * @param allowBindless false to use texture arrays even with bindless support
+ *
+ * @returns The mode drawing has moved to
+ */
+MaterialMode MaterialTable::Enable(GLADloadproc load, bool allowBindless) {
+    Disable();
+    if (TextureStreamer::IsEnabled()) {
+        std::cout << "MaterialTable::Enable: texture streaming is off while the material table is enabled" << std::endl;
+    }
+    if (TexturePacker::IsEnabled()) {
+        std::cout << "MaterialTable::Enable: texture packing is off while the material table is enabled" << std::endl;
+    }
+    getTextureSamplerHandle = (PFNGETTEXTURESAMPLERHANDLEPROC)load("glGetTextureSamplerHandleARB");
+    makeTextureHandleResident = (PFNMAKETEXTUREHANDLERESIDENTPROC)load("glMakeTextureHandleResidentARB");
+    makeTextureHandleNonResident = (PFNMAKETEXTUREHANDLENONRESIDENTPROC)load("glMakeTextureHandleNonResidentARB");
+    bindlessSupported = hasExtension("GL_ARB_bindless_texture") &&
+        getTextureSamplerHandle && makeTextureHandleResident && makeTextureHandleNonResident;
+    mode = allowBindless && bindlessSupported ? MATERIAL_MODE_BINDLESS : MATERIAL_MODE_TEXTURE_ARRAYS;
+    return mode;
+}
+
+/**
+ * Frees the handles, texture arrays and buffer of the table and goes
+ * back to binding the textures of each mesh. Material IDs are kept.
+ *
+ * @returns void
+ */
+void MaterialTable::Disable() {
+    if (mode == MATERIAL_MODE_BINDINGS) {
+        return;
+    }
+    freeSlots();
+    buffer.Reset();
+    bufferCapacity = 0;
+    handleSampler = 0;
+    mode = MATERIAL_MODE_BINDINGS;
+}
+
+/**
+ * Gets how meshes get the textures of their material.
+ *
+ * @returns The material mode
+ */
+MaterialMode MaterialTable::GetMode() {
+    return mode;
+}
+
+/**
+ * Checks if the driver supports bindless textures.
+ *
+ * @returns true if bindless textures are supported, false otherwise or before Enable
+ */
+bool MaterialTable::IsBindlessSupported() {
+    return bindlessSupported;
+}
+
+/**
+ * Places the materials that were added or invalidated since the last
+ * call, uploads their entries and binds the Materials block and the texture arrays.
+ * All materials are placed again if the material sampler has changed,
+ * since a bindless handle fixes the sampler it was created with. Does
+ * nothing while textures are bound per mesh.
+ *
+ * @param state The state cache to bind the texture arrays through, may be nullptr
+ *
+ * @returns void
+ */
+void MaterialTable::Bind(GLStateCache* state) {
+    if (mode == MATERIAL_MODE_BINDINGS) {
+        return;
+    }
+    GLuint sampler = SamplerCache::GetMaterialSampler();
+    if (mode == MATERIAL_MODE_BINDLESS && sampler != handleSampler) {
+        freeSlots();
+        handleSampler = sampler;
+    }
+
+    size_t dirtyBegin = entries.size();
+    size_t dirtyEnd = 0;
+    for (unsigned int i : dirtyMaterials) {
+        Material& material = materials[i];
+        if (material.resolved || material.released) {
+            continue;
+        }
+        TextureSlot diffuse = material.diffuse ? getSlot(material.diffuse) : TextureSlot();
+        TextureSlot specular = material.specular ? getSlot(material.specular) : TextureSlot();
+        entries[i].diffuseHandle = diffuse.handle;
+        entries[i].specularHandle = specular.handle;
+        entries[i].diffuseArray = diffuse.array;
+        entries[i].diffuseLayer = diffuse.layer;
+        entries[i].specularArray = specular.array;
+        entries[i].specularLayer = specular.layer;
+        material.resolved = true;
+        dirtyBegin = std::min(dirtyBegin, (size_t)i);
+        dirtyEnd = std::max(dirtyEnd, (size_t)i + 1);
+    }
+    dirtyMaterials.clear();
+
+    if (entries.size() > bufferCapacity) {
+        bufferCapacity = std::max(bufferCapacity * 2, std::max(entries.size(), (size_t)64));
+        buffer = GLBuffer::Create();
+        glNamedBufferStorage(buffer, bufferCapacity * sizeof(MaterialEntry), NULL, GL_DYNAMIC_STORAGE_BIT);
+        dirtyBegin = 0;
+        dirtyEnd = entries.size();
+    }
+    if (dirtyBegin < dirtyEnd) {
+        glNamedBufferSubData(buffer, dirtyBegin * sizeof(MaterialEntry),
+            (dirtyEnd - dirtyBegin) * sizeof(MaterialEntry), &entries[dirtyBegin]);
+    }
+    if (buffer) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, buffer);
+    }
+
+    for (int i = 0; i < arrayCount; i++) {
+        if (state) {
+            state->BindTexture(MATERIAL_ARRAY_FIRST_UNIT + i, arrays[i].id);
+            state->BindSampler(MATERIAL_ARRAY_FIRST_UNIT + i, sampler);
+        } else {
+            glBindTextureUnit(MATERIAL_ARRAY_FIRST_UNIT + i, arrays[i].id);
+            glBindSampler(MATERIAL_ARRAY_FIRST_UNIT + i, sampler);
+        }
+    }
+}
+
+/**
+ * Drops a texture that is about to be deleted. Its handle is made
+ * non-resident or its layer freed. The materials using it are released
+ * and their IDs reused, so a texture created later with the same name
+ * starts a new material.
+ *
+ * @param texture The texture that is deleted
+ *
+ * @returns void
+ */
+void MaterialTable::ReleaseTexture(GLuint texture) {
+    auto slot = slots.find(texture);
+    if (slot != slots.end()) {
+        freeSlot(slot->second);
+        slots.erase(slot);
+    }
+    for (auto it = materialIDs.begin(); it != materialIDs.end();) {
+        auto uses = [texture](const std::pair<unsigned int, int>& entry) { return entry.first == texture; };
+        if (std::find_if(it->first.begin(), it->first.end(), uses) != it->first.end()) {
+            materials[it->second].released = true;
+            freeMaterials.push_back(it->second);
+            it = materialIDs.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+/**
+ * Gets the counters of the table.
+ *
+ * @returns The material stats
+ */
+MaterialStats MaterialTable::GetStats() {
+    MaterialStats stats;
+    stats.materials = materialIDs.size();
+    stats.arrays = arrayCount;
+    for (int i = 0; i < arrayCount; i++) {
+        stats.arrayLayers += arrays[i].used - arrays[i].freeLayers.size();
+    }
+    for (const auto& entry : slots) {
+        if (entry.second.handle) {
+            stats.residentHandles++;
+        } else if (entry.second.array < 0) {
+            stats.missingTextures++;
+        }
+    }
+    return stats;
+}
@@ -1,27 +1,499 @@
 # include <mesh.h>
+# include <triangle_bvh.h>
+# include <sampler_cache.h>
+# include <material_table.h>
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+# include <atomic>
 
-    setupMesh();
+// Smallest index type meshes choose when their vertices fit it
+static GLenum smallestIndexType = GL_UNSIGNED_SHORT;
+
+// Whether meshes keep CPU copies of their data, and the bytes all of them keep
+static bool keepCPUData = false;
+static std::atomic<size_t> residentCPUBytes{0};
+
+/**
+ * Copies indices into a buffer of a smaller index type.
+ *
+ * @param indexData The indices, all of which fit the type
+ * @param indexCount The number of indices
+ *
+ * @returns The narrowed indices
+ */
+template<typename T>
+static std::vector<T> narrowIndices(const unsigned int* indexData, size_t indexCount) {
+    return std::vector<T>(indexData, indexData + indexCount);
+}
+
+/**
+ * Creates a mesh from vertices and indices it takes over, pass them with
+ * std::move to avoid a copy. Once they are uploaded the vectors are
+ * freed, unless CPU copies are kept with SetKeepCPUData.
+ *
+ * @param vertices The vertices of the mesh
+ * @param indices The indices of the mesh
+ * @param textures The textures of the mesh
+ * @param layout The layout to upload the vertices in
+ * @param positionStream true to keep the positions in a separate buffer
+ */
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+    VertexLayout layout, bool positionStream) {
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    materialID = MaterialTable::GetMaterial(this->textures);
+
+    // Bounds of the mesh, used to cull it separately from its model
+    aabbMin = glm::vec3(0.0f);
+    aabbMax = glm::vec3(0.0f);
+    if (!this->vertices.empty()) {
+        aabbMin = this->vertices[0].Position;
+        aabbMax = this->vertices[0].Position;
+    }
+    for (const auto& vertex : this->vertices) {
+        aabbMin = glm::min(aabbMin, vertex.Position);
+        aabbMax = glm::max(aabbMax, vertex.Position);
+    }
+
+    vertexCount = this->vertices.size();
+    indexCount = this->indices.size();
+    this->layout = layout;
+    this->positionStream = positionStream;
+    setupMesh(this->vertices.data(), this->indices.data());
+    keepOrReleaseCPUData();
+}
+
+/**
+ * Creates a mesh directly from vertex and index data in memory, such as
+ * a memory-mapped cooked model. The data is uploaded without being
+ * copied, and only copied into the vertices and indices vectors if CPU
+ * copies are kept. Quantized layouts are encoded into a temporary buffer
+ * first.
+ *
+ * @param vertexData The vertices of the mesh
+ * @param vertexCount The number of vertices
+ * @param indexData The indices of the mesh
+ * @param indexCount The number of indices
+ * @param textures The textures of the mesh
+ * @param aabbMin The min coordinates of the vertices
+ * @param aabbMax The max coordinates of the vertices
+ * @param layout The layout to upload the vertices in
+ * @param positionStream true to keep the positions in a separate buffer
+ */
+Mesh::Mesh(
+    const Vertex* vertexData,
+    size_t vertexCount,
+    const unsigned int* indexData,
+    size_t indexCount,
+    std::vector<Texture> textures,
+    glm::vec3 aabbMin,
+    glm::vec3 aabbMax,
+    VertexLayout layout,
+    bool positionStream) {
+    this->textures = std::move(textures);
+    materialID = MaterialTable::GetMaterial(this->textures);
+    this->aabbMin = aabbMin;
+    this->aabbMax = aabbMax;
+    this->vertexCount = vertexCount;
+    this->indexCount = indexCount;
+    this->layout = layout;
+    this->positionStream = positionStream;
+    setupMesh(vertexData, indexData);
+    if (keepCPUData) {
+        vertices.assign(vertexData, vertexData + vertexCount);
+        indices.assign(indexData, indexData + indexCount);
+        keepOrReleaseCPUData();
+    }
 }
 
 /**
- * Renders the mesh with a specific shader program.
+ * Renders the mesh with a specific shader program. Shaders reading the
+ * material table need MaterialTable::Bind to have been called.
  *
  * @param shader The shader program to use when rendering
  * 
  * @returns void
  */
-void Mesh::Draw(Shader shader) {
+void Mesh::Draw(const Shader& shader) {
+    if (indexCount == 0) {
+        return;
+    }
+    if (shader.GetGeneration() != samplerShaderGeneration) {
+        resolveSamplers(shader);
+    }
+
+    // Shaders reading the material table only need the index of the material
+    bool materialTable = MaterialTable::GetMode() != MATERIAL_MODE_BINDINGS;
+    if (materialHandle.IsValid()) {
+        shader.set(materialHandle, materialTable ? (int)materialID : -1);
+    }
+
+    // Set all uniform sampler2D textures for the mesh, packed textures go to the array samplers
+    if (!materialTable || !materialHandle.IsValid()) {
+        GLuint sampler = SamplerCache::GetMaterialSampler();
+        for (unsigned int i = 0; i < textures.size(); i++) {
+            GLuint unit = i;
+            GLuint texture = textures[i].id;
+            if (textures[i].layer >= 0 && arrayUnits[i] >= 0) {
+                unit = arrayUnits[i];
+            } else {
+                shader.set(samplerHandles[i], i);
+                if (textures[i].layer >= 0) {
+                    texture = 0;
+                }
+            }
+            glBindTextureUnit(unit, texture);
+            glBindSampler(unit, sampler);
+            if (layerHandles[i].IsValid()) {
+                shader.set(layerHandles[i], textures[i].layer);
+            }
+        }
+    }
+
+    // Positions of quantized layouts are relative to the bounds of the mesh
+    if (positionDecodeHandle.IsValid()) {
+        shader.set(positionDecodeHandle, positionDecode);
+    }
+    if (octahedralNormalsHandle.IsValid()) {
+        shader.set(octahedralNormalsHandle, layout != VERTEX_LAYOUT_FLOAT ? 1 : 0);
+    }
+
+    // Draw mesh
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+    glBindVertexArray(0);
+}
+
+/**
+ * Renders the mesh through a state cache. Textures and the vertex array
+ * are only bound if they differ from what the cache has bound, and the
+ * vertex array is left bound for the next draw.
+ *
+ * @param shader The shader program to use when rendering, must be in use
+ * @param state The state cache to bind through
+ * 
+ * @returns void
+ */
+void Mesh::Draw(const Shader& shader, GLStateCache& state) {
+    if (indexCount == 0) {
+        return;
+    }
+    BindTextures(shader, state);
+    BindVertexDecode(shader, state);
+    state.BindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+    state.CountDraw();
+}
+
+/**
+ * Renders instances of the mesh in a single draw call. The instance
+ * data is read from a range of a buffer holding InstanceData entries.
+ *
+ * @param shader The instanced shader program to use, must be in use
+ * @param state The state cache to bind through
+ * @param instanceBuffer The buffer holding the instance data
+ * @param offset The offset of the first instance in the buffer
+ * @param count The number of instances to draw
+ * 
+ * @returns void
+ */
+void Mesh::DrawInstanced(const Shader& shader, GLStateCache& state, GLuint instanceBuffer, GLintptr offset, GLsizei count) {
+    if (indexCount == 0) {
+        return;
+    }
+    if (!instanceAttributes) {
+        setupInstanceAttributes();
+    }
+    BindTextures(shader, state);
+    BindVertexDecode(shader, state);
+    state.BindVertexArray(VAO);
+    glVertexArrayVertexBuffer(VAO, INSTANCE_BINDING, instanceBuffer, offset, sizeof(InstanceData));
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, 0, count);
+    state.CountDraw();
+}
+
+/**
+ * Binds the textures of the mesh to consecutive texture units with the
+ * material sampler and points the sampler uniforms at them, skipping
+ * what the cache already has. Textures packed into a texture array are
+ * bound to the unit of the shader's array sampler for them instead, with
+ * their layer set in its layer uniform. Shaders without the array sampler
+ * get no texture on the unit of a packed texture, since a texture array
+ * can't be read through a sampler2D. Shaders with a materialIndex uniform get
+ * the material ID instead while the material table is enabled, they
+ * fetch the textures from the table.
+ *
+ * @param shader The shader program the textures are used with
+ * @param state The state cache to bind through
+ * 
+ * @returns void
+ */
+void Mesh::BindTextures(const Shader& shader, GLStateCache& state) {
+    if (shader.GetGeneration() != samplerShaderGeneration) {
+        resolveSamplers(shader);
+    }
+    bool materialTable = MaterialTable::GetMode() != MATERIAL_MODE_BINDINGS;
+    if (materialHandle.IsValid()) {
+        state.SetUniform(materialHandle.location, materialTable ? (int)materialID : -1);
+        if (materialTable) {
+            return;
+        }
+    }
+    GLuint sampler = SamplerCache::GetMaterialSampler();
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        GLuint unit = i;
+        GLuint texture = textures[i].id;
+        if (textures[i].layer >= 0 && arrayUnits[i] >= 0) {
+            unit = arrayUnits[i];
+        } else {
+            state.SetUniform(samplerHandles[i].location, i);
+            if (textures[i].layer >= 0) {
+                texture = 0;
+            }
+        }
+        state.BindTexture(unit, texture);
+        state.BindSampler(unit, sampler);
+        if (layerHandles[i].IsValid()) {
+            state.SetUniform(layerHandles[i].location, textures[i].layer);
+        }
+    }
+}
+
+/**
+ * Sets the uniforms of a shader that decode the vertices of the mesh,
+ * the positionDecode matrix mapping quantized positions to model space
+ * and whether normals are octahedral encoded. They are set for float
+ * vertices too, since the previous mesh drawn with the program may have
+ * been quantized.
+ *
+ * @param shader The shader program the mesh is drawn with
+ * @param state The state cache to set the uniforms through
+ * 
+ * @returns void
+ */
+void Mesh::BindVertexDecode(const Shader& shader, GLStateCache& state) {
+    if (shader.GetGeneration() != samplerShaderGeneration) {
+        resolveSamplers(shader);
+    }
+    state.SetUniform(positionDecodeHandle.location, positionDecode);
+    state.SetUniform(octahedralNormalsHandle.location, layout != VERTEX_LAYOUT_FLOAT ? 1 : 0);
+}
+
+/**
+ * Frees the CPU copies of the vertices and indices of the mesh. The mesh
+ * still draws from its buffers, but ray casts against it need a triangle
+ * BVH built before the copies were freed.
+ * 
+ * @returns void
+ */
+void Mesh::ReleaseCPUData() {
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+    residentBytes.Set(0);
+}
+
+/**
+ * Checks if the mesh keeps CPU copies of its vertices and indices, which
+ * ray casts without a BVH and Mesh::BuildBVH read.
+ * 
+ * @returns true if the mesh has CPU copies, false otherwise
+ */
+bool Mesh::HasCPUData() const {
+    return !vertices.empty();
+}
+
+/**
+ * Makes meshes created afterwards keep CPU copies of their vertices and
+ * indices after uploading them, for picking without a BVH, physics or
+ * other CPU side use. Meshes free them by default.
+ *
+ * @param keep true to keep CPU copies
+ * 
+ * @returns void
+ */
+void Mesh::SetKeepCPUData(bool keep) {
+    keepCPUData = keep;
+}
+
+/**
+ * Checks if meshes keep CPU copies of their vertices and indices.
+ * 
+ * @returns true if CPU copies are kept, false otherwise
+ */
+bool Mesh::IsKeepingCPUData() {
+    return keepCPUData;
+}
+
+/**
+ * Gets the bytes of vertices and indices kept on the CPU by all meshes
+ * of the process, copies of a mesh included.
+ * 
+ * @returns The resident bytes
+ */
+size_t Mesh::GetResidentCPUBytes() {
+    return ResidentBytes::GetTotal();
+}
+
+/**
+ * Counts the CPU copies of the vertices and indices in the process-wide
+ * total if CPU copies are kept, otherwise frees them.
+ * 
+ * @returns void
+ */
+void Mesh::keepOrReleaseCPUData() {
+    if (!keepCPUData) {
+        ReleaseCPUData();
+        return;
+    }
+    residentBytes.Set(vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int));
+}
+
+ResidentBytes::ResidentBytes(ResidentBytes&& other) noexcept {
+    bytes = other.bytes;
+    other.bytes = 0;
+}
+
+ResidentBytes& ResidentBytes::operator=(ResidentBytes&& other) noexcept {
+    if (this != &other) {
+        Set(0);
+        bytes = other.bytes;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+ResidentBytes::~ResidentBytes() {
+    Set(0);
+}
+
+/**
+ * Adds the indices of a mesh to the counters.
+ *
+ * @param indexCount The number of indices of the mesh
+ * @param indexType The type the indices are stored in
+ * 
+ * @returns void
+ */
+void IndexMemoryStats::Add(GLsizei indexCount, GLenum indexType) {
+    indexBytes += (size_t)indexCount * Mesh::GetIndexTypeSize(indexType);
+    fullBytes += (size_t)indexCount * sizeof(unsigned int);
+    byteMeshes += indexType == GL_UNSIGNED_BYTE;
+    shortMeshes += indexType == GL_UNSIGNED_SHORT;
+    intMeshes += indexType == GL_UNSIGNED_INT;
+}
+
+/**
+ * Gets the index memory saved by storing indices in smaller types.
+ * 
+ * @returns The bytes saved against 32-bit indices
+ */
+size_t IndexMemoryStats::GetSavedBytes() const {
+    return fullBytes - indexBytes;
+}
+
+/**
+ * Replaces the bytes the counter adds to the process-wide total.
+ *
+ * @param bytes The bytes to count
+ * 
+ * @returns void
+ */
+void ResidentBytes::Set(size_t bytes) {
+    residentCPUBytes += bytes;
+    residentCPUBytes -= this->bytes;
+    this->bytes = bytes;
+}
+
+/**
+ * Gets the bytes counted by all live counters.
+ * 
+ * @returns The total bytes
+ */
+size_t ResidentBytes::GetTotal() {
+    return residentCPUBytes;
+}
+
+/**
+ * Gets the vertex array of the mesh.
+ * 
+ * @returns The vertex array
+ */
+unsigned int Mesh::GetVAO() const {
+    return VAO;
+}
+
+/**
+ * Gets the ID of the mesh's set of textures.
+ * 
+ * @returns The material ID
+ */
+unsigned int Mesh::GetMaterialID() const {
+    return materialID;
+}
+
+/**
+ * Builds a triangle BVH from the vertices and indices of the mesh so
+ * that rays can be tested against its triangles. Meshes that keep no
+ * CPU copy of their data get no BVH, build it at load time instead or
+ * keep the copies with SetKeepCPUData.
+ * 
+ * @returns true if the mesh has a BVH, false if it has no data to build one from
+ */
+bool Mesh::BuildBVH() {
+    if (vertices.empty() || indices.empty()) {
+        return bvh != nullptr;
+    }
+    std::shared_ptr<TriangleBVH> triangleBVH = std::make_shared<TriangleBVH>();
+    triangleBVH->Build(vertices, indices);
+    bvh = triangleBVH;
+    return true;
+}
+
+/**
+ * Sets a triangle BVH that was built from the vertices and indices of
+ * the mesh, for example on a loader thread before the mesh existed.
+ *
+ * @param triangleBVH The triangle BVH
+ * 
+ * @returns void
+ */
+void Mesh::SetBVH(std::shared_ptr<const TriangleBVH> triangleBVH) {
+    bvh = triangleBVH;
+}
+
+/**
+ * Gets the triangle BVH of the mesh.
+ * 
+ * @returns The triangle BVH, nullptr if it hasn't been built
+ */
+const TriangleBVH* Mesh::GetBVH() const {
+    return bvh.get();
+}
+
+/**
+ * Resolves the sampler uniform of each texture in the shader, the unit
+ * of the array sampler and the layer uniform for packed textures, the
+ * material index uniform of shaders reading the material table and the
+ * uniforms decoding quantized vertices. The
+ * handles are kept until the mesh is drawn with another shader so
+ * the uniform names are only built once. Prints a warning for packed
+ * textures the shader has no array sampler for, they are left unbound.
+ *
+ * @param shader The shader program to resolve the samplers in
+ * 
+ * @returns void
+ */
+void Mesh::resolveSamplers(const Shader& shader) {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
 
-    // Set all uniform sampler2D textures for the mesh
+    samplerHandles.clear();
+    samplerHandles.reserve(textures.size());
+    layerHandles.clear();
+    layerHandles.reserve(textures.size());
+    arrayUnits.clear();
+    arrayUnits.reserve(textures.size());
     for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
         std::string number;
         std::string name = textures[i].type;
         if (name == "texture_diffuse") {
@@ -29,45 +501,408 @@ void Mesh::Draw(Shader shader) {
         } else if (name == "texture_specular") {
             number = std::to_string(specularNr++);
         }
-        shader.setInt(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        samplerHandles.push_back(shader.GetUniform<int>("material." + name + number));
+        layerHandles.push_back(shader.GetUniform<int>(name + number + "_layer"));
+        arrayUnits.push_back(shader.GetSamplerUnit(name + number + "_array"));
+        if (textures[i].layer >= 0 && arrayUnits.back() < 0) {
+            std::cout << "Mesh: " << textures[i].path << " is packed into a texture array, but the shader has no "
+                << name + number + "_array sampler, the texture is left unbound" << std::endl;
+        }
     }
-    glActiveTexture(GL_TEXTURE0);
-
-    // Draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    materialHandle = shader.GetUniform<int>("materialIndex");
+    positionDecodeHandle = shader.GetUniform<glm::mat4>("positionDecode");
+    octahedralNormalsHandle = shader.GetUniform<int>("octahedralNormals");
+    samplerShaderGeneration = shader.GetGeneration();
 }
 
 /**
- * Creates and bind buffers and sets vertex attribute pointers.
+ * Creates the buffers and vertex array of the mesh. The vertices are
+ * read from binding point VERTEX_BINDING, INSTANCE_BINDING is reserved
+ * for instance data. Vertices of quantized layouts are encoded relative
+ * to the bounds of the mesh, and indices are stored in the smallest
+ * allowed type that addresses all vertices. With a position stream the
+ * positions go to their own buffer, read from POSITION_BINDING. Meshes
+ * without vertices or indices get no buffers and draw nothing.
+ *
+ * @param vertexData The vertexCount vertices to upload
+ * @param indexData The indexCount indices to upload
  * 
  * @returns void
  */
-void Mesh::setupMesh() {
+void Mesh::setupMesh(const Vertex* vertexData, const unsigned int* indexData) {
+    // Buffers can't have a storage of 0 bytes, empty meshes get none and are never drawn
+    if (vertexCount == 0 || indexCount == 0) {
+        indexCount = 0;
+        return;
+    }
+
     // Generate buffers
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    VAO = GLVertexArray::Create();
+    VBO = GLBuffer::Create();
+    EBO = GLBuffer::Create();
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    positionDecode = VertexFormat::GetPositionDecode(layout, aabbMin, aabbMax);
+    GLsizei stride = GetVertexStride();
+    if (positionStream) {
+        std::vector<uint8_t> positions;
+        std::vector<uint8_t> attributes;
+        VertexFormat::SplitPositions(VertexFormat::Encode(vertexData, vertexCount, layout, aabbMin, aabbMax),
+            layout, positions, attributes);
+        positionVBO = GLBuffer::Create();
+        glNamedBufferStorage(positionVBO, positions.size(), positions.data(), 0);
+        glNamedBufferStorage(VBO, attributes.size(), attributes.data(), 0);
+        glVertexArrayVertexBuffer(VAO, POSITION_BINDING, positionVBO, 0, GetPositionStride());
+    } else if (layout == VERTEX_LAYOUT_FLOAT) {
+        glNamedBufferStorage(VBO, vertexCount * stride, vertexData, 0);
+    } else {
+        std::vector<uint8_t> encoded = VertexFormat::Encode(vertexData, vertexCount, layout, aabbMin, aabbMax);
+        glNamedBufferStorage(VBO, encoded.size(), encoded.data(), 0);
+    }
+    indexType = ChooseIndexType(vertexCount);
+    if (indexType == GL_UNSIGNED_BYTE) {
+        std::vector<uint8_t> narrowed = narrowIndices<uint8_t>(indexData, indexCount);
+        glNamedBufferStorage(EBO, indexCount * sizeof(uint8_t), narrowed.data(), 0);
+    } else if (indexType == GL_UNSIGNED_SHORT) {
+        std::vector<uint16_t> narrowed = narrowIndices<uint16_t>(indexData, indexCount);
+        glNamedBufferStorage(EBO, indexCount * sizeof(uint16_t), narrowed.data(), 0);
+    } else {
+        glNamedBufferStorage(EBO, indexCount * sizeof(unsigned int), indexData, 0);
+    }
+
+    glVertexArrayVertexBuffer(VAO, VERTEX_BINDING, VBO, 0, stride);
+    glVertexArrayElementBuffer(VAO, EBO);
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    SetupVertexFormat(VAO, layout, positionStream);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+/**
+ * Enables the per-instance attributes of the vertex array. This is done
+ * the first time the mesh is drawn instanced since the attributes need a
+ * buffer bound at INSTANCE_BINDING.
+ * 
+ * @returns void
+ */
+void Mesh::setupInstanceAttributes() {
+    SetupInstanceFormat(VAO);
+    instanceAttributes = true;
+}
 
-    // Vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+/**
+ * Sets up the vertex attributes of a vertex array to read vertices of a
+ * layout from binding point VERTEX_BINDING. Quantized positions are read
+ * as normalized 16-bit values, octahedral normals as two normalized
+ * values that leave the z of the attribute 0, and texture coordinates
+ * as half floats. With a position stream, positions are read from
+ * POSITION_BINDING instead and the other attributes start each vertex.
+ *
+ * @param vertexArray The vertex array to set up
+ * @param layout The layout of the vertices
+ * @param positionStream true if positions are in a separate buffer
+ * 
+ * @returns void
+ */
+void Mesh::SetupVertexFormat(GLuint vertexArray, VertexLayout layout, bool positionStream) {
+    GLenum positionType = GL_FLOAT;
+    GLboolean positionNormalized = GL_FALSE;
+    GLint normalSize = 3;
+    GLenum normalType = GL_FLOAT;
+    GLboolean normalNormalized = GL_FALSE;
+    GLenum texCoordType = GL_FLOAT;
+    GLuint normalOffset = offsetof(Vertex, Normal);
+    GLuint texCoordOffset = offsetof(Vertex, TexCoords);
+    if (layout == VERTEX_LAYOUT_QUANTIZED_OCT8) {
+        positionType = GL_UNSIGNED_SHORT;
+        positionNormalized = GL_TRUE;
+        normalSize = 2;
+        normalType = GL_BYTE;
+        normalNormalized = GL_TRUE;
+        texCoordType = GL_HALF_FLOAT;
+        normalOffset = offsetof(QuantizedVertexOct8, normal);
+        texCoordOffset = offsetof(QuantizedVertexOct8, texCoords);
+    } else if (layout == VERTEX_LAYOUT_QUANTIZED_OCT16) {
+        positionType = GL_UNSIGNED_SHORT;
+        positionNormalized = GL_TRUE;
+        normalSize = 2;
+        normalType = GL_SHORT;
+        normalNormalized = GL_TRUE;
+        texCoordType = GL_HALF_FLOAT;
+        normalOffset = offsetof(QuantizedVertexOct16, normal);
+        texCoordOffset = offsetof(QuantizedVertexOct16, texCoords);
+    }
+    if (positionStream) {
+        normalOffset -= VertexFormat::GetAttributesOffset(layout);
+        texCoordOffset -= VertexFormat::GetAttributesOffset(layout);
+    }
+
+    for (GLuint i = 0; i < 3; i++) {
+        glEnableVertexArrayAttrib(vertexArray, i);
+    }
+    // Vertex positions, first in every layout
+    glVertexArrayAttribFormat(vertexArray, 0, 3, positionType, positionNormalized, 0);
+    glVertexArrayAttribBinding(vertexArray, 0, positionStream ? POSITION_BINDING : VERTEX_BINDING);
     // Vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, Normal)));
+    glVertexArrayAttribFormat(vertexArray, 1, normalSize, normalType, normalNormalized, normalOffset);
+    glVertexArrayAttribBinding(vertexArray, 1, VERTEX_BINDING);
     // Vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, TexCoords)));
+    glVertexArrayAttribFormat(vertexArray, 2, 2, texCoordType, GL_FALSE, texCoordOffset);
+    glVertexArrayAttribBinding(vertexArray, 2, VERTEX_BINDING);
+}
 
-    glBindVertexArray(0);
-}
\ No newline at end of file
+/**
+ * Sets up the instance attributes of a vertex array to read InstanceData
+ * structs from binding point INSTANCE_BINDING, advancing once per instance.
+ *
+ * @param vertexArray The vertex array to set up
+ * 
+ * @returns void
+ */
+void Mesh::SetupInstanceFormat(GLuint vertexArray) {
+    glVertexArrayBindingDivisor(vertexArray, INSTANCE_BINDING, 1);
+    // Model matrix columns
+    for (GLuint i = 0; i < 4; i++) {
+        glEnableVertexArrayAttrib(vertexArray, 3 + i);
+        glVertexArrayAttribFormat(vertexArray, 3 + i, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData, model) + i * sizeof(glm::vec4));
+        glVertexArrayAttribBinding(vertexArray, 3 + i, INSTANCE_BINDING);
+    }
+    // Normal matrix columns
+    for (GLuint i = 0; i < 3; i++) {
+        glEnableVertexArrayAttrib(vertexArray, 7 + i);
+        glVertexArrayAttribFormat(vertexArray, 7 + i, 3, GL_FLOAT, GL_FALSE, offsetof(InstanceData, normalMatrix) + i * sizeof(glm::vec4));
+        glVertexArrayAttribBinding(vertexArray, 7 + i, INSTANCE_BINDING);
+    }
+}
+
+/**
+ * Sets the smallest index type meshes may store their indices in. Each
+ * mesh picks the smallest type at least as large as this one that can
+ * address all of its vertices when it is created. GL_UNSIGNED_BYTE
+ * allows 8-bit indices, which some GPUs convert on the fly, and
+ * GL_UNSIGNED_INT keeps all indices 32-bit.
+ *
+ * @param type GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+ * 
+ * @returns void
+ */
+void Mesh::SetSmallestIndexType(GLenum type) {
+    smallestIndexType = type;
+}
+
+/**
+ * Gets the smallest index type meshes may store their indices in.
+ * 
+ * @returns The index type
+ */
+GLenum Mesh::GetSmallestIndexType() {
+    return smallestIndexType;
+}
+
+/**
+ * Chooses the smallest allowed index type whose values can address a
+ * number of vertices.
+ *
+ * @param vertexCount The number of vertices the indices refer to
+ * 
+ * @returns The index type
+ */
+GLenum Mesh::ChooseIndexType(size_t vertexCount) {
+    if (smallestIndexType == GL_UNSIGNED_BYTE && vertexCount <= 0x100) {
+        return GL_UNSIGNED_BYTE;
+    }
+    if (smallestIndexType != GL_UNSIGNED_INT && vertexCount <= 0x10000) {
+        return GL_UNSIGNED_SHORT;
+    }
+    return GL_UNSIGNED_INT;
+}
+
+/**
+ * Gets the size of an index of a type.
+ *
+ * @param type The index type
+ * 
+ * @returns The size in bytes
+ */
+GLsizei Mesh::GetIndexTypeSize(GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+            return sizeof(uint8_t);
+        case GL_UNSIGNED_SHORT:
+            return sizeof(uint16_t);
+        default:
+            return sizeof(unsigned int);
+    }
+}
+
+/**
+ * Gets the min coordinates of the mesh.
+ * 
+ * @returns The min coordinates
+ */
+glm::vec3 Mesh::GetMinCoords() const {
+    return aabbMin;
+}
+
+/**
+ * Gets the max coordinates of the mesh.
+ * 
+ * @returns The max coordinates
+ */
+glm::vec3 Mesh::GetMaxCoords() const {
+    return aabbMax;
+}
+
+/**
+ * Records where the geometry of the mesh was placed in a geometry pool.
+ *
+ * @param pool The pool the mesh was added to
+ * @param baseVertex The index of the first vertex of the mesh in the pool
+ * @param firstIndex The index of the first index of the mesh in the pool
+ * 
+ * @returns void
+ */
+void Mesh::SetPoolRange(GeometryPool* pool, GLint baseVertex, GLuint firstIndex) {
+    this->pool = pool;
+    poolBaseVertex = baseVertex;
+    poolFirstIndex = firstIndex;
+}
+
+/**
+ * Gets the geometry pool the mesh has been added to.
+ * 
+ * @returns The pool, nullptr if the mesh is not in a pool
+ */
+GeometryPool* Mesh::GetPool() const {
+    return pool;
+}
+
+/**
+ * Gets the index of the first vertex of the mesh in its geometry pool.
+ * 
+ * @returns The base vertex
+ */
+GLint Mesh::GetPoolBaseVertex() const {
+    return poolBaseVertex;
+}
+
+/**
+ * Gets the index of the first index of the mesh in its geometry pool.
+ * 
+ * @returns The first index
+ */
+GLuint Mesh::GetPoolFirstIndex() const {
+    return poolFirstIndex;
+}
+
+/**
+ * Gets the number of indices of the mesh.
+ * 
+ * @returns The index count
+ */
+GLuint Mesh::GetIndexCount() const {
+    return indexCount;
+}
+
+/**
+ * Gets the number of vertices of the mesh.
+ * 
+ * @returns The vertex count
+ */
+GLuint Mesh::GetVertexCount() const {
+    return vertexCount;
+}
+
+/**
+ * Gets the buffer holding the vertices of the mesh.
+ * 
+ * @returns The vertex buffer
+ */
+unsigned int Mesh::GetVertexBuffer() const {
+    return VBO;
+}
+
+/**
+ * Gets the buffer holding the indices of the mesh.
+ * 
+ * @returns The index buffer
+ */
+unsigned int Mesh::GetIndexBuffer() const {
+    return EBO;
+}
+
+/**
+ * Gets the type of the indices in the index buffer of the mesh.
+ * 
+ * @returns GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+ */
+GLenum Mesh::GetIndexType() const {
+    return indexType;
+}
+
+/**
+ * Gets the size of an index in the index buffer of the mesh.
+ * 
+ * @returns The size in bytes
+ */
+GLsizei Mesh::GetIndexSize() const {
+    return GetIndexTypeSize(indexType);
+}
+
+/**
+ * Gets the layout the vertices of the mesh are stored in.
+ * 
+ * @returns The vertex layout
+ */
+VertexLayout Mesh::GetVertexLayout() const {
+    return layout;
+}
+
+/**
+ * Gets the size of a vertex in the vertex buffer of the mesh, without
+ * the position if it is in a separate stream.
+ * 
+ * @returns The stride in bytes
+ */
+GLsizei Mesh::GetVertexStride() const {
+    size_t stride = VertexFormat::GetStride(layout);
+    if (positionStream) {
+        stride -= VertexFormat::GetAttributesOffset(layout);
+    }
+    return (GLsizei)stride;
+}
+
+/**
+ * Gets the buffer holding the positions of the mesh when they are in a
+ * separate stream.
+ * 
+ * @returns The position buffer, 0 if positions are in the vertex buffer
+ */
+unsigned int Mesh::GetPositionBuffer() const {
+    return positionVBO;
+}
+
+/**
+ * Gets the size of a position in the position buffer of the mesh.
+ * 
+ * @returns The stride in bytes, 0 if positions are in the vertex buffer
+ */
+GLsizei Mesh::GetPositionStride() const {
+    return positionStream ? (GLsizei)VertexFormat::GetPositionSize(layout) : 0;
+}
+
+/**
+ * Checks if the positions of the mesh are in a separate stream.
+ * 
+ * @returns true if the mesh has a position buffer, false otherwise
+ */
+bool Mesh::HasPositionStream() const {
+    return positionStream;
+}
+
+/**
+ * Gets the matrix that maps the positions in the vertex buffer of the
+ * mesh to model space, identity for float vertices.
+ * 
+ * @returns The decode matrix
+ */
+const glm::mat4& Mesh::GetPositionDecode() const {
+    return positionDecode;
+}
@@ -0,0 +1,591 @@
+#include <mesh_optimizer.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+// Valence up to which vertex scores are looked up instead of computed
+const unsigned int MAX_SCORED_VALENCE = 32;
+
+static bool optimizerEnabled = true;
+static WeldMode weldMode = WELD_EXACT;
+static float weldEpsilon = DEFAULT_WELD_EPSILON;
+
+// The attributes of a vertex as bits, or as grid cells in epsilon mode
+typedef std::array<int64_t, sizeof(Vertex) / sizeof(float)> WeldKey;
+
+// Largest grid cell of an attribute in epsilon mode, larger cells and
+// infinities are clamped to it and NaN is put in cell 0
+const double MAX_WELD_CELL = 4611686018427387904.0;
+
+// Hashes weld keys with 64-bit FNV-1a over their words
+struct WeldKeyHash {
+    size_t operator()(const WeldKey& key) const {
+        uint64_t hash = 14695981039346656037ull;
+        for (int64_t word : key) {
+            hash ^= (uint64_t)word;
+            hash *= 1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+/**
+ * Gets the grid cell an attribute is rounded to in epsilon mode. The
+ * cell is computed in double precision and clamped, so that attributes
+ * far outside the grid never overflow the integer they are stored in.
+ *
+ * @param attribute The attribute
+ * @param epsilon The size of a grid cell
+ *
+ * @returns The index of the nearest grid cell
+ */
+static int64_t getWeldCell(float attribute, float epsilon) {
+    double cell = std::floor((double)attribute / epsilon + 0.5);
+    if (std::isnan(cell)) {
+        return 0;
+    }
+    return (int64_t)std::min(std::max(cell, -MAX_WELD_CELL), MAX_WELD_CELL);
+}
+
+// A run of triangles that is moved as a whole when ordering for overdraw
+struct TriangleCluster {
+    size_t firstTriangle;
+    size_t triangleCount;
+    float sortKey;
+};
+
+/**
+ * Gets the score of a vertex in Tom Forsyth's algorithm. Vertices used
+ * by the last triangle get a fixed score so that the next triangle
+ * doesn't just reuse the same edge, the rest of the cache scores by how
+ * recently the vertex was used, and vertices with few triangles left
+ * get a boost so that no lone triangles are left behind.
+ *
+ * @param cachePosition The position of the vertex in the LRU cache, -1 if it isn't in it
+ * @param remaining The number of triangles left that use the vertex
+ *
+ * @returns The score, -1 for vertices without triangles left
+ */
+static float scoreVertex(int cachePosition, unsigned int remaining) {
+    static float cacheScores[OPTIMIZER_CACHE_SIZE];
+    static float valenceScores[MAX_SCORED_VALENCE + 1];
+    static bool tablesBuilt = [] {
+        for (unsigned int i = 0; i < OPTIMIZER_CACHE_SIZE; i++) {
+            cacheScores[i] = i < 3 ? 0.75f : std::pow(1.0f - (float)(i - 3) / (OPTIMIZER_CACHE_SIZE - 3), 1.5f);
+        }
+        valenceScores[0] = 0.0f;
+        for (unsigned int i = 1; i <= MAX_SCORED_VALENCE; i++) {
+            valenceScores[i] = 2.0f / std::sqrt((float)i);
+        }
+        return true;
+    }();
+    (void)tablesBuilt;
+
+    if (remaining == 0) {
+        return -1.0f;
+    }
+    float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+    score += remaining <= MAX_SCORED_VALENCE ? valenceScores[remaining] : 2.0f / std::sqrt((float)remaining);
+    return score;
+}
+
+/**
+ * Simulates a FIFO vertex cache over indices and counts the misses of
+ * every triangle.
+ *
+ * @param indices The indices of the triangles
+ * @param vertexCount The number of vertices the indices refer to
+ * @param cacheSize The number of vertices in the cache
+ * @param misses_out Output for the misses of each triangle, may be nullptr
+ *
+ * @returns The total number of misses
+ */
+static size_t simulateFIFO(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize,
+    std::vector<uint8_t>* misses_out) {
+    // A vertex is in the cache while fewer than cacheSize misses have
+    // happened since its own miss
+    std::vector<size_t> timestamps(vertexCount, 0);
+    size_t timestamp = cacheSize + 1;
+    size_t misses = 0;
+    if (misses_out) {
+        misses_out->assign(indices.size() / 3, 0);
+    }
+    for (size_t i = 0; i < indices.size(); i++) {
+        unsigned int vertex = indices[i];
+        if (timestamp - timestamps[vertex] > cacheSize) {
+            timestamps[vertex] = timestamp++;
+            misses++;
+            if (misses_out) {
+                (*misses_out)[i / 3]++;
+            }
+        }
+    }
+    return misses;
+}
+
+/**
+ * Runs all optimization stages on a mesh, vertex cache order first, then
+ * overdraw order of the clusters, then vertex fetch order. Meshes that
+ * aren't made of whole triangles are left as they are.
+ *
+ * @param vertices The vertices of the mesh, reordered in place
+ * @param indices The triangle indices of the mesh, reordered in place
+ *
+ * @returns The ACMR, ATVR and vertex count before and after
+ */
+MeshOptimizationStats MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    MeshOptimizationStats stats;
+    stats.verticesBefore = vertices.size();
+    AnalyzeVertexCache(indices, vertices.size(), stats.acmrBefore, stats.atvrBefore);
+    if (indices.size() >= 3 && indices.size() % 3 == 0) {
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeOverdraw(indices, vertices);
+        OptimizeVertexFetch(vertices, indices);
+    }
+    AnalyzeVertexCache(indices, vertices.size(), stats.acmrAfter, stats.atvrAfter);
+    stats.verticesAfter = vertices.size();
+    return stats;
+}
+
+/**
+ * Reorders triangles for the post-transform vertex cache with Tom
+ * Forsyth's algorithm. Every step emits the triangle with the highest
+ * score among the triangles of the vertices in a simulated LRU cache,
+ * then updates the scores of the vertices that moved in the cache and of
+ * their triangles. When no triangle in the cache is left, the next
+ * triangle that hasn't been emitted in index order starts a new strip,
+ * which keeps the whole pass linear in the number of triangles.
+ *
+ * @param indices The triangle indices, reordered in place
+ * @param vertexCount The number of vertices the indices refer to
+ *
+ * @returns void
+ */
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles of each vertex, the first remaining[v] are not emitted yet
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices) {
+        remaining[index]++;
+    }
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < vertexCount; i++) {
+        offsets[i + 1] = offsets[i] + remaining[i];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        vertexScores[i] = scoreVertex(-1, remaining[i]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t best = 0;
+    for (size_t i = 0; i < triangleCount; i++) {
+        triangleScores[i] = vertexScores[indices[3 * i]] + vertexScores[indices[3 * i + 1]] + vertexScores[indices[3 * i + 2]];
+        if (triangleScores[i] > triangleScores[best]) {
+            best = i;
+        }
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+    newCache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+    size_t cursor = 0;
+    for (size_t n = 0; n < triangleCount; n++) {
+        // Emit the best triangle and remove it from its vertices
+        const unsigned int* triangle = &indices[3 * best];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+        for (int k = 0; k < 3; k++) {
+            unsigned int vertex = triangle[k];
+            unsigned int* begin = &adjacency[offsets[vertex]];
+            unsigned int* end = begin + remaining[vertex];
+            unsigned int* found = std::find(begin, end, (unsigned int)best);
+            std::swap(*found, *(end - 1));
+            remaining[vertex]--;
+        }
+
+        // The vertices of the triangle move to the front of the cache
+        newCache.assign(triangle, triangle + 3);
+        for (unsigned int vertex : cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                newCache.push_back(vertex);
+            }
+        }
+        for (size_t i = OPTIMIZER_CACHE_SIZE; i < newCache.size(); i++) {
+            vertexScores[newCache[i]] = scoreVertex(-1, remaining[newCache[i]]);
+        }
+        if (newCache.size() > OPTIMIZER_CACHE_SIZE) {
+            newCache.resize(OPTIMIZER_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+
+        // Rescore the cached vertices and find the best of their triangles
+        for (size_t i = 0; i < cache.size(); i++) {
+            vertexScores[cache[i]] = scoreVertex(i, remaining[cache[i]]);
+        }
+        float bestScore = -1.0f;
+        for (unsigned int vertex : cache) {
+            for (size_t i = offsets[vertex]; i < offsets[vertex] + remaining[vertex]; i++) {
+                unsigned int t = adjacency[i];
+                triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] +
+                    vertexScores[indices[3 * t + 2]];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (bestScore < 0.0f) {
+            while (cursor < triangleCount && emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+    }
+    indices.swap(output);
+}
+
+/**
+ * Reorders the triangles of a vertex cache ordered mesh to reduce
+ * overdraw, after Sander et al. The triangles are split into clusters
+ * where the cache starts over, and further where the ACMR so far is
+ * within OVERDRAW_THRESHOLD of the ACMR of the whole cluster, so the
+ * clusters can be moved without losing much of the cache order. The
+ * clusters are then sorted by how much they face away from the center
+ * of the mesh, so the outer surfaces are drawn first and hide what is
+ * behind them from most directions.
+ *
+ * @param indices The vertex cache ordered triangle indices, reordered in place
+ * @param vertices The vertices the indices refer to
+ *
+ * @returns void
+ */
+void MeshOptimizer::OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+    std::vector<uint8_t> misses;
+    simulateFIFO(indices, vertices.size(), ANALYSIS_CACHE_SIZE, &misses);
+
+    // Hard boundaries where all vertices of a triangle miss, soft ones
+    // where a cut costs little
+    std::vector<TriangleCluster> clusters;
+    std::vector<size_t> timestamps(vertices.size(), 0);
+    size_t timestamp = ANALYSIS_CACHE_SIZE + 1;
+    size_t start = 0;
+    while (start < triangleCount) {
+        size_t end = start + 1;
+        size_t hardMisses = misses[start];
+        while (end < triangleCount && misses[end] < 3) {
+            hardMisses += misses[end];
+            end++;
+        }
+        float hardACMR = (float)hardMisses / (end - start);
+
+        // Soft clusters are measured with a cache that starts empty, as
+        // it may once the clusters are reordered
+        size_t clusterStart = start;
+        size_t clusterMisses = 0;
+        timestamp += ANALYSIS_CACHE_SIZE + 1;
+        for (size_t i = start; i < end; i++) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int vertex = indices[3 * i + k];
+                if (timestamp - timestamps[vertex] > ANALYSIS_CACHE_SIZE) {
+                    timestamps[vertex] = timestamp++;
+                    clusterMisses++;
+                }
+            }
+            size_t count = i + 1 - clusterStart;
+            if (i + 1 < end && (float)clusterMisses / count <= hardACMR * OVERDRAW_THRESHOLD) {
+                clusters.push_back({clusterStart, count, 0.0f});
+                clusterStart = i + 1;
+                clusterMisses = 0;
+                timestamp += ANALYSIS_CACHE_SIZE + 1;
+            }
+        }
+        clusters.push_back({clusterStart, end - clusterStart, 0.0f});
+        start = end;
+    }
+    if (clusters.size() < 2) {
+        return;
+    }
+
+    // Area weighted center of the mesh
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const glm::vec3& a = vertices[indices[3 * t]].Position;
+        const glm::vec3& b = vertices[indices[3 * t + 1]].Position;
+        const glm::vec3& c = vertices[indices[3 * t + 2]].Position;
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCenter += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    if (meshArea > 0.0f) {
+        meshCenter /= meshArea;
+    }
+
+    for (auto& cluster : clusters) {
+        glm::vec3 center(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++) {
+            const glm::vec3& a = vertices[indices[3 * t]].Position;
+            const glm::vec3& b = vertices[indices[3 * t + 1]].Position;
+            const glm::vec3& c = vertices[indices[3 * t + 2]].Position;
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            float triangleArea = glm::length(cross);
+            center += (a + b + c) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f) {
+            cluster.sortKey = glm::dot(center / area - meshCenter, normal / normalLength);
+        }
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (const auto& cluster : clusters) {
+        output.insert(output.end(), indices.begin() + 3 * cluster.firstTriangle,
+            indices.begin() + 3 * (cluster.firstTriangle + cluster.triangleCount));
+    }
+    indices.swap(output);
+}
+
+/**
+ * Reorders vertices in the order the indices first refer to them, so
+ * that the vertex fetches of consecutive triangles are close in memory.
+ * Vertices that no index refers to are dropped.
+ *
+ * @param vertices The vertices, reordered in place
+ * @param indices The indices, remapped to the new vertex order
+ *
+ * @returns void
+ */
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::vector<unsigned int> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex> output;
+    output.reserve(vertices.size());
+    for (auto& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = output.size();
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(output);
+}
+
+/**
+ * Merges vertices with the same attributes into one and remaps the
+ * indices to the vertices that are left, which keep the order they are
+ * first found in. In exact mode vertices are merged if all their
+ * attributes are bitwise equal. In epsilon mode every attribute is
+ * rounded to a multiple of the epsilon and vertices that round to the
+ * same values are merged, so vertices closer than the epsilon may still
+ * be kept apart when they round to different sides. The first vertex of
+ * each group is kept as it is.
+ *
+ * @param vertices The vertices, compacted in place
+ * @param indices The indices, remapped in place
+ * @param mode How vertices are compared, WELD_NONE leaves the mesh as it is
+ * @param epsilon The size of the grid attributes are rounded to in epsilon mode
+ *
+ * @returns The number of vertices left
+ */
+size_t MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    WeldMode mode, float epsilon) {
+    if (mode == WELD_NONE || vertices.empty()) {
+        return vertices.size();
+    }
+
+    std::unordered_map<WeldKey, unsigned int, WeldKeyHash> welded;
+    welded.reserve(vertices.size());
+    std::vector<unsigned int> remap(vertices.size());
+    size_t count = 0;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        WeldKey key;
+        if (mode == WELD_EPSILON) {
+            float attributes[sizeof(Vertex) / sizeof(float)];
+            memcpy(attributes, &vertices[i], sizeof(Vertex));
+            for (size_t j = 0; j < key.size(); j++) {
+                key[j] = getWeldCell(attributes[j], epsilon);
+            }
+        } else {
+            uint32_t bits[sizeof(Vertex) / sizeof(float)];
+            memcpy(bits, &vertices[i], sizeof(Vertex));
+            std::copy(std::begin(bits), std::end(bits), key.begin());
+        }
+        auto inserted = welded.emplace(key, (unsigned int)count);
+        if (inserted.second) {
+            vertices[count++] = vertices[i];
+        }
+        remap[i] = inserted.first->second;
+    }
+    vertices.resize(count);
+    for (auto& index : indices) {
+        index = remap[index];
+    }
+    return count;
+}
+
+/**
+ * Splits a mesh into parts of consecutive triangles that each use at
+ * most maxVertices vertices, so that each part can be drawn with smaller
+ * indices. A part ends at the first triangle that would bring in too
+ * many vertices. Vertices are numbered in the order the triangles of the
+ * part first use them, which keeps the vertex fetch order of optimized
+ * meshes, and vertices shared across parts are copied into each.
+ *
+ * @param vertices The vertices of the mesh
+ * @param indices The triangle indices of the mesh
+ * @param maxVertices The most vertices a part may use, at least 3
+ *
+ * @returns The parts in the order of their triangles
+ */
+std::vector<MeshPart> MeshOptimizer::SplitMesh(const std::vector<Vertex>& vertices,
+    const std::vector<unsigned int>& indices, size_t maxVertices) {
+    std::vector<MeshPart> parts;
+    std::vector<unsigned int> remap(vertices.size(), UINT32_MAX);
+    std::vector<unsigned int> used;
+    for (size_t triangle = 0; triangle + 2 < indices.size(); triangle += 3) {
+        size_t added = 0;
+        for (size_t i = 0; i < 3; i++) {
+            const unsigned int* corner = &indices[triangle + i];
+            if (remap[*corner] == UINT32_MAX && std::find(&indices[triangle], corner, *corner) == corner) {
+                added++;
+            }
+        }
+        if (parts.empty() || parts.back().vertices.size() + added > maxVertices) {
+            // Start a new part, forgetting the vertices of the previous one
+            for (unsigned int vertex : used) {
+                remap[vertex] = UINT32_MAX;
+            }
+            used.clear();
+            parts.emplace_back();
+        }
+
+        MeshPart& part = parts.back();
+        for (size_t i = 0; i < 3; i++) {
+            unsigned int index = indices[triangle + i];
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = part.vertices.size();
+                part.vertices.push_back(vertices[index]);
+                used.push_back(index);
+            }
+            part.indices.push_back(remap[index]);
+        }
+    }
+    return parts;
+}
+
+/**
+ * Measures how well indices use a FIFO post-transform cache of
+ * ANALYSIS_CACHE_SIZE vertices.
+ *
+ * @param indices The triangle indices
+ * @param vertexCount The number of vertices the indices refer to
+ * @param acmr_out Output for the average cache miss ratio, misses per triangle
+ * @param atvr_out Output for the average transformed vertex ratio, misses per used vertex
+ *
+ * @returns void
+ */
+void MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+    float& acmr_out, float& atvr_out) {
+    acmr_out = 0.0f;
+    atvr_out = 0.0f;
+    if (indices.size() < 3) {
+        return;
+    }
+    size_t misses = simulateFIFO(indices, vertexCount, ANALYSIS_CACHE_SIZE, nullptr);
+    std::vector<bool> used(vertexCount, false);
+    size_t usedCount = 0;
+    for (unsigned int index : indices) {
+        if (!used[index]) {
+            used[index] = true;
+            usedCount++;
+        }
+    }
+    acmr_out = (float)misses / (indices.size() / 3);
+    atvr_out = (float)misses / usedCount;
+}
+
+/**
+ * Enables or disables optimizing the meshes of models imported through
+ * Assimp. Cooked files remember if their meshes were optimized, so
+ * changing this makes models be imported and cooked again.
+ *
+ * @param enabled true to optimize imported meshes, false to keep the order of the file
+ *
+ * @returns void
+ */
+void MeshOptimizer::SetEnabled(bool enabled) {
+    optimizerEnabled = enabled;
+}
+
+/**
+ * Checks if imported meshes are optimized.
+ *
+ * @returns true if meshes are optimized, false otherwise
+ */
+bool MeshOptimizer::IsEnabled() {
+    return optimizerEnabled;
+}
+
+/**
+ * Sets how the vertices of meshes imported through Assimp are welded.
+ * Cooked files remember the mode they were welded with, so changing it
+ * makes models be imported and cooked again.
+ *
+ * @param mode How vertices are compared, WELD_NONE to keep every vertex of the file
+ * @param epsilon The size of the grid attributes are rounded to in epsilon mode
+ *
+ * @returns void
+ */
+void MeshOptimizer::SetWeldMode(WeldMode mode, float epsilon) {
+    weldMode = mode;
+    weldEpsilon = epsilon;
+}
+
+/**
+ * Gets how the vertices of imported meshes are welded.
+ *
+ * @returns The weld mode
+ */
+WeldMode MeshOptimizer::GetWeldMode() {
+    return weldMode;
+}
+
+/**
+ * Gets the epsilon vertices are welded with in epsilon mode.
+ *
+ * @returns The epsilon
+ */
+float MeshOptimizer::GetWeldEpsilon() {
+    return weldEpsilon;
+}
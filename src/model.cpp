@@ -1,7 +1,31 @@
 #include <model.h>
+#include <triangle_bvh.h>
+#include <model_cache.h>
+#include <material_table.h>
+#include <texture_streamer.h>
+#include <thread_pool.h>
 
-Model::Model(std::string const& path) {
-    loadModel(path);
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <future>
+
+/**
+ * Gets the pool that processes the meshes of all models, such as
+ * building their triangle BVHs. Models loading on the pools of model
+ * loaders wait for their meshes here, so the number of threads stays
+ * fixed however many models load at once. Its tasks never wait on
+ * other tasks, so a full pool only delays them.
+ *
+ * @returns The mesh processing pool
+ */
+static ThreadPool& getMeshPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+Model::Model(std::string const& path, bool buildBVH) {
+    loadModel(path, buildBVH);
 }
 
 /**
@@ -11,7 +35,8 @@ Model::Model(std::string const& path) {
  * 
  * @returns void
  */
-void Model::Draw(Shader& shader) {
+void Model::Draw(const Shader& shader) {
+    MaterialTable::Bind();
     for (unsigned int i = 0; i < meshes.size(); i++) {
         meshes[i].Draw(shader);
     }
@@ -36,24 +61,555 @@ glm::vec3 Model::GetMinCoords() {
 }
 
 /**
- * Loads a model into the assimp tree structure. Then create mesh objects
- * from the tree structure.
+ * Gets the meshes that make up the model.
+ * 
+ * @returns The meshes of the model
+ */
+const std::vector<Mesh>& Model::GetMeshes() const {
+    return meshes;
+}
+std::vector<Mesh>& Model::GetMeshes() {
+    return meshes;
+}
+
+/**
+ * Builds the triangle BVHs of all meshes that don't have one yet, the
+ * meshes are built in parallel on the mesh pool. Meshes freed their CPU copies after
+ * upload unless Mesh::SetKeepCPUData(true) was set when the model was
+ * loaded, those meshes get no BVH and a warning is printed.
+ * 
+ * @returns true if all meshes have a BVH, false otherwise
+ */
+bool Model::BuildBVH() {
+    std::vector<std::future<bool>> builds;
+    for (auto& mesh : meshes) {
+        if (mesh.GetBVH() == nullptr) {
+            builds.push_back(getMeshPool().Submit([&mesh]() { return mesh.BuildBVH(); }));
+        }
+    }
+    size_t missing = 0;
+    for (auto& build : builds) {
+        if (!build.get()) {
+            missing++;
+        }
+    }
+    if (missing > 0) {
+        std::cout << "Model::BuildBVH: " << missing << " meshes keep no CPU data, load the model with "
+            << "BVHs or with Mesh::SetKeepCPUData(true)" << std::endl;
+    }
+    return missing == 0;
+}
+
+/**
+ * Checks if all meshes of the model have a triangle BVH.
+ * 
+ * @returns true if all meshes have a BVH, false otherwise
+ */
+bool Model::HasBVH() const {
+    for (const auto& mesh : meshes) {
+        if (mesh.GetBVH() == nullptr) {
+            return false;
+        }
+    }
+    return !meshes.empty();
+}
+
+/**
+ * Finds the nearest triangle of the model hit by a ray. Meshes with a
+ * triangle BVH are traversed through it, the triangles of other meshes
+ * are tested one by one if they kept CPU copies of their data, meshes
+ * with neither are never hit. The ray is in model space and distances are in
+ * units of rayDir, so a ray transformed from world space with the
+ * inverse model matrix gives world space distances.
+ *
+ * @param rayOrigin The origin of the ray in model space
+ * @param rayDir The direction of the ray in model space
+ * @param hit_out Output for the nearest hit, undefined if there's no hit
+ * 
+ * @returns true if a triangle was hit, false otherwise
+ */
+bool Model::Raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDir, RaycastHit& hit_out) const {
+    glm::vec3 invDir = 1.0f / rayDir;
+    float nearestDistance = FLT_MAX;
+    bool hit = false;
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        const Mesh& mesh = meshes[i];
+        if (IntersectRayAABB(rayOrigin, invDir, mesh.GetMinCoords(), mesh.GetMaxCoords(), nearestDistance) < 0.0f) {
+            continue;
+        }
+
+        unsigned int triangle;
+        glm::vec2 barycentrics;
+        float distance;
+        if (mesh.GetBVH() != nullptr) {
+            if (!mesh.GetBVH()->Intersect(rayOrigin, rayDir, nearestDistance, triangle, barycentrics, distance)) {
+                continue;
+            }
+        } else {
+            bool meshHit = false;
+            distance = nearestDistance;
+            for (unsigned int j = 0; j + 2 < mesh.indices.size(); j += 3) {
+                float triangleDistance;
+                glm::vec2 triangleBarycentrics;
+                if (IntersectRayTriangle(rayOrigin, rayDir,
+                        mesh.vertices[mesh.indices[j]].Position,
+                        mesh.vertices[mesh.indices[j + 1]].Position,
+                        mesh.vertices[mesh.indices[j + 2]].Position,
+                        triangleDistance, triangleBarycentrics) && triangleDistance < distance) {
+                    distance = triangleDistance;
+                    triangle = j / 3;
+                    barycentrics = triangleBarycentrics;
+                    meshHit = true;
+                }
+            }
+            if (!meshHit) {
+                continue;
+            }
+        }
+
+        nearestDistance = distance;
+        hit_out.mesh = i;
+        hit_out.triangle = triangle;
+        hit_out.barycentrics = barycentrics;
+        hit_out.distance = distance;
+        hit = true;
+    }
+    return hit;
+}
+
+/**
+ * Checks if the model has been loaded and uploaded. Models loaded with
+ * a ModelLoader are not ready until the loader has finished them, and
+ * must not be drawn before then.
+ * 
+ * @returns true if the model can be drawn, false otherwise
+ */
+bool Model::IsReady() const {
+    return ready;
+}
+
+/**
+ * Gets the time it took to decode and upload each texture of the model,
+ * in the order the textures were uploaded. Textures that were already
+ * uploaded by another model are shared and not included.
+ * 
+ * @returns The texture timings
+ */
+const std::vector<TextureTiming>& Model::GetTextureTimings() const {
+    return textureTimings;
+}
+
+/**
+ * Gets the counters of packing the textures of the model into texture
+ * arrays and atlases.
+ * 
+ * @returns The packing counters, all 0 if the textures weren't packed
+ */
+const TexturePackingStats& Model::GetTexturePackingStats() const {
+    return packingStats;
+}
+
+/**
+ * Gets the ACMR and ATVR of each mesh of the model before and after it
+ * was optimized, in the order of the meshes. Meshes loaded from a cooked
+ * file report the stats of when they were cooked.
+ * 
+ * @returns The optimization stats, all 0 for meshes that weren't optimized
+ */
+const std::vector<MeshOptimizationStats>& Model::GetMeshOptimizationStats() const {
+    return meshOptimization;
+}
+
+/**
+ * Gets the memory the indices of the uploaded meshes take in their index
+ * types, and what they would take as 32-bit indices.
+ * 
+ * @returns The index memory counters, all 0 before the model is ready
+ */
+IndexMemoryStats Model::GetIndexMemoryStats() const {
+    IndexMemoryStats stats;
+    for (const auto& mesh : meshes) {
+        stats.Add(mesh.GetIndexCount(), mesh.GetIndexType());
+    }
+    return stats;
+}
+
+/**
+ * Reads the textures the materials of a model refer to, the same
+ * textures a loaded model would use, without loading them or the
+ * meshes. Makes no GL calls.
+ *
+ * @param path The path to the object file
+ * 
+ * @returns The textures with paths relative to the model directory and no IDs
+ */
+std::vector<Texture> Model::GetMaterialTextures(const std::string& path) {
+    Model model;
+    model.directory = path.substr(0, path.find_last_of('/'));
+    model.acquireTextures = false;
+
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, 0);
+    if (!scene || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return {};
+    }
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        model.processMaterial(scene->mMaterials[scene->mMeshes[i]->mMaterialIndex]);
+    }
+    return model.loaded_textures;
+}
+
+/**
+ * Loads a model from a file and uploads it right away.
  *
  * @param path The path to the object file.
+ * @param buildBVH true to build triangle BVHs for the meshes
  * 
  * @returns void
  */
-void Model::loadModel(std::string path) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+void Model::loadModel(std::string path, bool buildBVH) {
+    importModel(path, buildBVH);
+    finishLoading(std::chrono::steady_clock::time_point::max());
+}
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+/**
+ * Converts a model into pending meshes, decoding the textures of their
+ * materials. An up to date cooked file of the model is memory-mapped and
+ * used in place, otherwise the model is loaded into the assimp tree
+ * structure and converted, its meshes are optimized for the vertex cache
+ * and overdraw and split to fit 16-bit indices, and the result is cooked
+ * for the next load, so repeat loads don't pay for the optimization.
+ * Makes no GL calls, so it can run on any thread.
+ *
+ * @param path The path to the object file.
+ * @param buildBVH true to build triangle BVHs for the meshes
+ * 
+ * @returns void
+ */
+void Model::importModel(std::string path, bool buildBVH) {
+    directory = path.substr(0, path.find_last_of('/'));
+    if (!importCookedModel(path, buildBVH || Mesh::IsKeepingCPUData())) {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+            return;
+        }
+
+        processNode(scene->mRootNode, scene);
+        if (MeshOptimizer::IsEnabled()) {
+            optimizePendingMeshes();
+        }
+        splitPendingMeshes();
+        for (auto& pending : pendingMeshes) {
+            pending.vertexData = pending.vertices.data();
+            pending.vertexCount = pending.vertices.size();
+            pending.indexData = pending.indices.data();
+            pending.indexCount = pending.indices.size();
+        }
+        if (ModelCache::IsEnabled()) {
+            ModelCache::Write(path, pendingMeshes, loaded_textures, aabb_min, aabb_max);
+        }
+    }
+
+    if (buildBVH) {
+        buildPendingBVHs();
+    }
+}
+
+/**
+ * Reads the meshes and texture references of a model from its cooked
+ * file. The file stays mapped and the pending meshes point into it, so
+ * the vertex data is neither parsed nor copied before it is uploaded.
+ * Indices were checked when the file was written. They are checked
+ * again only when they will be used to read vertices on the CPU, for
+ * triangle BVHs or kept CPU copies.
+ *
+ * @param path The path to the object file.
+ * @param validateIndices true to check the indices of all meshes
+ * 
+ * @returns true if the model was read from an up to date cooked file, false otherwise
+ */
+bool Model::importCookedModel(const std::string& path, bool validateIndices) {
+    std::shared_ptr<ModelCache> cache = std::make_shared<ModelCache>();
+    if (!cache->Open(path)) {
+        return false;
+    }
+    for (unsigned int i = 0; validateIndices && i < cache->GetMeshCount(); i++) {
+        if (!cache->ValidateIndices(i)) {
+            std::cout << "ERROR::MODEL_CACHE::CORRUPT_FILE " << ModelCache::GetCachePath(path) << std::endl;
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < cache->GetTextureCount(); i++) {
+        Texture texture;
+        texture.id = 0;
+        cache->GetTexture(i, texture.type, texture.path);
+        loaded_textures.push_back(texture);
+        acquireTexture(texture.path);
+    }
+
+    for (unsigned int i = 0; i < cache->GetMeshCount(); i++) {
+        const ModelCacheMesh& mesh = cache->GetMesh(i);
+        PendingMesh pending;
+        pending.vertexData = cache->GetVertices(i);
+        pending.vertexCount = mesh.vertexCount;
+        pending.indexData = cache->GetIndices(i);
+        pending.indexCount = mesh.indexCount;
+        pending.textures.assign(cache->GetTextureIndices(i), cache->GetTextureIndices(i) + mesh.textureCount);
+        pending.aabbMin = glm::vec3(mesh.aabbMin[0], mesh.aabbMin[1], mesh.aabbMin[2]);
+        pending.aabbMax = glm::vec3(mesh.aabbMax[0], mesh.aabbMax[1], mesh.aabbMax[2]);
+        pending.optimization = mesh.optimization;
+        pendingMeshes.push_back(std::move(pending));
+    }
+    aabb_min = cache->GetMinCoords();
+    aabb_max = cache->GetMaxCoords();
+    cookedModel = cache;
+    return true;
+}
+
+/**
+ * Reorders the triangles and vertices of all pending meshes converted
+ * from Assimp with the MeshOptimizer, the meshes in parallel on the
+ * mesh pool.
+ * 
+ * @returns void
+ */
+void Model::optimizePendingMeshes() {
+    std::vector<std::future<void>> optimizations;
+    for (auto& pending : pendingMeshes) {
+        optimizations.push_back(getMeshPool().Submit([&pending]() {
+            unsigned int importedVertices = pending.optimization.verticesBefore;
+            pending.optimization = MeshOptimizer::Optimize(pending.vertices, pending.indices);
+            pending.optimization.verticesBefore = importedVertices;
+        }));
+    }
+    for (auto& optimization : optimizations) {
+        optimization.get();
+    }
+}
+
+/**
+ * Splits the pending meshes converted from Assimp that have more than
+ * MAX_SPLIT_VERTICES vertices into parts that can be drawn with 16-bit
+ * indices. The parts keep the textures and optimization stats of the
+ * mesh they were split from and take its place in the mesh order.
+ * Nothing is split while all indices are kept 32-bit, since the parts
+ * would only add draw calls and vertices duplicated along the seams.
+ * 
+ * @returns void
+ */
+void Model::splitPendingMeshes() {
+    if (Mesh::GetSmallestIndexType() == GL_UNSIGNED_INT) {
         return;
     }
-    directory = path.substr(0, path.find_last_of('/'));
+    std::vector<PendingMesh> split;
+    split.reserve(pendingMeshes.size());
+    for (auto& pending : pendingMeshes) {
+        if (pending.vertices.size() <= MAX_SPLIT_VERTICES) {
+            split.push_back(std::move(pending));
+            continue;
+        }
+        for (MeshPart& part : MeshOptimizer::SplitMesh(pending.vertices, pending.indices)) {
+            PendingMesh partMesh;
+            partMesh.vertices = std::move(part.vertices);
+            partMesh.indices = std::move(part.indices);
+            partMesh.textures = pending.textures;
+            partMesh.optimization = pending.optimization;
+            split.push_back(std::move(partMesh));
+        }
+    }
+    pendingMeshes.swap(split);
+}
+
+/**
+ * Builds triangle BVHs for all pending meshes in parallel on the mesh
+ * pool.
+ * 
+ * @returns void
+ */
+void Model::buildPendingBVHs() {
+    std::vector<std::future<void>> builds;
+    for (auto& pending : pendingMeshes) {
+        builds.push_back(getMeshPool().Submit([&pending]() {
+            std::shared_ptr<TriangleBVH> triangleBVH = std::make_shared<TriangleBVH>();
+            triangleBVH->Build(pending.vertexData, pending.indexData, pending.indexCount);
+            pending.bvh = triangleBVH;
+        }));
+    }
+    for (auto& build : builds) {
+        build.get();
+    }
+}
+
+/**
+ * Uploads the decoded textures and creates the meshes of an imported
+ * model, one texture or mesh at a time until the deadline has passed.
+ * Textures are uploaded in order as their decoding finishes, textures
+ * already uploaded by another model are shared. With a deadline,
+ * loading stops instead of waiting for a texture that is still being
+ * decoded or for room in the upload ring, otherwise at least one
+ * texture or mesh is finished per call. Meshes are uploaded in the
+ * vertex layout and streams set on VertexFormat, and the imported
+ * vertices and indices are moved into them. Must be called on the render
+ * thread.
+ *
+ * @param deadline The time after which no more work is started, the
+ *                 max time point to finish the model in one call
+ * @param ring The ring to stage texture uploads through, nullptr to
+ *             upload straight from the decoded pixels
+ * 
+ * @returns true if the model is ready, false if there is work left
+ */
+bool Model::finishLoading(std::chrono::steady_clock::time_point deadline, UploadRing* ring) {
+    bool blocking = deadline == std::chrono::steady_clock::time_point::max();
+    while (uploadedImages < cachedTextures.size()) {
+        CachedTexture& texture = *cachedTextures[uploadedImages];
+        if (!texture.uploaded) {
+            if (!texture.decoded) {
+                if (!blocking && texture.decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    return false;
+                }
+                texture.image = texture.decoding.get();
+                texture.decoded = true;
+            }
+            TextureTiming timing;
+            timing.path = loaded_textures[uploadedImages].path;
+            if (!uploadTexture(texture.image, ring, texture.id, timing)) {
+                return false;
+            }
+            texture.uploaded = true;
+            textureTimings.push_back(timing);
+        }
+        loaded_textures[uploadedImages].id = texture.id;
+        uploadedImages++;
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+    }
+
+    if (!texturesPacked) {
+        if (TexturePacker::IsEnabled() && MaterialTable::GetMode() == MATERIAL_MODE_BINDINGS) {
+            packTextures();
+        }
+        texturesPacked = true;
+    }
+
+    VertexLayout layout = VertexFormat::GetLayout();
+    bool positionStream = VertexFormat::IsPositionStreamEnabled();
+    meshes.reserve(pendingMeshes.size());
+    while (meshes.size() < pendingMeshes.size()) {
+        PendingMesh& pending = pendingMeshes[meshes.size()];
+        std::vector<Texture> textures = pending.packedTextures;
+        if (textures.empty()) {
+            for (unsigned int texture : pending.textures) {
+                textures.push_back(loaded_textures[texture]);
+            }
+        }
+        if (pending.vertices.empty()) {
+            meshes.emplace_back(pending.vertexData, pending.vertexCount, pending.indexData, pending.indexCount,
+                std::move(textures), pending.aabbMin, pending.aabbMax, layout, positionStream);
+        } else {
+            meshes.emplace_back(std::move(pending.vertices), std::move(pending.indices), std::move(textures),
+                layout, positionStream);
+        }
+        if (pending.bvh) {
+            meshes.back().SetBVH(pending.bvh);
+        }
+        meshOptimization.push_back(pending.optimization);
+        pending = PendingMesh();
+        if (meshes.size() < pendingMeshes.size() && std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+    }
+
+    pendingMeshes.clear();
+    textureIndices.clear();
+    uploadedImages = 0;
+    cookedModel.reset();
+    ready = true;
+    return true;
+}
+
+/**
+ * Packs the uploaded textures of the model for the pending meshes. Every
+ * distinct set of textures is a material, which may go into an atlas if
+ * the texture coordinates of all its meshes are within [0, 1]. Meshes of
+ * a material packed into an atlas get their texture coordinates remapped
+ * to its rectangle, meshes of a cooked model get a copy of their data for
+ * this. Loaded textures no mesh uses anymore are released, their GL
+ * textures are deleted unless another model shares them. Packing is
+ * skipped while the material table is enabled, it has arrays of its own.
+ * 
+ * @returns void
+ */
+void Model::packTextures() {
+    std::vector<PackedMaterial> materials;
+    std::map<std::vector<unsigned int>, size_t> materialIndices;
+    std::vector<size_t> meshMaterials;
+    for (const auto& pending : pendingMeshes) {
+        auto found = materialIndices.find(pending.textures);
+        if (found == materialIndices.end()) {
+            PackedMaterial material;
+            for (unsigned int texture : pending.textures) {
+                material.textures.push_back(loaded_textures[texture]);
+            }
+            material.unitTexCoords = true;
+            found = materialIndices.emplace(pending.textures, materials.size()).first;
+            materials.push_back(material);
+        }
+        meshMaterials.push_back(found->second);
+
+        PackedMaterial& material = materials[found->second];
+        for (size_t i = 0; i < pending.vertexCount && material.unitTexCoords; i++) {
+            glm::vec2 uv = pending.vertexData[i].TexCoords;
+            material.unitTexCoords = uv.x >= -ATLAS_TEXCOORD_TOLERANCE && uv.x <= 1.0f + ATLAS_TEXCOORD_TOLERANCE &&
+                uv.y >= -ATLAS_TEXCOORD_TOLERANCE && uv.y <= 1.0f + ATLAS_TEXCOORD_TOLERANCE;
+        }
+    }
+
+    for (GLuint texture : TexturePacker::Pack(materials, packingStats)) {
+        packedTextures.push_back(TextureCache::Adopt(texture));
+    }
+
+    for (size_t i = 0; i < pendingMeshes.size(); i++) {
+        PendingMesh& pending = pendingMeshes[i];
+        const PackedMaterial& material = materials[meshMaterials[i]];
+        pending.packedTextures = material.textures;
+        if (material.uvTransform == glm::vec4(1.0f, 1.0f, 0.0f, 0.0f)) {
+            continue;
+        }
+        if (pending.vertices.empty()) {
+            pending.vertices.assign(pending.vertexData, pending.vertexData + pending.vertexCount);
+            pending.indices.assign(pending.indexData, pending.indexData + pending.indexCount);
+        }
+        for (auto& vertex : pending.vertices) {
+            vertex.TexCoords = vertex.TexCoords * glm::vec2(material.uvTransform) +
+                glm::vec2(material.uvTransform.z, material.uvTransform.w);
+        }
+        pending.vertexData = pending.vertices.data();
+        pending.indexData = pending.indices.data();
+    }
 
-    processNode(scene->mRootNode, scene);
+    std::vector<bool> used(loaded_textures.size(), false);
+    for (const auto& material : materials) {
+        for (const auto& texture : material.textures) {
+            for (size_t i = 0; i < loaded_textures.size(); i++) {
+                if (texture.layer < 0 && loaded_textures[i].id == texture.id) {
+                    used[i] = true;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < cachedTextures.size(); i++) {
+        if (!used[i] && cachedTextures[i]) {
+            cachedTextures[i].reset();
+            packingStats.texturesReleased++;
+        }
+    }
 }
 
 /**
@@ -67,7 +623,7 @@ void Model::loadModel(std::string path) {
 void Model::processNode(aiNode* node, const aiScene* scene) {
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        pendingMeshes.push_back(processMesh(mesh, scene));
     }
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
         processNode(node->mChildren[i], scene);
@@ -75,172 +631,251 @@ void Model::processNode(aiNode* node, const aiScene* scene) {
 }
 
 /**
- * Create a mesh object from a pointer to a mesh in the assimp tree
- * structure.
+ * Converts a mesh in the assimp tree structure into a pending mesh. The
+ * vertices and indices are written into vectors sized up front, then
+ * identical vertices are welded in the mode set on the MeshOptimizer,
+ * since formats like OBJ store a vertex per face corner.
  *
  * @param mesh A pointer to a mesh in the assimp tree structure to process
  * @param scene A pointer to the scene
  * 
- * @returns void
+ * @returns The pending mesh
  */
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+PendingMesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+    PendingMesh pending;
+    std::vector<Vertex>& vertices = pending.vertices;
+    std::vector<unsigned int>& indices = pending.indices;
 
     /*
     * Vertices
     */
+    vertices.resize(mesh->mNumVertices);
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
-        glm::vec3 vector;
+        Vertex& vertex = vertices[i];
         // Position
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
+        glm::vec3 vector(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
         vertex.Position = vector;
         // Set min and max coordinates
-        if (vector.x < aabb_min.x) {
-            aabb_min.x = vector.x;
-        }
-        if (vector.x > aabb_max.x) {
-            aabb_max.x = vector.x;
-        }
-        if (vector.y < aabb_min.y) {
-            aabb_min.y = vector.y;
-        }
-        if (vector.y > aabb_max.y) {
-            aabb_max.y = vector.y;
-        }
-        if (vector.z < aabb_min.z) {
-            aabb_min.z = vector.z;
-        }
-        if (vector.z > aabb_max.z) {
-            aabb_max.z = vector.z;
-        }
+        aabb_min = glm::min(aabb_min, vector);
+        aabb_max = glm::max(aabb_max, vector);
         // Normals
-        vector.x = mesh->mNormals[i].x;
-        vector.y = mesh->mNormals[i].y;
-        vector.z = mesh->mNormals[i].z;
-        vertex.Normal = vector;
+        vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
         // Texture coords
         if (mesh->mTextureCoords[0]) {
-            glm::vec2 vec;
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
+            vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
         } else {
             // If the model doesn't have texture coordinates, we set 
             // them to (0,0)
             vertex.TexCoords = glm::vec2(0.0f, 0.0f);
         }
-        // Push the vertex to the back of the vertex vector
-        vertices.push_back(vertex);
     }
 
     /*
     * Indices
     */
+    size_t indexCount = 0;
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++) {
-            indices.push_back(face.mIndices[j]);
-        }
+        indexCount += mesh->mFaces[i].mNumIndices;
+    }
+    indices.resize(indexCount);
+    unsigned int* index = indices.data();
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        const aiFace& face = mesh->mFaces[i];
+        memcpy(index, face.mIndices, face.mNumIndices * sizeof(unsigned int));
+        index += face.mNumIndices;
     }
 
+    /*
+    * Welding
+    */
+    pending.optimization.verticesBefore = vertices.size();
+    pending.optimization.verticesAfter = MeshOptimizer::WeldVertices(vertices, indices,
+        MeshOptimizer::GetWeldMode(), MeshOptimizer::GetWeldEpsilon());
+
     /*
     * Material
     */
     if (mesh->mMaterialIndex >= 0) {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // Diffuse
-        std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // Specular
-        std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        pending.textures = processMaterial(scene->mMaterials[mesh->mMaterialIndex]);
     }
-    return Mesh(vertices, indices, textures);
+    return pending;
+}
+
+/**
+ * Gets the textures of a material that the shaders use.
+ *
+ * @param material A pointer to a material from the assimp tree structure
+ * 
+ * @returns The indices of the textures in the loaded textures
+ */
+std::vector<unsigned int> Model::processMaterial(aiMaterial* material) {
+    // Diffuse
+    std::vector<unsigned int> textures = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+    // Specular
+    std::vector<unsigned int> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    return textures;
 }
 
 /**
- * Loads the textures of a material.
+ * Gets the textures of a material from the texture cache. Textures are
+ * decoded once for all models and uploaded later by finishLoading.
  *
  * @param mat A pointer to a material from the assimp tree structure
  * @param type The type of textures to load
  * @param typeName The type to tag the loaded texture with
  * 
- * @returns A vector of loaded textures
+ * @returns The indices of the textures in the loaded textures
  */
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
-    std::vector<Texture> textures;
+std::vector<unsigned int> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
+    std::vector<unsigned int> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
         aiString str;
         mat->GetTexture(type, i, &str);
 
-        // Check if the texture has already been loaded
-        bool skip = false;
-        for (unsigned int j = 0; j < loaded_textures.size(); j++) {
-            if (std::strcmp(loaded_textures[j].path.data(), str.C_Str()) == 0) {
-                textures.push_back(loaded_textures[j]);
-                skip = true;
-                break;
-            }
-        }
-        // Only load the texture if it has not been loaded before
-        if (!skip) {
+        // Only add the texture if the model does not use it already
+        auto loaded = textureIndices.find(str.C_Str());
+        if (loaded != textureIndices.end()) {
+            textures.push_back(loaded->second);
+        } else {
             Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
+            texture.id = 0;
             texture.type = typeName;
             texture.path = str.C_Str();
-            textures.push_back(texture);
+            textureIndices[texture.path] = loaded_textures.size();
+            textures.push_back(loaded_textures.size());
             loaded_textures.push_back(texture);
+            if (acquireTextures) {
+                acquireTexture(texture.path);
+            }
         }
     }
     return textures;
 }
 
 /**
- * Load a texture from a file path.
+ * Adds the shared texture of an image in the model directory to the
+ * model, decoding starts if no other model uses the image.
  *
  * @param path A relative path to the texture to load from the model directory
- * @param directory The path to the model directory
  * 
- * @returns The ID of the loaded texture
+ * @returns void
  */
-unsigned int Model::TextureFromFile(const char *path, const std::string &directory) {
-    std::string filename = std::string(path);
-    filename = directory + '/' + filename;
+void Model::acquireTexture(const std::string &path) {
+    cachedTextures.push_back(TextureCache::Acquire(directory + '/' + path));
+}
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+/**
+ * Uploads a decoded image to a new texture and frees the pixels. The
+ * texture gets immutable storage for its whole mip chain, so the driver
+ * never has to check it for completeness, and no sampling state since
+ * that comes from the sampler bound when drawing. With a ring the pixels
+ * are copied into a staging range and the texture is filled from it as a
+ * pixel unpack buffer, so the driver doesn't have to copy the pixels
+ * before the upload returns. Images too large for the ring are uploaded
+ * straight from the pixels. Compressed images are uploaded with their
+ * stored mip levels, other images get their mips generated. Images
+ * prepared for streaming are handed to the TextureStreamer instead, which
+ * gives them mutable storage from their start level down. Images that
+ * failed to decode get no texture, meshes then bind none in its place.
+ *
+ * @param image The decoded image
+ * @param ring The ring to stage the upload through, may be nullptr
+ * @param id_out Output for the loaded texture, which it owns, empty if the image failed to decode
+ * @param timing_out Output for the size and timings of the texture, its path must be set
+ * 
+ * @returns true if the texture was uploaded or failed to decode, false if the ring has no room right now
+ */
+bool Model::uploadTexture(ImageData& image, UploadRing* ring, GLTexture& id_out, TextureTiming& timing_out) {
+    auto start = std::chrono::steady_clock::now();
+    if (!image.pixels && !image.compressed) {
+        std::cout << "Texture failed to load at path: " << timing_out.path << std::endl;
+        id_out.Reset();
+        timing_out.decodeMilliseconds = image.decodeMilliseconds;
+        return true;
+    }
+    GLsizeiptr size = image.compressed ? (GLsizeiptr)image.compressed->GetDataSize() :
+        (GLsizeiptr)image.width * image.height * image.components;
+    bool streamed = !image.streamFilename.empty();
+    GLintptr staging = -1;
+    if (ring && !streamed && size <= ring->GetSize()) {
+        staging = ring->Allocate(size);
+        if (staging < 0) {
+            return false;
+        }
+    }
+
+    // Storage is immutable and all levels are allocated up front, unless the texture is streamed
+    GLTexture textureID = GLTexture::Create(GL_TEXTURE_2D);
+    if (staging >= 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->GetBuffer());
+    }
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
+    if (streamed) {
+        TextureStreamer::Upload(textureID, image);
+    } else if (image.compressed) {
+        const CompressedTexture& compressed = *image.compressed;
+        glTextureStorage2D(textureID, compressed.GetLevelCount(), compressed.GetFormat(),
+            compressed.GetWidth(), compressed.GetHeight());
+        GLintptr offset = staging;
+        for (unsigned int i = 0; i < compressed.GetLevelCount(); i++) {
+            const CompressedLevel& level = compressed.GetLevel(i);
+            const void* data = compressed.GetLevelData(i);
+            if (staging >= 0) {
+                memcpy(ring->GetPointer(offset), data, level.size);
+                data = (const void*)offset;
+                offset += level.size;
+            }
+            glCompressedTextureSubImage2D(textureID, i, 0, 0, level.width, level.height,
+                compressed.GetFormat(), level.size, data);
+        }
+    } else {
+        GLenum internalFormat = GL_RGBA8;
+        GLenum format = GL_RGBA;
+        if (image.components == 1) {
+            internalFormat = GL_R8;
             format = GL_RED;
-        else if (nrComponents == 3)
+        } else if (image.components == 2) {
+            internalFormat = GL_RG8;
+            format = GL_RG;
+        } else if (image.components == 3) {
+            internalFormat = GL_RGB8;
             format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+        }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        const void* pixels = image.pixels.get();
+        if (staging >= 0) {
+            memcpy(ring->GetPointer(staging), image.pixels.get(), size);
+            pixels = (const void*)staging;
+        }
 
-        // Set repetition parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Full chain down to 1x1
+        GLsizei levels = 1;
+        for (int extent = std::max(image.width, image.height); extent > 1; extent /= 2) {
+            levels++;
+        }
+        glTextureStorage2D(textureID, levels, internalFormat, image.width, image.height);
 
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        // Rows of decoded images are tightly packed
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTextureSubImage2D(textureID, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateTextureMipmap(textureID);
     }
 
-    return textureID;
-}
\ No newline at end of file
+    if (staging >= 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        ring->Commit();
+    }
+    image.pixels.reset();
+    image.compressed.reset();
+
+    auto end = std::chrono::steady_clock::now();
+    id_out = std::move(textureID);
+    timing_out.width = image.width;
+    timing_out.height = image.height;
+    timing_out.decodeMilliseconds = image.decodeMilliseconds;
+    timing_out.uploadMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+    timing_out.staged = staging >= 0;
+    return true;
+}
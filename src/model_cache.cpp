@@ -0,0 +1,516 @@
+#include <model_cache.h>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// Arrays in a cooked file start at multiples of this
+const uint64_t MODEL_CACHE_ALIGNMENT = 16;
+
+static bool cacheEnabled = true;
+
+/**
+ * Rounds an offset up to the alignment of the arrays in a cooked file.
+ *
+ * @param offset The offset to align
+ * 
+ * @returns The aligned offset
+ */
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + MODEL_CACHE_ALIGNMENT - 1) & ~(MODEL_CACHE_ALIGNMENT - 1);
+}
+
+/**
+ * Gets the flags of how imported meshes are currently processed, which
+ * a cooked file must have been written with to be up to date.
+ *
+ * @returns The flags
+ */
+static uint32_t getImportFlags() {
+    uint32_t flags = MeshOptimizer::IsEnabled() ? MODEL_CACHE_OPTIMIZED : 0;
+    if (MeshOptimizer::GetWeldMode() == WELD_EXACT) {
+        flags |= MODEL_CACHE_WELD_EXACT;
+    } else if (MeshOptimizer::GetWeldMode() == WELD_EPSILON) {
+        flags |= MODEL_CACHE_WELD_EPSILON;
+    }
+    if (Mesh::GetSmallestIndexType() != GL_UNSIGNED_INT) {
+        flags |= MODEL_CACHE_SPLIT;
+    }
+    return flags;
+}
+
+/**
+ * Hashes the contents of a file with 64-bit FNV-1a.
+ *
+ * @param path The path to the file
+ * 
+ * @returns The hash, 0 if the file can't be read
+ */
+static uint64_t hashFile(const std::string& path) {
+    MappedFile source;
+    if (!source.Open(path)) {
+        return 0;
+    }
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* data = source.GetData();
+    for (size_t i = 0; i < source.GetSize(); i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Gets the modification time of a file as a plain number.
+ *
+ * @param path The path to the file
+ * @param time_out Output for the modification time
+ * 
+ * @returns true if the time could be read, false otherwise
+ */
+static bool getFileTime(const std::string& path, int64_t& time_out) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    time_out = (int64_t)time.time_since_epoch().count();
+    return true;
+}
+
+/**
+ * Replaces the source modification time in the header of a cooked file.
+ * The file must not be mapped, the mapping doesn't share write access.
+ *
+ * @param cachePath The path to the cooked file
+ * @param sourceTime The modification time of the source file
+ * 
+ * @returns true if the time was written, false otherwise
+ */
+static bool writeSourceTime(const std::string& cachePath, int64_t sourceTime) {
+    std::fstream out(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp(offsetof(ModelCacheHeader, sourceTime));
+    out.write((const char*)&sourceTime, sizeof(sourceTime));
+    return (bool)out;
+}
+
+/**
+ * Maps the cooked file of a source file and checks that it matches the
+ * source and the current mesh welding, optimization and split settings.
+ * The content hash of the source is only computed when its modification
+ * time has changed, so opening an up to date file doesn't read the
+ * source. If only the time has changed, such as after a checkout, the
+ * new time is written to the cooked file so the next open doesn't hash
+ * the source again.
+ *
+ * @param sourcePath The path to the source model file
+ * 
+ * @returns true if the cooked file is valid for the source, false otherwise
+ */
+bool ModelCache::Open(const std::string& sourcePath) {
+    Close();
+    std::error_code error;
+    uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+    int64_t sourceTime;
+    if (!cacheEnabled || error || !getFileTime(sourcePath, sourceTime)) {
+        return false;
+    }
+    std::string cachePath = GetCachePath(sourcePath);
+    if (!mapFile(cachePath)) {
+        return false;
+    }
+
+    if (header->sourceSize != sourceSize) {
+        Close();
+        return false;
+    }
+    if (header->sourceTime != sourceTime) {
+        if (header->sourceHash != hashFile(sourcePath)) {
+            Close();
+            return false;
+        }
+        Close();
+        writeSourceTime(cachePath, sourceTime);
+        return mapFile(cachePath);
+    }
+    return true;
+}
+
+/**
+ * Maps a cooked file, checks that it was written with the current
+ * layout and import settings and validates its tables.
+ *
+ * @param cachePath The path to the cooked file
+ * 
+ * @returns true if the file is mapped and consistent, false otherwise
+ */
+bool ModelCache::mapFile(const std::string& cachePath) {
+    if (!file.Open(cachePath) || file.GetSize() < sizeof(ModelCacheHeader)) {
+        Close();
+        return false;
+    }
+
+    const unsigned char* data = file.GetData();
+    header = (const ModelCacheHeader*)data;
+    if (memcmp(header->magic, MODEL_CACHE_MAGIC, sizeof(MODEL_CACHE_MAGIC)) != 0 ||
+        header->version != MODEL_CACHE_VERSION ||
+        header->vertexSize != sizeof(Vertex) ||
+        header->flags != getImportFlags() ||
+        ((header->flags & MODEL_CACHE_WELD_EPSILON) && header->weldEpsilon != MeshOptimizer::GetWeldEpsilon())) {
+        Close();
+        return false;
+    }
+    meshes = (const ModelCacheMesh*)(data + sizeof(ModelCacheHeader));
+    textures = (const ModelCacheTexture*)(meshes + header->meshCount);
+    textureIndices = (const uint32_t*)(textures + header->textureCount);
+    strings = (const char*)data + header->stringsOffset;
+    if (!validate()) {
+        std::cout << "ERROR::MODEL_CACHE::CORRUPT_FILE " << cachePath << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Unmaps the cooked file, pointers to its data become invalid.
+ * 
+ * @returns void
+ */
+void ModelCache::Close() {
+    file.Close();
+    header = nullptr;
+    meshes = nullptr;
+    textures = nullptr;
+    textureIndices = nullptr;
+    strings = nullptr;
+}
+
+/**
+ * Gets min coordinates for the cooked model.
+ * 
+ * @returns The min coordinates
+ */
+glm::vec3 ModelCache::GetMinCoords() const {
+    return glm::vec3(header->aabbMin[0], header->aabbMin[1], header->aabbMin[2]);
+}
+
+/**
+ * Gets max coordinates for the cooked model.
+ * 
+ * @returns The max coordinates
+ */
+glm::vec3 ModelCache::GetMaxCoords() const {
+    return glm::vec3(header->aabbMax[0], header->aabbMax[1], header->aabbMax[2]);
+}
+
+/**
+ * Gets the number of meshes of the cooked model.
+ * 
+ * @returns The mesh count
+ */
+unsigned int ModelCache::GetMeshCount() const {
+    return header->meshCount;
+}
+
+/**
+ * Gets a mesh of the cooked model.
+ *
+ * @param index The index of the mesh
+ * 
+ * @returns The mesh
+ */
+const ModelCacheMesh& ModelCache::GetMesh(unsigned int index) const {
+    return meshes[index];
+}
+
+/**
+ * Gets the vertices of a mesh in the mapped file.
+ *
+ * @param meshIndex The index of the mesh
+ * 
+ * @returns A pointer to the vertices
+ */
+const Vertex* ModelCache::GetVertices(unsigned int meshIndex) const {
+    return (const Vertex*)(file.GetData() + meshes[meshIndex].vertexOffset);
+}
+
+/**
+ * Gets the indices of a mesh in the mapped file.
+ *
+ * @param meshIndex The index of the mesh
+ * 
+ * @returns A pointer to the indices
+ */
+const unsigned int* ModelCache::GetIndices(unsigned int meshIndex) const {
+    return (const unsigned int*)(file.GetData() + meshes[meshIndex].indexOffset);
+}
+
+/**
+ * Checks that every index of a mesh references a vertex of the mesh.
+ * Opening a file only checks that the arrays are inside it, this is
+ * needed before the indices are used to read vertices on the CPU.
+ *
+ * @param meshIndex The index of the mesh
+ * 
+ * @returns true if all indices are in range, false otherwise
+ */
+bool ModelCache::ValidateIndices(unsigned int meshIndex) const {
+    const ModelCacheMesh& mesh = meshes[meshIndex];
+    const unsigned int* indices = GetIndices(meshIndex);
+    for (uint32_t i = 0; i < mesh.indexCount; i++) {
+        if (indices[i] >= mesh.vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Gets the texture indices of a mesh, the mesh has textureCount of them.
+ *
+ * @param meshIndex The index of the mesh
+ * 
+ * @returns A pointer to the texture indices
+ */
+const uint32_t* ModelCache::GetTextureIndices(unsigned int meshIndex) const {
+    return textureIndices + meshes[meshIndex].firstTexture;
+}
+
+/**
+ * Gets the number of textures referenced by the cooked model.
+ * 
+ * @returns The texture count
+ */
+unsigned int ModelCache::GetTextureCount() const {
+    return header->textureCount;
+}
+
+/**
+ * Gets a texture reference of the cooked model.
+ *
+ * @param index The index of the texture
+ * @param type_out Output for the type of the texture
+ * @param path_out Output for the path of the texture relative to the model
+ * 
+ * @returns void
+ */
+void ModelCache::GetTexture(unsigned int index, std::string& type_out, std::string& path_out) const {
+    const ModelCacheTexture& texture = textures[index];
+    type_out.assign(strings + texture.typeOffset, texture.typeLength);
+    path_out.assign(strings + texture.pathOffset, texture.pathLength);
+}
+
+/**
+ * Writes the cooked file of a source file. The file is written under a
+ * temporary name unique to the writer and renamed when complete, so a
+ * failed write never leaves a partial file behind and loads of the same
+ * model on several threads don't write into the same file.
+ *
+ * @param sourcePath The path to the source model file
+ * @param meshes The imported meshes of the model
+ * @param textures The textures referenced by the meshes
+ * @param aabbMin The min coordinates of the model
+ * @param aabbMax The max coordinates of the model
+ * 
+ * @returns true if the file was written, false otherwise
+ */
+bool ModelCache::Write(
+    const std::string& sourcePath,
+    const std::vector<PendingMesh>& meshes,
+    const std::vector<Texture>& textures,
+    glm::vec3 aabbMin,
+    glm::vec3 aabbMax) {
+    std::error_code error;
+    uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+    int64_t sourceTime;
+    if (!cacheEnabled || error || !getFileTime(sourcePath, sourceTime)) {
+        return false;
+    }
+
+    // Indices are checked here rather than on every open
+    for (const auto& mesh : meshes) {
+        for (unsigned int index : mesh.indices) {
+            if (index >= mesh.vertices.size()) {
+                std::cout << "ERROR::MODEL_CACHE::INDEX_OUT_OF_RANGE " << GetCachePath(sourcePath) << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Lay out the tables, then the strings, then the aligned arrays
+    std::vector<ModelCacheTexture> textureTable(textures.size());
+    std::string stringTable;
+    for (size_t i = 0; i < textures.size(); i++) {
+        textureTable[i].typeOffset = stringTable.size();
+        textureTable[i].typeLength = textures[i].type.size();
+        stringTable += textures[i].type;
+        textureTable[i].pathOffset = stringTable.size();
+        textureTable[i].pathLength = textures[i].path.size();
+        stringTable += textures[i].path;
+    }
+
+    // Value initialized, so fields that aren't set are written as 0
+    std::vector<ModelCacheMesh> meshTable(meshes.size());
+    std::vector<uint32_t> textureIndexTable;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        meshTable[i].vertexCount = meshes[i].vertices.size();
+        meshTable[i].indexCount = meshes[i].indices.size();
+        meshTable[i].firstTexture = textureIndexTable.size();
+        meshTable[i].textureCount = meshes[i].textures.size();
+        textureIndexTable.insert(textureIndexTable.end(), meshes[i].textures.begin(), meshes[i].textures.end());
+        glm::vec3 meshMin(FLT_MAX), meshMax(-FLT_MAX);
+        if (meshes[i].vertices.empty()) {
+            meshMin = meshMax = glm::vec3(0.0f);
+        }
+        for (const auto& vertex : meshes[i].vertices) {
+            meshMin = glm::min(meshMin, vertex.Position);
+            meshMax = glm::max(meshMax, vertex.Position);
+        }
+        memcpy(meshTable[i].aabbMin, &meshMin[0], sizeof(meshTable[i].aabbMin));
+        memcpy(meshTable[i].aabbMax, &meshMax[0], sizeof(meshTable[i].aabbMax));
+        meshTable[i].optimization = meshes[i].optimization;
+    }
+
+    ModelCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(MODEL_CACHE_MAGIC));
+    header.version = MODEL_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = meshes.size();
+    header.textureCount = textures.size();
+    header.textureIndexCount = textureIndexTable.size();
+    header.flags = getImportFlags();
+    header.weldEpsilon = MeshOptimizer::GetWeldEpsilon();
+    header.stringsOffset = sizeof(ModelCacheHeader) +
+        meshTable.size() * sizeof(ModelCacheMesh) +
+        textureTable.size() * sizeof(ModelCacheTexture) +
+        textureIndexTable.size() * sizeof(uint32_t);
+    header.stringsSize = stringTable.size();
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.sourceHash = hashFile(sourcePath);
+    memcpy(header.aabbMin, &aabbMin[0], sizeof(header.aabbMin));
+    memcpy(header.aabbMax, &aabbMax[0], sizeof(header.aabbMax));
+
+    uint64_t offset = alignOffset(header.stringsOffset + header.stringsSize);
+    for (auto& mesh : meshTable) {
+        mesh.vertexOffset = offset;
+        offset = alignOffset(offset + (uint64_t)mesh.vertexCount * sizeof(Vertex));
+        mesh.indexOffset = offset;
+        offset = alignOffset(offset + (uint64_t)mesh.indexCount * sizeof(unsigned int));
+    }
+
+    std::string cachePath = GetCachePath(sourcePath);
+    std::string temporaryPath = MappedFile::GetTemporaryPath(cachePath);
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        const char padding[MODEL_CACHE_ALIGNMENT] = {};
+        auto pad = [&]() {
+            out.write(padding, alignOffset(out.tellp()) - (uint64_t)out.tellp());
+        };
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)meshTable.data(), meshTable.size() * sizeof(ModelCacheMesh));
+        out.write((const char*)textureTable.data(), textureTable.size() * sizeof(ModelCacheTexture));
+        out.write((const char*)textureIndexTable.data(), textureIndexTable.size() * sizeof(uint32_t));
+        out.write(stringTable.data(), stringTable.size());
+        pad();
+        for (const auto& mesh : meshes) {
+            out.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            pad();
+            out.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            pad();
+        }
+        if (!out) {
+            out.close();
+            std::filesystem::remove(temporaryPath, error);
+            std::cout << "ERROR::MODEL_CACHE::WRITE_FAILED " << cachePath << std::endl;
+            return false;
+        }
+    }
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        std::cout << "ERROR::MODEL_CACHE::WRITE_FAILED " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Gets the path of the cooked file of a source file.
+ *
+ * @param sourcePath The path to the source model file
+ * 
+ * @returns The path to the cooked file
+ */
+std::string ModelCache::GetCachePath(const std::string& sourcePath) {
+    return sourcePath + ".ogecache";
+}
+
+/**
+ * Enables or disables cooked files. When disabled models are always
+ * imported with Assimp and no cooked files are written.
+ *
+ * @param enabled true to enable cooked files, false to disable them
+ * 
+ * @returns void
+ */
+void ModelCache::SetEnabled(bool enabled) {
+    cacheEnabled = enabled;
+}
+
+/**
+ * Checks if cooked files are enabled.
+ * 
+ * @returns true if cooked files are enabled, false otherwise
+ */
+bool ModelCache::IsEnabled() {
+    return cacheEnabled;
+}
+
+/**
+ * Checks that all tables, strings and arrays of the mapped file are
+ * inside the file and that all references between them are in range,
+ * so that a truncated or corrupt file is never read out of bounds. The
+ * indices were checked when the file was written and are not scanned
+ * here, since that would read every index array on every open. Use
+ * ValidateIndices before reading vertices through them on the CPU.
+ * 
+ * @returns true if the file is consistent, false otherwise
+ */
+bool ModelCache::validate() const {
+    uint64_t size = file.GetSize();
+    uint64_t tablesEnd = sizeof(ModelCacheHeader) +
+        (uint64_t)header->meshCount * sizeof(ModelCacheMesh) +
+        (uint64_t)header->textureCount * sizeof(ModelCacheTexture) +
+        (uint64_t)header->textureIndexCount * sizeof(uint32_t);
+    if (tablesEnd > size || header->stringsOffset < tablesEnd ||
+        header->stringsSize > size - header->stringsOffset) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header->textureCount; i++) {
+        const ModelCacheTexture& texture = textures[i];
+        if ((uint64_t)texture.typeOffset + texture.typeLength > header->stringsSize ||
+            (uint64_t)texture.pathOffset + texture.pathLength > header->stringsSize) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->textureIndexCount; i++) {
+        if (textureIndices[i] >= header->textureCount) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        const ModelCacheMesh& mesh = meshes[i];
+        if (mesh.vertexOffset % MODEL_CACHE_ALIGNMENT != 0 || mesh.indexOffset % MODEL_CACHE_ALIGNMENT != 0 ||
+            mesh.vertexOffset > size || (uint64_t)mesh.vertexCount * sizeof(Vertex) > size - mesh.vertexOffset ||
+            mesh.indexOffset > size || (uint64_t)mesh.indexCount * sizeof(unsigned int) > size - mesh.indexOffset ||
+            (uint64_t)mesh.firstTexture + mesh.textureCount > header->textureIndexCount) {
+            return false;
+        }
+    }
+    return true;
+}
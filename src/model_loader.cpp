@@ -0,0 +1,74 @@
+#include <model_loader.h>
+
+ModelLoader::ModelLoader(unsigned int threadCount) : pool(threadCount) {}
+
+/**
+ * Starts loading a model on a worker thread. The returned model is empty
+ * until Update has finished it, use Model::IsReady to check if it can be
+ * drawn. Scene skips models that are not ready, so the model can be
+ * added to a scene right away.
+ *
+ * @param path The path to the object file
+ * @param buildBVH true to build triangle BVHs for the meshes on the worker
+ * 
+ * @returns The model being loaded
+ */
+std::shared_ptr<Model> ModelLoader::LoadAsync(const std::string& path, bool buildBVH) {
+    std::shared_ptr<Model> model = std::make_shared<Model>();
+    PendingModel entry;
+    entry.model = model;
+    entry.import = pool.Submit([model, path, buildBVH]() {
+        model->importModel(path, buildBVH);
+    });
+    entry.imported = false;
+    pending.push_back(std::move(entry));
+    return model;
+}
+
+/**
+ * Uploads the textures and meshes of imported models until the time
+ * budget is used up. Models are finished in the order they were
+ * requested, models whose import is still running are skipped, as are
+ * models waiting for a texture to decode or for room in the upload
+ * ring. A slice is a single texture or mesh, so a call can run over the
+ * budget by the time of one upload. Must be called on the render thread, typically
+ * once per frame.
+ *
+ * @param budgetMilliseconds The time to spend on uploads
+ * 
+ * @returns void
+ */
+void ModelLoader::Update(double budgetMilliseconds) {
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(budgetMilliseconds));
+
+    for (size_t i = 0; i < pending.size();) {
+        PendingModel& entry = pending[i];
+        if (!entry.imported) {
+            if (entry.import.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                i++;
+                continue;
+            }
+            entry.import.get();
+            entry.imported = true;
+        }
+        if (entry.model->finishLoading(deadline, &uploadRing)) {
+            pending.erase(pending.begin() + i);
+        } else {
+            i++;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return;
+        }
+    }
+}
+
+/**
+ * Gets the number of requested models that are not ready yet.
+ * 
+ * @returns The number of pending models
+ */
+size_t ModelLoader::GetPendingCount() const {
+    return pending.size();
+}
@@ -0,0 +1,99 @@
+#include <render_queue.h>
+
+/**
+ * Builds a sort key for a draw. The program is in the most significant
+ * bits since program changes are the most expensive, followed by the
+ * material and the vertex array.
+ *
+ * @param program The program the draw uses
+ * @param materialID The ID of the texture set the draw uses
+ * @param vertexArray The vertex array the draw uses
+ * 
+ * @returns The sort key
+ */
+uint64_t RenderQueue::MakeKey(GLuint program, unsigned int materialID, GLuint vertexArray) {
+    return ((uint64_t)(program & 0xFFFF) << 48) |
+        ((uint64_t)(materialID & 0xFFFFFF) << 24) |
+        (uint64_t)(vertexArray & 0xFFFFFF);
+}
+
+/**
+ * Removes all items from the queue.
+ * 
+ * @returns void
+ */
+void RenderQueue::Clear() {
+    items.clear();
+    sorted.clear();
+}
+
+/**
+ * Adds an item to the queue.
+ *
+ * @param item The item to add
+ * 
+ * @returns void
+ */
+void RenderQueue::Add(const DrawItem& item) {
+    items.push_back(item);
+}
+
+/**
+ * Sorts the items with an LSD radix sort over the bytes of the keys.
+ * Passes over bytes that are the same in every key are skipped, so a
+ * frame with few programs and materials only needs a few passes. The
+ * sort is stable, so draws with equal keys keep their insertion order.
+ * 
+ * @returns void
+ */
+void RenderQueue::Sort() {
+    size_t count = items.size();
+    keys.resize(count);
+    tempKeys.resize(count);
+    indices.resize(count);
+    tempIndices.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = items[i].key;
+        indices[i] = (uint32_t)i;
+    }
+
+    for (int shift = 0; shift < 64 && count > 0; shift += 8) {
+        size_t histogram[256] = {};
+        for (size_t i = 0; i < count; i++) {
+            histogram[(keys[i] >> shift) & 0xFF]++;
+        }
+        // Skip bytes that are the same for every key
+        if (histogram[(keys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+            tempKeys[destination] = keys[i];
+            tempIndices[destination] = indices[i];
+        }
+        keys.swap(tempKeys);
+        indices.swap(tempIndices);
+    }
+
+    sorted.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = items[indices[i]];
+    }
+    items.swap(sorted);
+}
+
+/**
+ * Gets the items in the queue.
+ * 
+ * @returns The items, in key order if the queue has been sorted
+ */
+const std::vector<DrawItem>& RenderQueue::GetItems() const {
+    return items;
+}
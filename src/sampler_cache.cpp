@@ -0,0 +1,124 @@
+#include <sampler_cache.h>
+#include <gl_handle.h>
+
+#include <utility>
+#include <vector>
+
+static SamplerState materialState;
+static GLuint materialSampler = 0;
+
+// Samplers created through Get, few enough to be searched in order
+static std::vector<std::pair<SamplerState, GLSampler>>& getSamplers() {
+    static std::vector<std::pair<SamplerState, GLSampler>> samplers;
+    return samplers;
+}
+
+/**
+ * Compares two sampler states.
+ *
+ * @param other The state to compare with
+ *
+ * @returns true if all parameters are equal, false otherwise
+ */
+bool SamplerState::operator==(const SamplerState& other) const {
+    return minFilter == other.minFilter && magFilter == other.magFilter &&
+        wrapS == other.wrapS && wrapT == other.wrapT && maxAnisotropy == other.maxAnisotropy;
+}
+
+/**
+ * Sets all parameters of a new sampler object. Anisotropy is only set
+ * when asked for, so drivers without the extension never see the
+ * parameter.
+ *
+ * @param sampler The sampler to set
+ * @param state The parameters to set
+ *
+ * @returns void
+ */
+static void applyState(GLuint sampler, const SamplerState& state) {
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, state.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, state.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, state.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, state.wrapT);
+    if (state.maxAnisotropy > 1.0f) {
+        glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, state.maxAnisotropy);
+    }
+}
+
+/**
+ * Gets the sampler with a state. Samplers are created the first time a
+ * state is asked for and shared from then on.
+ *
+ * @param state The filtering and wrapping of the sampler
+ *
+ * @returns The sampler
+ */
+GLuint SamplerCache::Get(const SamplerState& state) {
+    auto& samplers = getSamplers();
+    for (const auto& entry : samplers) {
+        if (entry.first == state) {
+            return entry.second;
+        }
+    }
+    GLSampler sampler = GLSampler::Create();
+    applyState(sampler, state);
+    samplers.emplace_back(state, std::move(sampler));
+    return samplers.back().second;
+}
+
+/**
+ * Gets the sampler material textures are drawn with.
+ *
+ * @returns The material sampler
+ */
+GLuint SamplerCache::GetMaterialSampler() {
+    if (!materialSampler) {
+        materialSampler = Get(materialState);
+    }
+    return materialSampler;
+}
+
+/**
+ * Changes the filtering and wrapping of all material textures. Samplers
+ * are never changed once created, since bindless texture handles fix the
+ * state of their sampler. The material sampler is switched to the one
+ * with the new state instead, textures pick it up the next time they
+ * are bound.
+ *
+ * @param state The new state of the material sampler
+ *
+ * @returns void
+ */
+void SamplerCache::SetMaterialState(const SamplerState& state) {
+    materialState = state;
+    materialSampler = 0;
+}
+
+/**
+ * Gets the state of the material sampler.
+ *
+ * @returns The material sampler state
+ */
+const SamplerState& SamplerCache::GetMaterialState() {
+    return materialState;
+}
+
+/**
+ * Gets the number of samplers that have been created.
+ *
+ * @returns The number of samplers
+ */
+size_t SamplerCache::GetSamplerCount() {
+    return getSamplers().size();
+}
+
+/**
+ * Deletes all samplers. The material sampler keeps its state and is
+ * created again when it is next used.
+ *
+ * @returns void
+ */
+void SamplerCache::Clear() {
+    getSamplers().clear();
+    materialSampler = 0;
+}
@@ -1,4 +1,8 @@
 #include <scene.h>
+#include <material_table.h>
+#include <texture_streamer.h>
+
+#include <unordered_set>
 
 /**
  * Check for if a ray intersects with the bounding box of an object.
@@ -183,58 +187,632 @@ void Scene::ScreenPosToWorldRay (
 }
 
 /**
- * Sets view projection and model matrices and draws all models
- * in the scene.
+ * Finds the nearest model under a screen position.
+ *
+ * @param screenX The screen x coordinate (from bottom left)
+ * @param screenY The screen y coordinate (from bottom left)
+ * 
+ * @returns The index of the nearest model, -1 if no model is hit
+ */
+int Scene::Pick(int screenX, int screenY) {
+    RaycastHit hit;
+    return Pick(screenX, screenY, hit);
+}
+
+/**
+ * Finds the nearest model under a screen position. The ray through the
+ * position is traversed through a BVH over the world space bounds of all
+ * models, and only the models whose bounds it hits are tested against
+ * their oriented bounding boxes. Models with triangle BVHs are then
+ * tested against their triangles, so rays through empty space inside
+ * their bounds miss them. The BVH is built on the first pick after
+ * models have been added and refit on the first pick after models have
+ * moved. Uses the screen size of the last UpdateMatrices call.
+ *
+ * @param screenX The screen x coordinate (from bottom left)
+ * @param screenY The screen y coordinate (from bottom left)
+ * @param hit_out Output for the triangle that was hit, the mesh is -1
+ *                if the model was hit without a triangle test
+ * 
+ * @returns The index of the nearest model, -1 if no model is hit
+ */
+int Scene::Pick(int screenX, int screenY, RaycastHit& hit_out) {
+    hit_out = RaycastHit();
+    if (models.empty() || screenWidth <= 0 || screenHeight <= 0) {
+        return -1;
+    }
+    if (pickingBVHDirty) {
+        pickingBVH.Build(modelBounds);
+        pickingBVHDirty = false;
+        pickingBVHMoved = false;
+    } else if (pickingBVHMoved) {
+        pickingBVH.Refit(modelBounds);
+        pickingBVHMoved = false;
+    }
+
+    glm::vec3 rayOrigin, rayDir;
+    ScreenPosToWorldRay(screenX, screenY, screenWidth, screenHeight, rayOrigin, rayDir);
+    float distance;
+    int hitModel = -1;
+    int picked = pickingBVH.Intersect(rayOrigin, rayDir, [&](unsigned int index, float& distance_out) {
+        const ModelData& modelData = models[index];
+        if (!modelData.model_p->IsReady() || !IsRayOBBIntersecting(
+                rayOrigin, rayDir, modelData.modelMatrix,
+                modelData.model_p->GetMinCoords(), modelData.model_p->GetMaxCoords(),
+                distance_out)) {
+            return false;
+        }
+        if (!modelData.model_p->HasBVH()) {
+            return true;
+        }
+
+        // The direction is not normalized so that distances stay in world units
+        glm::mat4 inverseModel = glm::inverse(modelData.modelMatrix);
+        glm::vec3 localOrigin = glm::vec3(inverseModel * glm::vec4(rayOrigin, 1.0f));
+        glm::vec3 localDir = glm::vec3(inverseModel * glm::vec4(rayDir, 0.0f));
+        RaycastHit hit;
+        if (!modelData.model_p->Raycast(localOrigin, localDir, hit)) {
+            return false;
+        }
+        distance_out = hit.distance;
+        if (hitModel < 0 || hit.distance < hit_out.distance) {
+            hit_out = hit;
+            hitModel = index;
+        }
+        return true;
+    }, distance);
+
+    // The nearest model may have been hit without a triangle test
+    if (picked != hitModel) {
+        hit_out = RaycastHit();
+    }
+    return picked;
+}
+
+/**
+ * Writes the per-object data of every model to the object ring and the
+ * instance data of every instance group to the instance ring, then
+ * gathers a draw item for every mesh of every model or group. The items
+ * are sorted by program, material and vertex array and submitted
+ * through a state cache so that redundant binds are skipped. The camera
+ * data is shared by all models through the Camera block written in
+ * UpdateMatrices. While the material table is enabled it is bound once
+ * for the frame and meshes only set their material index. Models that
+ * are still loading are skipped. The streamed textures of the visible
+ * models are requested at their size on screen, and once the models are
+ * drawn TextureStreamer::Update uploads the levels loaded so far and
+ * starts loading the requested ones, unless the streaming update is off.
  * 
  * @returns void
  */
 void Scene::Draw() {
-    for (auto modelData : models) {
-        // Set matrices and draw
-        modelData.shader_p->use();
-        SetModelUniforms(modelData.shader_p, modelData.vec3_uniforms);
-        modelData.shader_p->setVec3("viewPos", camera->Position);
-        modelData.shader_p->setMat4("view", view);
-        modelData.shader_p->setMat4("projection", projection);
-        modelData.shader_p->setMat4("model", modelData.modelMatrix);
-        modelData.model_p->Draw(*modelData.shader_p);
+    UpdatePendingModels();
+    CullModels();
+    RequestTextures();
+
+    unsigned int objectCount = models.size() - instancedModelCount;
+    objectRing.BeginFrame(objectCount * objectRing.Align(maxObjectBlockSize));
+    instanceRing.BeginFrame(instancedModelCount * sizeof(InstanceData));
+    queue.Clear();
+
+    for (unsigned int i = 0; i < models.size(); i++) {
+        const ModelData& modelData = models[i];
+        if (modelData.instanced || modelVisibility[i] == CULL_OUTSIDE) {
+            continue;
+        }
+        GLintptr objectOffset = WriteObjectBlock(modelData);
+        for (auto& mesh : modelData.model_p->GetMeshes()) {
+            // Meshes of models on the frustum boundary are culled one by one
+            if (modelVisibility[i] == CULL_INTERSECTING && !IsMeshVisible(modelData, mesh)) {
+                cullingStats.culledMeshes++;
+                continue;
+            }
+            cullingStats.visibleMeshes++;
+            DrawItem item;
+            item.key = RenderQueue::MakeKey(modelData.shader_p->ID, mesh.GetMaterialID(), mesh.GetVAO());
+            item.shader_p = modelData.shader_p;
+            item.mesh_p = &mesh;
+            item.modelIndex = i;
+            item.objectOffset = objectOffset;
+            item.objectSize = modelData.objectBlock.size;
+            item.instanceOffset = 0;
+            item.instanceCount = 0;
+            item.pooled = false;
+            queue.Add(item);
+        }
+    }
+
+    unsigned int pooledCount = 0;
+    for (const auto& group : instanceGroups) {
+        GLsizei instanceCount = 0;
+        GLintptr instanceOffset = WriteInstanceData(group, instanceCount);
+        if (instanceOffset < 0 || instanceCount == 0) {
+            continue;
+        }
+        for (auto& mesh : group.model_p->GetMeshes()) {
+            cullingStats.visibleMeshes += instanceCount;
+            bool pooled = multiDrawIndirect && mesh.GetPool() == &geometryPool;
+            GLuint vertexArray = pooled ? geometryPool.GetVAO() : mesh.GetVAO();
+            DrawItem item;
+            item.key = RenderQueue::MakeKey(group.shader_p->ID, mesh.GetMaterialID(), vertexArray);
+            item.shader_p = group.shader_p;
+            item.mesh_p = &mesh;
+            item.modelIndex = group.modelIndices[0];
+            item.objectOffset = -1;
+            item.objectSize = 0;
+            item.instanceOffset = instanceOffset;
+            item.instanceCount = instanceCount;
+            item.pooled = pooled;
+            queue.Add(item);
+            if (pooled) {
+                pooledCount++;
+            }
+        }
+    }
+    queue.Sort();
+
+    if (pooledCount > 0) {
+        indirectRing.BeginFrame(pooledCount * sizeof(DrawElementsIndirectCommand));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectRing.GetBuffer());
+        geometryPool.SetInstanceBuffer(instanceRing.GetBuffer());
+    }
+
+    state.Reset();
+    state.ResetStats();
+    MaterialTable::Bind(&state);
+    unsigned int lastModel = models.size();
+    const std::vector<DrawItem>& items = queue.GetItems();
+    for (size_t i = 0; i < items.size(); i++) {
+        const DrawItem& item = items[i];
+        state.UseProgram(item.shader_p->ID);
+        if (item.objectOffset >= 0) {
+            state.BindUniformRange(OBJECT_BLOCK_BINDING, objectRing.GetBuffer(), item.objectOffset, item.objectSize);
+        }
+        // Plain uniforms are program state, set them when the model changes
+        if (item.modelIndex != lastModel) {
+            SetModelUniforms(models[item.modelIndex]);
+            lastModel = item.modelIndex;
+        }
+        if (item.pooled) {
+            // Draw every following item that can share the indirect call
+            size_t end = i + 1;
+            while (end < items.size() && CanShareIndirectDraw(item, items[end])) {
+                end++;
+            }
+            SubmitIndirect(items, i, end);
+            i = end - 1;
+        } else if (item.instanceCount > 0) {
+            item.mesh_p->DrawInstanced(*item.shader_p, state, instanceRing.GetBuffer(), item.instanceOffset, item.instanceCount);
+        } else {
+            item.mesh_p->Draw(*item.shader_p, state);
+        }
+    }
+    state.BindVertexArray(0);
+    objectRing.EndFrame();
+    instanceRing.EndFrame();
+    if (pooledCount > 0) {
+        indirectRing.EndFrame();
+    }
+    if (streamingUpdate) {
+        TextureStreamer::Update();
+    }
+}
+
+/**
+ * Draws a run of pooled items with a single glMultiDrawElementsIndirect
+ * call. Each item becomes one command that selects the mesh through its
+ * first index and base vertex in the pool and its instances through
+ * baseInstance, so the items only have to share program, textures and
+ * uniforms, including the position decode.
+ *
+ * @param items The sorted draw items of the frame
+ * @param begin The index of the first item to draw
+ * @param end The index after the last item to draw
+ * 
+ * @returns void
+ */
+void Scene::SubmitIndirect(const std::vector<DrawItem>& items, size_t begin, size_t end) {
+    GLsizei count = end - begin;
+    GLintptr offset = indirectRing.Allocate(count * sizeof(DrawElementsIndirectCommand));
+    if (offset < 0) {
+        return;
+    }
+
+    DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)indirectRing.GetPointer(offset);
+    for (GLsizei i = 0; i < count; i++) {
+        const DrawItem& item = items[begin + i];
+        commands[i].count = item.mesh_p->GetIndexCount();
+        commands[i].instanceCount = item.instanceCount;
+        commands[i].firstIndex = item.mesh_p->GetPoolFirstIndex();
+        commands[i].baseVertex = item.mesh_p->GetPoolBaseVertex();
+        commands[i].baseInstance = item.instanceOffset / sizeof(InstanceData);
+    }
+
+    items[begin].mesh_p->BindTextures(*items[begin].shader_p, state);
+    items[begin].mesh_p->BindVertexDecode(*items[begin].shader_p, state);
+    state.BindVertexArray(geometryPool.GetVAO());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, geometryPool.GetIndexType(), (const void*)offset, count, 0);
+    state.CountDraw();
+}
+
+/**
+ * Checks if a pooled item can be drawn by the same indirect call as the
+ * first item of a run. They must use the same program and material, and
+ * the same position decode when their vertices are quantized against
+ * their bounds. Models with plain vec3 uniforms can only share a call
+ * with themselves.
+ *
+ * @param first The first item of the run
+ * @param item The item to check
+ * 
+ * @returns true if the item can be added to the run, false otherwise
+ */
+bool Scene::CanShareIndirectDraw(const DrawItem& first, const DrawItem& item) {
+    if (!item.pooled || item.shader_p != first.shader_p ||
+        item.mesh_p->GetMaterialID() != first.mesh_p->GetMaterialID() ||
+        item.mesh_p->GetPositionDecode() != first.mesh_p->GetPositionDecode()) {
+        return false;
+    }
+    return item.modelIndex == first.modelIndex ||
+        (models[item.modelIndex].vec3_uniforms.empty() && models[first.modelIndex].vec3_uniforms.empty());
+}
+
+/**
+ * Sets the uniforms for a model that are not part of the uniform blocks.
+ * Shaders that don't use the uniform blocks get the matrices and view
+ * position as plain uniforms.
+ * 
+ * @param modelData The model to set the uniforms for
+ * 
+ * @returns void
+ */
+void Scene::SetModelUniforms(const ModelData& modelData) {
+    Shader* shader_p = modelData.shader_p;
+    for (const auto& uniform : modelData.vec3_uniforms) {
+        if (uniform.handle.IsValid()) {
+            shader_p->set(uniform.handle, uniform.value);
+        }
+    }
+    if (modelData.uniforms.viewPos.IsValid()) {
+        shader_p->set(modelData.uniforms.viewPos, camera->Position);
+    }
+    if (modelData.uniforms.view.IsValid()) {
+        shader_p->set(modelData.uniforms.view, view);
+    }
+    if (modelData.uniforms.projection.IsValid()) {
+        shader_p->set(modelData.uniforms.projection, projection);
+    }
+    if (modelData.uniforms.model.IsValid()) {
+        shader_p->set(modelData.uniforms.model, modelData.modelMatrix);
+    }
+}
+
+/**
+ * Writes the Object block of a model into the current frame of the
+ * object ring. Members of the block are written at the offsets
+ * reflected from the model's shader.
+ * 
+ * @param modelData The model to write the block for
+ * 
+ * @returns The offset of the block in the ring, -1 if the shader has no Object block
+ */
+GLintptr Scene::WriteObjectBlock(const ModelData& modelData) {
+    const ObjectBlockLayout& layout = modelData.objectBlock;
+    if (layout.size == 0) {
+        return -1;
+    }
+    GLintptr offset = objectRing.Allocate(layout.size);
+    if (offset < 0) {
+        return -1;
+    }
+
+    unsigned char* block = (unsigned char*)objectRing.GetPointer(offset);
+    if (layout.model >= 0) {
+        memcpy(block + layout.model, &modelData.modelMatrix[0][0], sizeof(glm::mat4));
+    }
+    if (layout.normalMatrix >= 0) {
+        memcpy(block + layout.normalMatrix, &modelData.normalMatrix[0][0], sizeof(glm::mat4));
+    }
+    for (const auto& uniform : modelData.vec3_uniforms) {
+        if (uniform.offset >= 0) {
+            memcpy(block + uniform.offset, &uniform.value[0], sizeof(glm::vec3));
+        }
+    }
+    return offset;
+}
+
+/**
+ * Writes the model and normal matrices of every visible model in an
+ * instance group into the current frame of the instance ring. Culled
+ * models are left out, so the instances are culled per model but the
+ * meshes of visible instances are always drawn.
+ * 
+ * @param group The instance group to write the data for
+ * @param count_out Output for the number of instances written
+ * 
+ * @returns The offset of the data in the ring, -1 if the ring is full
+ */
+GLintptr Scene::WriteInstanceData(const InstanceGroup& group, GLsizei& count_out) {
+    count_out = 0;
+    GLintptr offset = instanceRing.Allocate(group.modelIndices.size() * sizeof(InstanceData));
+    if (offset < 0) {
+        return -1;
+    }
+
+    InstanceData* instances = (InstanceData*)instanceRing.GetPointer(offset);
+    for (unsigned int modelIndex : group.modelIndices) {
+        if (modelVisibility[modelIndex] == CULL_OUTSIDE) {
+            continue;
+        }
+        const ModelData& modelData = models[modelIndex];
+        instances[count_out].model = modelData.modelMatrix;
+        instances[count_out].normalMatrix = modelData.normalMatrix;
+        count_out++;
+    }
+    return offset;
+}
+
+/**
+ * Sets up the models that were still loading when they were added and
+ * have become ready since. Their bounds are computed from their meshes,
+ * which also makes the picking BVH rebuild, and the meshes of instanced
+ * models are added to the geometry pool.
+ * 
+ * @returns void
+ */
+void Scene::UpdatePendingModels() {
+    for (size_t i = 0; i < pendingModels.size();) {
+        unsigned int index = pendingModels[i];
+        const ModelData& modelData = models[index];
+        if (!modelData.model_p->IsReady()) {
+            i++;
+            continue;
+        }
+        UpdateModelBounds(index);
+        pickingBVHDirty = true;
+        if (modelData.instanced && multiDrawIndirect) {
+            for (auto& mesh : modelData.model_p->GetMeshes()) {
+                geometryPool.AddMesh(mesh);
+            }
+        }
+        pendingModels.erase(pendingModels.begin() + i);
+    }
+}
+
+/**
+ * Updates the world space bounds of a model from its model matrix. Models
+ * that are still loading get empty bounds at their origin.
+ *
+ * @param index The index of the model
+ * 
+ * @returns void
+ */
+void Scene::UpdateModelBounds(unsigned int index) {
+    const ModelData& modelData = models[index];
+    glm::vec3 center = glm::vec3(modelData.modelMatrix[3]);
+    glm::vec3 extent = glm::vec3(0.0f);
+    if (modelData.model_p->IsReady()) {
+        TransformAABB(modelData.modelMatrix, modelData.model_p->GetMinCoords(), modelData.model_p->GetMaxCoords(), center, extent);
+    }
+    if (index < modelBounds.Size()) {
+        modelBounds.Set(index, center, extent);
+    } else {
+        modelBounds.Add(center, extent);
+    }
+}
+
+/**
+ * Tests the world space bounds of all models against the view frustum
+ * and counts the visible and culled models. Models that are still
+ * loading are always culled.
+ * 
+ * @returns void
+ */
+void Scene::CullModels() {
+    cullingStats = CullingStats();
+    if (frustumCulling) {
+        modelBounds.Cull(frustum, modelVisibility);
+    } else {
+        modelVisibility.assign(models.size(), CULL_INSIDE);
+    }
+    for (unsigned int index : pendingModels) {
+        modelVisibility[index] = CULL_OUTSIDE;
+    }
+    for (uint8_t visibility : modelVisibility) {
+        if (visibility == CULL_OUTSIDE) {
+            cullingStats.culledModels++;
+        } else {
+            cullingStats.visibleModels++;
+        }
     }
 }
 
 /**
- * Sets the uniforms for a model
+ * Checks if a mesh of a model that intersects the frustum boundary is
+ * inside the frustum.
+ * 
+ * @param modelData The model the mesh belongs to
+ * @param mesh The mesh to test
  * 
- * @param shader_p A pointer to the shader for the model
- * @param vec3_uniforms A vector of vec3 UniformData to set
+ * @returns true if the mesh is at least partially inside the frustum
+ */
+bool Scene::IsMeshVisible(const ModelData& modelData, const Mesh& mesh) {
+    glm::vec3 center, extent;
+    TransformAABB(modelData.modelMatrix, mesh.GetMinCoords(), mesh.GetMaxCoords(), center, extent);
+    return frustum.TestAABB(center, extent) != CULL_OUTSIDE;
+}
+
+/**
+ * Requests the streamed textures of every visible model at the size the
+ * model covers on screen. The size is the projected diameter of the
+ * sphere around the world space bounds of the model, which over-estimates
+ * the detail needed for flat or distant textures rather than blurring
+ * them. Models the camera is inside of request the full screen height.
+ * Skipped while streaming is disabled.
  * 
  * @returns void
  */
-void Scene::SetModelUniforms(Shader* shader_p, std::vector<UniformData<glm::vec3>> vec3_uniforms) {
-    for (auto uniform : vec3_uniforms) {
-        shader_p->setVec3(uniform.name, uniform.value);
+void Scene::RequestTextures() {
+    if (!TextureStreamer::IsEnabled() || screenHeight <= 0) {
+        return;
     }
+    for (unsigned int i = 0; i < models.size(); i++) {
+        if (modelVisibility[i] == CULL_OUTSIDE) {
+            continue;
+        }
+        glm::vec3 aabbMin, aabbMax;
+        modelBounds.GetBox(i, aabbMin, aabbMax);
+        glm::vec3 center = (aabbMin + aabbMax) * 0.5f;
+        float radius = glm::length(aabbMax - aabbMin) * 0.5f;
+        float distance = glm::length(center - camera->Position);
+        float screenSize = (float)screenHeight;
+        if (distance > radius) {
+            screenSize = std::min(screenSize, radius / distance * projection[1][1] * (float)screenHeight);
+        }
+        for (const auto& mesh : models[i].model_p->GetMeshes()) {
+            for (const auto& texture : mesh.textures) {
+                if (texture.layer < 0) {
+                    TextureStreamer::Request(texture.id, screenSize);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Adds a model drawn with an instanced shader to the instance group with
+ * the same model, shader and vec3 uniforms, creating the group if there
+ * is none.
+ * 
+ * @param modelIndex The index of the model in the vector of model data
+ * 
+ * @returns void
+ */
+void Scene::AddToInstanceGroup(unsigned int modelIndex) {
+    const ModelData& modelData = models[modelIndex];
+    for (auto& group : instanceGroups) {
+        if (group.model_p != modelData.model_p || group.shader_p != modelData.shader_p) {
+            continue;
+        }
+        const auto& groupUniforms = models[group.modelIndices[0]].vec3_uniforms;
+        bool sameUniforms = groupUniforms.size() == modelData.vec3_uniforms.size();
+        for (unsigned int i = 0; sameUniforms && i < groupUniforms.size(); i++) {
+            sameUniforms = groupUniforms[i].name == modelData.vec3_uniforms[i].name &&
+                groupUniforms[i].value == modelData.vec3_uniforms[i].value;
+        }
+        if (sameUniforms) {
+            group.modelIndices.push_back(modelIndex);
+            return;
+        }
+    }
+    instanceGroups.push_back({modelData.model_p, modelData.shader_p, {modelIndex}});
 }
 
 /**
- * Creates a model data struct and adds it to the vector of model data
+ * Creates a model data struct and adds it to the vector of model data.
+ * The uniforms of the model are resolved here once so that drawing
+ * doesn't need any uniform name lookups. Models still being loaded by a
+ * ModelLoader can be added, they are drawn once they are ready.
  *
  * @param model_p A pointer to the model object
  * @param modelMatrix The model matrix
  * @param shader_p A pointer to the shader program to use when rendering
+ * @param vec3_uniforms Additional vec3 uniforms to set for the model
+ * 
+ * @returns The index of the model in the scene
+ */
+unsigned int Scene::AddModel(Model* model_p, glm::mat4 modelMatrix, Shader* shader_p, std::vector<UniformData<glm::vec3>> vec3_uniforms) {
+    for (auto& uniform : vec3_uniforms) {
+        uniform.handle = shader_p->GetUniform<glm::vec3>(uniform.name);
+        uniform.offset = shader_p->GetUniformOffset(uniform.name);
+    }
+
+    ObjectBlockLayout objectBlock;
+    objectBlock.size = shader_p->GetUniformBlockSize("Object");
+    objectBlock.model = shader_p->GetUniformOffset("model");
+    objectBlock.normalMatrix = shader_p->GetUniformOffset("normalMatrix");
+    if (objectBlock.size > maxObjectBlockSize) {
+        maxObjectBlockSize = objectBlock.size;
+    }
+
+    SceneUniforms uniforms;
+    uniforms.model = shader_p->GetUniform<glm::mat4>("model");
+    uniforms.view = shader_p->GetUniform<glm::mat4>("view");
+    uniforms.projection = shader_p->GetUniform<glm::mat4>("projection");
+    uniforms.viewPos = shader_p->GetUniform<glm::vec3>("viewPos");
+
+    glm::mat4 normalMatrix = glm::transpose(glm::inverse(modelMatrix));
+    bool instanced = shader_p->HasAttribute("aInstanceModel");
+    models.push_back({model_p, modelMatrix, shader_p, std::move(vec3_uniforms), uniforms, objectBlock, normalMatrix, instanced});
+    UpdateModelBounds(models.size() - 1);
+    pickingBVHDirty = true;
+    if (!model_p->IsReady()) {
+        pendingModels.push_back(models.size() - 1);
+    }
+
+    // Models with an instanced shader are drawn together with all models
+    // that can share their draw calls
+    if (instanced) {
+        AddToInstanceGroup(models.size() - 1);
+        instancedModelCount++;
+        if (multiDrawIndirect) {
+            for (auto& mesh : model_p->GetMeshes()) {
+                geometryPool.AddMesh(mesh);
+            }
+        }
+    }
+    return models.size() - 1;
+}
+
+/**
+ * Sets the model matrix of a model and updates its world space bounds.
+ *
+ * @param index The index of the model returned by AddModel
+ * @param modelMatrix The new model matrix
  * 
  * @returns void
  */
-void Scene::AddModel(Model* model_p, glm::mat4 modelMatrix, Shader* shader_p, std::vector<UniformData<glm::vec3>> vec3_uniforms) {
-    models.push_back({model_p, modelMatrix, shader_p, vec3_uniforms});
+void Scene::SetModelMatrix(unsigned int index, glm::mat4 modelMatrix) {
+    ModelData& modelData = models[index];
+    modelData.modelMatrix = modelMatrix;
+    modelData.normalMatrix = glm::transpose(glm::inverse(modelMatrix));
+    UpdateModelBounds(index);
+    pickingBVHMoved = true;
+}
+
+/**
+ * Gets the data of a model added to the scene.
+ *
+ * @param index The index of the model returned by AddModel
+ * 
+ * @returns The model data
+ */
+const ModelData& Scene::GetModel(unsigned int index) const {
+    return models[index];
 }
 
 /**
- * Clears the vector of models for the scene
+ * Clears the vector of models for the scene. The geometry pool is
+ * emptied as well, so the models can be destroyed and new ones added
+ * without the pool holding on to the geometry of the old ones.
  * 
  * @returns void
  */
 void Scene::ClearModels() {
+    for (const auto& modelData : models) {
+        for (auto& mesh : modelData.model_p->GetMeshes()) {
+            if (mesh.GetPool() == &geometryPool) {
+                mesh.SetPoolRange(nullptr, 0, 0);
+            }
+        }
+    }
+    geometryPool.Clear();
     models.clear();
+    modelBounds.Clear();
+    instanceGroups.clear();
+    pendingModels.clear();
+    instancedModelCount = 0;
+    pickingBVHDirty = true;
 }
 
 /**
@@ -249,7 +827,8 @@ void Scene::SetCamera(Camera* cam) {
 }
 
 /**
- * Updates the view and projection matrices for the scene
+ * Updates the view and projection matrices for the scene and writes
+ * them to the Camera uniform block shared by all shaders.
  *
  * @param screenWidth   The width of the screen in pixels
  * @param screenHeight  The height of the screen in pixels
@@ -257,9 +836,109 @@ void Scene::SetCamera(Camera* cam) {
  * @returns void
  */
 void Scene::UpdateMatrices(int screenWidth, int screenHeight) {
+    this->screenWidth = screenWidth;
+    this->screenHeight = screenHeight;
     view = camera->GetViewMatrix();
     projection = glm::perspective(
         glm::radians(camera->Zoom),
         (float)screenWidth / (float)screenHeight,
         0.1f, 100.0f);
+    frustum.Extract(projection * view);
+
+    CameraBlock block;
+    block.view = view;
+    block.projection = projection;
+    block.viewPos = glm::vec4(camera->Position, 1.0f);
+    if (!cameraBuffer) {
+        cameraBuffer = GLBuffer::Create();
+        glNamedBufferStorage(cameraBuffer, sizeof(CameraBlock), NULL, GL_DYNAMIC_STORAGE_BIT);
+    }
+    glNamedBufferSubData(cameraBuffer, 0, sizeof(CameraBlock), &block);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, cameraBuffer);
+}
+
+/**
+ * Gets the counters of draw calls and state changes of the last frame.
+ * 
+ * @returns The render stats
+ */
+const RenderStats& Scene::GetRenderStats() const {
+    return state.GetStats();
+}
+
+/**
+ * Enables or disables the multi-draw indirect path. When enabled, the
+ * meshes of all models drawn with an instanced shader are copied into a
+ * geometry pool, and each frame all their draws that share a program
+ * and material are submitted with one glMultiDrawElementsIndirect call.
+ *
+ * @param enabled true to enable the path, false to disable it
+ * 
+ * @returns void
+ */
+void Scene::SetMultiDrawIndirect(bool enabled) {
+    multiDrawIndirect = enabled;
+    if (!enabled) {
+        return;
+    }
+    for (const auto& group : instanceGroups) {
+        for (auto& mesh : group.model_p->GetMeshes()) {
+            geometryPool.AddMesh(mesh);
+        }
+    }
+}
+
+/**
+ * Enables or disables frustum culling of models and meshes.
+ *
+ * @param enabled true to enable culling, false to draw everything
+ * 
+ * @returns void
+ */
+void Scene::SetFrustumCulling(bool enabled) {
+    frustumCulling = enabled;
+}
+
+/**
+ * Enables or disables the texture streaming update at the end of Draw.
+ * Streaming counts frames by its updates, so when several scenes are
+ * drawn in a frame only the last one should update it, or the textures
+ * requested by the others count as unused and are evicted first.
+ *
+ * @param enabled true to update streaming after drawing, false to leave it to another scene
+ * 
+ * @returns void
+ */
+void Scene::SetStreamingUpdate(bool enabled) {
+    streamingUpdate = enabled;
+}
+
+/**
+ * Gets the number of visible and culled models and meshes of the last
+ * drawn frame. Meshes of instanced models are counted once per instance.
+ * 
+ * @returns The culling stats
+ */
+const CullingStats& Scene::GetCullingStats() const {
+    return cullingStats;
+}
+
+/**
+ * Gets the memory the indices of the models in the scene take, and how
+ * much smaller index types saved against 32-bit indices. Models added
+ * more than once are counted once, since they share their buffers.
+ * 
+ * @returns The index memory counters
+ */
+IndexMemoryStats Scene::GetIndexMemoryStats() const {
+    IndexMemoryStats stats;
+    std::unordered_set<const Model*> counted;
+    for (const auto& modelData : models) {
+        if (counted.insert(modelData.model_p).second) {
+            for (const auto& mesh : modelData.model_p->GetMeshes()) {
+                stats.Add(mesh.GetIndexCount(), mesh.GetIndexType());
+            }
+        }
+    }
+    return stats;
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include <shader.h>
 
+#include <atomic>
+
+static std::atomic<uint64_t> nextGeneration{1};
+
 // Constructor
 Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     std::string vertexCode;
@@ -52,7 +56,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     }
 
     // 3. Link shaders
-    ID = glCreateProgram();
+    ID = GLProgram::Create();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
@@ -66,6 +70,21 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     // Delete the shaders, they won't be needed after they are linked
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    // 4. Cache the locations of all active uniforms
+    reflectUniforms();
+    generation = nextGeneration++;
+}
+
+/**
+ * Gets the generation of the shader. GL reuses the names of deleted
+ * programs, so state resolved for a shader is keyed by its generation,
+ * which is unique for the whole run and moves with the shader.
+ * 
+ * @returns The generation of the shader, never 0
+ */
+uint64_t Shader::GetGeneration() const {
+    return generation;
 }
 
 /**
@@ -77,6 +96,91 @@ void Shader::use() {
     glUseProgram(ID);
 }
 
+/**
+ * Gets the location of a uniform from the table built after linking.
+ *
+ * @param name The name of the uniform
+ * 
+ * @returns The location of the uniform, -1 if it is not active
+ */
+GLint Shader::GetUniformLocation(const std::string &name) const {
+    auto it = uniformIndices.find(name);
+    if (it == uniformIndices.end()) {
+        return -1;
+    }
+    return uniforms[it->second].location;
+}
+
+/**
+ * Gets the byte offset of a uniform that is a member of a uniform block.
+ *
+ * @param name The name of the block member
+ * 
+ * @returns The offset into the block, -1 if the uniform is not a block member
+ */
+GLint Shader::GetUniformOffset(const std::string &name) const {
+    auto it = uniformIndices.find(name);
+    if (it == uniformIndices.end()) {
+        return -1;
+    }
+    return uniforms[it->second].offset;
+}
+
+/**
+ * Gets the size of the data backing a uniform block.
+ *
+ * @param blockName The name of the uniform block
+ * 
+ * @returns The size in bytes, 0 if the block is not active
+ */
+GLint Shader::GetUniformBlockSize(const std::string &blockName) const {
+    GLuint blockIndex = glGetUniformBlockIndex(ID, blockName.c_str());
+    if (blockIndex == GL_INVALID_INDEX) {
+        return 0;
+    }
+    GLint size = 0;
+    glGetActiveUniformBlockiv(ID, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    return size;
+}
+
+/**
+ * Gets all active uniforms of the program.
+ * 
+ * @returns The table of reflected uniforms
+ */
+const std::vector<UniformInfo>& Shader::GetUniforms() const {
+    return uniforms;
+}
+
+/**
+ * Checks if the program has an active vertex attribute.
+ *
+ * @param name The name of the attribute
+ * 
+ * @returns true if the attribute is active, false otherwise
+ */
+bool Shader::HasAttribute(const std::string &name) const {
+    return glGetAttribLocation(ID, name.c_str()) >= 0;
+}
+
+/**
+ * Gets the texture unit a sampler uniform reads from, such as one given
+ * with a binding layout qualifier.
+ *
+ * @param name The name of the sampler uniform
+ * 
+ * @returns The texture unit, -1 if the uniform is not active
+ */
+GLint Shader::GetSamplerUnit(const std::string &name) const {
+    GLint location = GetUniformLocation(name);
+    if (location < 0) {
+        return -1;
+    }
+    GLint unit = -1;
+    glGetUniformiv(ID, location, &unit);
+    return unit;
+}
+
 /**
  * Sets a bool uniform in the shader.
  *
@@ -86,7 +190,7 @@ void Shader::use() {
  * @returns void
  */
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(GetUniformLocation(name), (int)value);
 }
 /**
  * Sets an int uniform in the shader.
@@ -97,7 +201,7 @@ void Shader::setBool(const std::string &name, bool value) const {
  * @returns void
  */
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(GetUniformLocation(name), value);
 }
 /**
  * Sets a float uniform in the shader.
@@ -108,7 +212,7 @@ void Shader::setInt(const std::string &name, int value) const {
  * @returns void
  */
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(GetUniformLocation(name), value);
 }
 /**
  * Sets a mat4 uniform of floats in the shader.
@@ -119,7 +223,7 @@ void Shader::setFloat(const std::string &name, float value) const {
  * @returns void
  */
 void Shader::setMat4(const std::string &name, glm::mat4 value) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
 /**
  * Sets a vec3 uniform of floats in the shader.
@@ -130,7 +234,7 @@ void Shader::setMat4(const std::string &name, glm::mat4 value) const {
  * @returns void
  */
 void Shader::setVec3(const std::string &name, glm::vec3 value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(GetUniformLocation(name), 1, &value[0]);
 }
 /**
  * Sets a vec3 uniform of floats in the shader.
@@ -143,5 +247,137 @@ void Shader::setVec3(const std::string &name, glm::vec3 value) const {
  * @returns void
  */
 void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &glm::vec3(x, y, z)[0]);
+    glUniform3fv(GetUniformLocation(name), 1, &glm::vec3(x, y, z)[0]);
+}
+
+/**
+ * Sets a bool uniform through a pre-resolved handle.
+ *
+ * @param handle The handle of the uniform to set
+ * @param value value to set the uniform to
+ * 
+ * @returns void
+ */
+void Shader::set(UniformHandle<bool> handle, bool value) const {
+    glUniform1i(handle.location, (int)value);
+}
+/**
+ * Sets an int uniform through a pre-resolved handle.
+ *
+ * @param handle The handle of the uniform to set
+ * @param value value to set the uniform to
+ * 
+ * @returns void
+ */
+void Shader::set(UniformHandle<int> handle, int value) const {
+    glUniform1i(handle.location, value);
+}
+/**
+ * Sets a float uniform through a pre-resolved handle.
+ *
+ * @param handle The handle of the uniform to set
+ * @param value value to set the uniform to
+ * 
+ * @returns void
+ */
+void Shader::set(UniformHandle<float> handle, float value) const {
+    glUniform1f(handle.location, value);
+}
+/**
+ * Sets a mat4 uniform through a pre-resolved handle.
+ *
+ * @param handle The handle of the uniform to set
+ * @param value A mat4 of floats to set the uniform to
+ * 
+ * @returns void
+ */
+void Shader::set(UniformHandle<glm::mat4> handle, const glm::mat4 &value) const {
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+/**
+ * Sets a vec3 uniform through a pre-resolved handle.
+ *
+ * @param handle The handle of the uniform to set
+ * @param value A vec3 of floats to set the uniform to
+ * 
+ * @returns void
+ */
+void Shader::set(UniformHandle<glm::vec3> handle, const glm::vec3 &value) const {
+    glUniform3fv(handle.location, 1, &value[0]);
+}
+
+/**
+ * Builds the uniform table from the active uniforms of the linked
+ * program. Arrays are registered both by their base name and by
+ * each element so that "lights[1]" resolves without a GL query.
+ * 
+ * @returns void
+ */
+void Shader::reflectUniforms() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+    uniforms.clear();
+    uniformIndices.clear();
+    uniforms.reserve(count);
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        const std::string arraySuffix = "[0]";
+        bool isArray = name.size() > arraySuffix.size() &&
+            name.compare(name.size() - arraySuffix.size(), arraySuffix.size(), arraySuffix) == 0;
+
+        // Uniforms inside uniform blocks don't have a location, they are
+        // written to a buffer at their offset instead
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        if (location < 0) {
+            GLuint index = (GLuint)i;
+            GLint blockIndex = -1;
+            GLint offset = -1;
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_OFFSET, &offset);
+            if (blockIndex >= 0) {
+                addUniform(name, type, size, -1, blockIndex, offset);
+                if (isArray) {
+                    addUniform(name.substr(0, name.size() - arraySuffix.size()), type, size, -1, blockIndex, offset);
+                }
+            }
+            continue;
+        }
+
+        if (isArray) {
+            std::string baseName = name.substr(0, name.size() - arraySuffix.size());
+            addUniform(baseName, type, size, location);
+            for (GLint element = 0; element < size; element++) {
+                std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                addUniform(elementName, type, 1, glGetUniformLocation(ID, elementName.c_str()));
+            }
+        } else {
+            addUniform(name, type, size, location);
+        }
+    }
+}
+
+/**
+ * Adds an entry to the uniform table.
+ *
+ * @param name The name to register the uniform under
+ * @param type The GL type of the uniform
+ * @param size The number of array elements
+ * @param location The location of the uniform
+ * @param blockIndex The uniform block the uniform is a member of, -1 if none
+ * @param offset The offset of the uniform in its block, -1 if not in a block
+ * 
+ * @returns void
+ */
+void Shader::addUniform(const std::string &name, GLenum type, GLint size, GLint location, GLint blockIndex, GLint offset) {
+    uniformIndices[name] = (int)uniforms.size();
+    uniforms.push_back({name, type, size, location, blockIndex, offset});
 }
\ No newline at end of file
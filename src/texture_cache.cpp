@@ -0,0 +1,191 @@
+#include <texture_cache.h>
+#include <thread_pool.h>
+#include <material_table.h>
+#include <texture_streamer.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+// Read by Acquire on worker threads while the render thread switches it
+static std::atomic<bool> compressedEnabled{true};
+
+// Weak references to the textures in use, keyed by canonical path
+static std::mutex& getCacheMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::unordered_map<std::string, std::weak_ptr<CachedTexture>>& getCacheEntries() {
+    static std::unordered_map<std::string, std::weak_ptr<CachedTexture>> entries;
+    return entries;
+}
+
+/**
+ * Gets the pool that decodes textures for all models. It is separate
+ * from the pools loading models so that a model import waiting for its
+ * textures never blocks the decoding.
+ *
+ * @returns The texture decoding pool
+ */
+static ThreadPool& getDecodePool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+/**
+ * Gets the shared texture of an image file. If a compressed file with the
+ * same name is next to the image it is used instead, falling back to the
+ * image if the compressed file can't be read. Paths are made
+ * canonical, so different relative paths to the same file share a
+ * texture. If the file is not in use, a new entry is created and
+ * decoding of the file starts on the decoding pool. While streaming is
+ * enabled the decoded image is reduced to the level it starts at.
+ *
+ * @param imageFilename The path to the image file
+ *
+ * @returns The shared texture, it is freed when the last reference goes away
+ */
+std::shared_ptr<CachedTexture> TextureCache::Acquire(const std::string& imageFilename) {
+    std::string filename = imageFilename;
+    if (compressedEnabled && !CompressedTexture::IsCompressedFile(filename)) {
+        std::string compressedFilename = CompressedTexture::FindCompressedFile(filename);
+        if (!compressedFilename.empty()) {
+            filename = compressedFilename;
+        }
+    }
+
+    std::error_code error;
+    std::string key = std::filesystem::weakly_canonical(filename, error).generic_string();
+    if (error) {
+        key = filename;
+    }
+
+    std::lock_guard<std::mutex> lock(getCacheMutex());
+    std::weak_ptr<CachedTexture>& entry = getCacheEntries()[key];
+    std::shared_ptr<CachedTexture> texture = entry.lock();
+    if (!texture) {
+        texture = std::shared_ptr<CachedTexture>(new CachedTexture(), release);
+        texture->path = key;
+        bool streamed = TextureStreamer::IsEnabled();
+        texture->decoding = getDecodePool().Submit([filename, imageFilename, streamed]() {
+            std::string decodedFilename = filename;
+            ImageData image = Decode(filename);
+            if (!image.pixels && !image.compressed && filename != imageFilename) {
+                decodedFilename = imageFilename;
+                image = Decode(imageFilename);
+            }
+            if (streamed) {
+                TextureStreamer::PrepareImage(image, decodedFilename);
+            }
+            return image;
+        });
+        entry = texture;
+    }
+    return texture;
+}
+
+/**
+ * Takes ownership of a texture that was made on the render thread rather
+ * than loaded from a file, such as a texture array of packed textures.
+ * The texture is not in the cache and is never shared through Acquire,
+ * it is deleted like other textures when the last reference goes away.
+ *
+ * @param id The uploaded texture
+ *
+ * @returns The owning texture
+ */
+std::shared_ptr<CachedTexture> TextureCache::Adopt(unsigned int id) {
+    std::shared_ptr<CachedTexture> texture(new CachedTexture(), release);
+    texture->id = GLTexture(id);
+    texture->decoded = true;
+    texture->uploaded = true;
+    return texture;
+}
+
+/**
+ * Gets the number of textures in the cache that are in use by a model.
+ *
+ * @returns The number of textures
+ */
+size_t TextureCache::GetTextureCount() {
+    std::lock_guard<std::mutex> lock(getCacheMutex());
+    return getCacheEntries().size();
+}
+
+/**
+ * Decodes an image file into memory. KTX2 and DDS files are mapped and
+ * their blocks are uploaded as they are, other files are decoded to
+ * pixels with stb_image.
+ *
+ * @param filename The path to the image file
+ *
+ * @returns The decoded image, without pixels if decoding failed
+ */
+ImageData TextureCache::Decode(const std::string& filename) {
+    auto start = std::chrono::steady_clock::now();
+    ImageData image;
+    if (CompressedTexture::IsCompressedFile(filename)) {
+        image.compressed = std::make_unique<CompressedTexture>();
+        if (image.compressed->Open(filename)) {
+            image.width = image.compressed->GetWidth();
+            image.height = image.compressed->GetHeight();
+        } else {
+            image.compressed.reset();
+        }
+    } else {
+        image.pixels.reset(stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0));
+    }
+    auto end = std::chrono::steady_clock::now();
+    image.decodeMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+    return image;
+}
+
+/**
+ * Enables or disables loading compressed KTX2 and DDS files in place of
+ * the images next to them. Only affects textures acquired afterwards.
+ *
+ * @param enabled true to prefer compressed files, false to always decode images
+ *
+ * @returns void
+ */
+void TextureCache::SetCompressedEnabled(bool enabled) {
+    compressedEnabled = enabled;
+}
+
+/**
+ * Checks if compressed files are loaded in place of images.
+ *
+ * @returns true if compressed files are preferred, false otherwise
+ */
+bool TextureCache::IsCompressedEnabled() {
+    return compressedEnabled;
+}
+
+/**
+ * Deleter of the shared textures. The entry is only removed from the
+ * cache if it has not been replaced by a new texture for the same path
+ * in the meantime. Textures that were uploaded must be released on the
+ * render thread.
+ *
+ * @param texture The texture that is no longer used
+ *
+ * @returns void
+ */
+void TextureCache::release(CachedTexture* texture) {
+    {
+        std::lock_guard<std::mutex> lock(getCacheMutex());
+        auto& entries = getCacheEntries();
+        auto entry = entries.find(texture->path);
+        if (entry != entries.end() && entry->second.expired()) {
+            entries.erase(entry);
+        }
+    }
+    if (texture->uploaded) {
+        MaterialTable::ReleaseTexture(texture->id);
+        TextureStreamer::ReleaseTexture(texture->id);
+    }
+    delete texture;
+}
@@ -0,0 +1,340 @@
+#include <texture_packer.h>
+#include <material_table.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <utility>
+
+static bool packingEnabled = false;
+
+// Size and format of an uploaded texture, the width is 0 for textures
+// without storage
+struct TextureInfo {
+    GLint width = 0;
+    GLint height = 0;
+    GLint internalFormat = 0;
+    GLint levels = 0;
+    GLint compressed = GL_FALSE;
+};
+
+// Where a material is placed in the atlases of its group
+struct AtlasPlacement {
+    size_t material;
+    size_t atlas;
+    int x;
+    int y;
+};
+
+/**
+ * Reads the size and format of an uploaded texture.
+ *
+ * @param texture The texture to describe, 0 for an image that failed to load
+ *
+ * @returns The size and format of the texture, a width of 0 for texture 0
+ */
+static TextureInfo describeTexture(GLuint texture) {
+    TextureInfo info;
+    if (!texture) {
+        return info;
+    }
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &info.width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &info.height);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &info.internalFormat);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_COMPRESSED, &info.compressed);
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &info.levels);
+    if (info.levels == 0) {
+        info.width = 0;
+    }
+    return info;
+}
+
+/**
+ * Checks if a texture is small enough to be packed.
+ *
+ * @param info The size of the texture
+ *
+ * @returns true if the texture can be packed, false otherwise
+ */
+static bool isPackable(const TextureInfo& info) {
+    return info.width > 0 && info.width <= MAX_PACKED_TEXTURE_SIZE && info.height <= MAX_PACKED_TEXTURE_SIZE;
+}
+
+/**
+ * Rounds a size up so that rectangles in an atlas start on whole texels
+ * of its smallest mip level.
+ *
+ * @param size The size to round
+ *
+ * @returns The rounded size
+ */
+static int alignToAtlas(int size) {
+    int alignment = 1 << (ATLAS_LEVELS - 1);
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Copies the first level of a texture into an atlas and fills the gutter
+ * around it with its edge pixels. The columns left and right of the
+ * texture are copied first, then the rows above and below are copied
+ * over the full width so that they include the corners.
+ *
+ * @param texture The texture to copy
+ * @param info The size of the texture
+ * @param atlas The atlas to copy into
+ * @param x The left of the rectangle of the texture with its gutter
+ * @param y The bottom of the rectangle of the texture with its gutter
+ *
+ * @returns void
+ */
+static void copyIntoAtlas(GLuint texture, const TextureInfo& info, GLuint atlas, int x, int y) {
+    int width = info.width;
+    int height = info.height;
+    int left = x + ATLAS_GUTTER;
+    int bottom = y + ATLAS_GUTTER;
+    glCopyImageSubData(texture, GL_TEXTURE_2D, 0, 0, 0, 0, atlas, GL_TEXTURE_2D, 0, left, bottom, 0, width, height, 1);
+    for (int i = 0; i < ATLAS_GUTTER; i++) {
+        glCopyImageSubData(texture, GL_TEXTURE_2D, 0, 0, 0, 0, atlas, GL_TEXTURE_2D, 0, x + i, bottom, 0, 1, height, 1);
+        glCopyImageSubData(texture, GL_TEXTURE_2D, 0, width - 1, 0, 0,
+            atlas, GL_TEXTURE_2D, 0, left + width + i, bottom, 0, 1, height, 1);
+    }
+    int fullWidth = width + 2 * ATLAS_GUTTER;
+    for (int i = 0; i < ATLAS_GUTTER; i++) {
+        glCopyImageSubData(atlas, GL_TEXTURE_2D, 0, x, bottom, 0, atlas, GL_TEXTURE_2D, 0, x, y + i, 0, fullWidth, 1, 1);
+        glCopyImageSubData(atlas, GL_TEXTURE_2D, 0, x, bottom + height - 1, 0,
+            atlas, GL_TEXTURE_2D, 0, x, bottom + height + i, 0, fullWidth, 1, 1);
+    }
+}
+
+/**
+ * Packs the textures of materials. Small textures that share their size,
+ * format and mip count with another texture are copied into the layers
+ * of a texture array. Materials whose textures are left are packed into
+ * atlases if all their textures are small, uncompressed and of the same
+ * size, and their meshes keep their texture coordinates within [0, 1].
+ * Materials are grouped by the formats of their textures and placed on
+ * shelves, tallest first, with one atlas per texture of the materials.
+ * Atlases that would hold a single material are not made. The original
+ * textures are left untouched.
+ *
+ * @param materials The materials to pack, their textures are replaced by the packed ones
+ * @param stats_out Output for the counters of the packing
+ *
+ * @returns The texture arrays and atlases that were created
+ */
+std::vector<GLuint> TexturePacker::Pack(std::vector<PackedMaterial>& materials, TexturePackingStats& stats_out) {
+    stats_out = TexturePackingStats();
+    stats_out.bindsBefore = CountBinds(materials);
+    std::vector<GLuint> created;
+
+    std::map<GLuint, TextureInfo> infos;
+    for (const auto& material : materials) {
+        for (const auto& texture : material.textures) {
+            if (texture.layer < 0 && infos.find(texture.id) == infos.end()) {
+                infos[texture.id] = describeTexture(texture.id);
+            }
+        }
+    }
+
+    // Textures of the same kind become the layers of an array
+    std::map<std::tuple<GLint, GLint, GLint, GLint>, std::vector<GLuint>> groups;
+    for (const auto& entry : infos) {
+        const TextureInfo& info = entry.second;
+        if (isPackable(info)) {
+            groups[std::make_tuple(info.width, info.height, info.internalFormat, info.levels)].push_back(entry.first);
+        }
+    }
+    std::map<GLuint, std::pair<GLuint, int>> layers;
+    for (const auto& group : groups) {
+        const std::vector<GLuint>& textures = group.second;
+        if (textures.size() < 2) {
+            continue;
+        }
+        const TextureInfo& info = infos[textures[0]];
+        GLuint array;
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+        glTextureStorage3D(array, info.levels, info.internalFormat, info.width, info.height, textures.size());
+        for (size_t layer = 0; layer < textures.size(); layer++) {
+            for (GLint level = 0; level < info.levels; level++) {
+                glCopyImageSubData(textures[layer], GL_TEXTURE_2D, level, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                    std::max(info.width >> level, 1), std::max(info.height >> level, 1), 1);
+            }
+            layers[textures[layer]] = std::make_pair(array, (int)layer);
+        }
+        created.push_back(array);
+        stats_out.arrays++;
+        stats_out.arrayLayers += textures.size();
+    }
+
+    // Materials of textures with a size of their own go into atlases
+    std::map<std::vector<GLint>, std::vector<size_t>> atlasGroups;
+    for (size_t i = 0; i < materials.size(); i++) {
+        const PackedMaterial& material = materials[i];
+        bool packable = material.unitTexCoords && !material.textures.empty();
+        std::vector<GLint> formats;
+        for (size_t t = 0; t < material.textures.size() && packable; t++) {
+            const Texture& texture = material.textures[t];
+            if (texture.layer >= 0 || layers.find(texture.id) != layers.end()) {
+                packable = false;
+                break;
+            }
+            const TextureInfo& info = infos[texture.id];
+            const TextureInfo& first = infos[material.textures[0].id];
+            packable = isPackable(info) && !info.compressed && info.width == first.width && info.height == first.height;
+            formats.push_back(info.internalFormat);
+        }
+        if (packable) {
+            atlasGroups[formats].push_back(i);
+        }
+    }
+
+    for (auto& group : atlasGroups) {
+        std::vector<size_t>& members = group.second;
+        std::stable_sort(members.begin(), members.end(), [&](size_t a, size_t b) {
+            return infos[materials[a].textures[0].id].height > infos[materials[b].textures[0].id].height;
+        });
+
+        // Place the materials on shelves, starting a new atlas when one is full
+        std::vector<AtlasPlacement> placements;
+        std::vector<glm::ivec2> atlasSizes;
+        int x = 0;
+        int y = 0;
+        int shelfHeight = 0;
+        for (size_t index : members) {
+            const TextureInfo& info = infos[materials[index].textures[0].id];
+            int width = alignToAtlas(info.width + 2 * ATLAS_GUTTER);
+            int height = alignToAtlas(info.height + 2 * ATLAS_GUTTER);
+            if (x + width > ATLAS_WIDTH) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (atlasSizes.empty() || y + height > ATLAS_WIDTH) {
+                atlasSizes.push_back(glm::ivec2(0));
+                x = 0;
+                y = 0;
+                shelfHeight = 0;
+            }
+            placements.push_back({index, atlasSizes.size() - 1, x, y});
+            x += width;
+            shelfHeight = std::max(shelfHeight, height);
+            atlasSizes.back() = glm::max(atlasSizes.back(), glm::ivec2(x, y + height));
+        }
+
+        std::vector<int> materialCounts(atlasSizes.size(), 0);
+        for (const auto& placement : placements) {
+            materialCounts[placement.atlas]++;
+        }
+        std::vector<std::vector<GLuint>> atlases(atlasSizes.size());
+        for (size_t a = 0; a < atlasSizes.size(); a++) {
+            if (materialCounts[a] < 2) {
+                continue;
+            }
+            for (GLint format : group.first) {
+                GLuint atlas;
+                glCreateTextures(GL_TEXTURE_2D, 1, &atlas);
+                glTextureStorage2D(atlas, ATLAS_LEVELS, format, atlasSizes[a].x, atlasSizes[a].y);
+                glClearTexImage(atlas, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                atlases[a].push_back(atlas);
+                created.push_back(atlas);
+                stats_out.atlases++;
+            }
+        }
+
+        for (const auto& placement : placements) {
+            if (materialCounts[placement.atlas] < 2) {
+                continue;
+            }
+            PackedMaterial& material = materials[placement.material];
+            TextureInfo info = infos[material.textures[0].id];
+            for (size_t t = 0; t < material.textures.size(); t++) {
+                copyIntoAtlas(material.textures[t].id, info, atlases[placement.atlas][t], placement.x, placement.y);
+                material.textures[t].id = atlases[placement.atlas][t];
+                stats_out.atlasTextures++;
+            }
+            glm::vec2 size = glm::vec2(atlasSizes[placement.atlas]);
+            material.uvTransform = glm::vec4(
+                info.width / size.x, info.height / size.y,
+                (placement.x + ATLAS_GUTTER) / size.x, (placement.y + ATLAS_GUTTER) / size.y);
+        }
+        for (const auto& textures : atlases) {
+            for (GLuint atlas : textures) {
+                glGenerateTextureMipmap(atlas);
+            }
+        }
+    }
+
+    for (auto& material : materials) {
+        for (auto& texture : material.textures) {
+            auto layer = layers.find(texture.id);
+            if (texture.layer < 0 && layer != layers.end()) {
+                texture.id = layer->second.first;
+                texture.layer = layer->second.second;
+            }
+        }
+    }
+    stats_out.bindsAfter = CountBinds(materials);
+    return created;
+}
+
+/**
+ * Counts the texture binds needed to draw every material once, with the
+ * materials sorted by their textures and binds of a texture that is
+ * already bound skipped. Array textures are bound to units of their own.
+ *
+ * @param materials The materials to draw
+ *
+ * @returns The number of texture binds
+ */
+unsigned int TexturePacker::CountBinds(const std::vector<PackedMaterial>& materials) {
+    std::vector<std::vector<std::pair<GLuint, bool>>> sets;
+    for (const auto& material : materials) {
+        std::vector<std::pair<GLuint, bool>> set;
+        for (const auto& texture : material.textures) {
+            set.push_back(std::make_pair(texture.id, texture.layer >= 0));
+        }
+        sets.push_back(set);
+    }
+    std::sort(sets.begin(), sets.end());
+    sets.erase(std::unique(sets.begin(), sets.end()), sets.end());
+
+    unsigned int binds = 0;
+    std::map<std::pair<size_t, bool>, GLuint> bound;
+    for (const auto& set : sets) {
+        for (size_t unit = 0; unit < set.size(); unit++) {
+            GLuint& texture = bound[std::make_pair(unit, set[unit].second)];
+            if (texture != set[unit].first) {
+                texture = set[unit].first;
+                binds++;
+            }
+        }
+    }
+    return binds;
+}
+
+/**
+ * Enables or disables packing the textures of models as they finish
+ * loading. Packed textures need shaders with array samplers. Textures
+ * are not packed while the material table is enabled, since the table
+ * places them itself, a warning is printed if it is.
+ *
+ * @param enabled true to pack textures, false to use them as they are
+ *
+ * @returns void
+ */
+void TexturePacker::SetEnabled(bool enabled) {
+    if (enabled && MaterialTable::GetMode() != MATERIAL_MODE_BINDINGS) {
+        std::cout << "TexturePacker::SetEnabled: textures are not packed while the material table is enabled" << std::endl;
+    }
+    packingEnabled = enabled;
+}
+
+/**
+ * Checks if the textures of models are packed as they finish loading.
+ *
+ * @returns true if packing is enabled, false otherwise
+ */
+bool TexturePacker::IsEnabled() {
+    return packingEnabled;
+}
@@ -0,0 +1,783 @@
+#include <texture_streamer.h>
+#include <thread_pool.h>
+#include <material_table.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Pixels or blocks of the levels loaded for a texture, the highest first
+typedef std::vector<std::vector<unsigned char>> LoadedLevels;
+
+// A texture whose levels are streamed. Levels from residentLevel down to
+// the smallest are resident, the texture never drops below startLevel.
+struct StreamedTexture {
+    std::string filename;
+    bool compressed = false;
+    GLenum internalFormat = 0;
+    GLenum format = 0;
+    int width = 0;
+    int height = 0;
+    int levelCount = 0;
+    int startLevel = 0;
+    int residentLevel = 0;
+    int requestedLevel = 0;
+    uint64_t requestFrame = 0;
+    bool loading = false;
+    std::vector<size_t> levelSizes;
+};
+
+// Header of the file next to a streamed image holding the levels above
+// its start level, the first level first, so that levels can be loaded
+// without decoding the image again. The file is stale when the size or
+// modification time of the image changes.
+struct MipFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    int32_t width;
+    int32_t height;
+    int32_t components;
+    int32_t levelCount;
+};
+
+// Identifier and version of mip files
+const uint32_t MIP_FILE_MAGIC = 0x50494D4F;
+const uint32_t MIP_FILE_VERSION = 1;
+
+// Levels being loaded on the streaming thread, firstLevel is the highest
+struct LevelLoad {
+    GLuint texture;
+    int firstLevel;
+    int lastLevel;
+    size_t bytes;
+    std::future<LoadedLevels> levels;
+};
+
+// Read by texture loads on worker threads while the render thread switches it
+static std::atomic<bool> streamingEnabled{false};
+static size_t budget = DEFAULT_STREAMING_BUDGET;
+static std::unordered_map<GLuint, StreamedTexture> textures;
+static std::vector<LevelLoad> loads;
+static uint64_t frame = 1;
+static StreamingStats stats;
+
+/**
+ * Gets the thread that loads levels. A single thread keeps the loads in
+ * the order they were started and leaves the other cores to decoding.
+ *
+ * @returns The streaming pool
+ */
+static ThreadPool& getStreamingPool() {
+    static ThreadPool pool(1);
+    return pool;
+}
+
+/**
+ * Gets the size of a level along one side.
+ *
+ * @param size The size of the first level
+ * @param level The level
+ *
+ * @returns The size of the level, at least 1
+ */
+static int levelExtent(int size, int level) {
+    return std::max(1, size >> level);
+}
+
+/**
+ * Halves an image with a box filter. Odd sizes repeat their last row or
+ * column, so every level matches the size GL expects.
+ *
+ * @param pixels The pixels of the image
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param components The bytes per pixel
+ * @param pixels_out Output for the pixels of the halved image
+ *
+ * @returns void
+ */
+static void halveImage(const unsigned char* pixels, int width, int height, int components, unsigned char* pixels_out) {
+    int halfWidth = std::max(1, width / 2);
+    int halfHeight = std::max(1, height / 2);
+    for (int y = 0; y < halfHeight; y++) {
+        int y0 = std::min(2 * y, height - 1);
+        int y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < halfWidth; x++) {
+            int x0 = std::min(2 * x, width - 1);
+            int x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < components; c++) {
+                int sum = pixels[((size_t)y0 * width + x0) * components + c] +
+                    pixels[((size_t)y0 * width + x1) * components + c] +
+                    pixels[((size_t)y1 * width + x0) * components + c] +
+                    pixels[((size_t)y1 * width + x1) * components + c];
+                pixels_out[((size_t)y * halfWidth + x) * components + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+/**
+ * Gets the path of the mip file of an image.
+ *
+ * @param filename The file of the image
+ *
+ * @returns The path of the mip file, next to the image
+ */
+static std::string getMipPath(const std::string& filename) {
+    return filename + ".ogemips";
+}
+
+/**
+ * Fills in a mip file header for the current state of an image file.
+ *
+ * @param filename The file of the image
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param components The bytes per pixel
+ * @param levelCount The number of levels in the mip file
+ * @param header_out Output for the header
+ *
+ * @returns true if the size and time of the image could be read, false otherwise
+ */
+static bool makeMipHeader(const std::string& filename, int width, int height, int components, int levelCount,
+    MipFileHeader& header_out) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(filename, error);
+    if (error) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(filename, error);
+    if (error) {
+        return false;
+    }
+    header_out = {};
+    header_out.magic = MIP_FILE_MAGIC;
+    header_out.version = MIP_FILE_VERSION;
+    header_out.sourceSize = size;
+    header_out.sourceTime = (int64_t)time.time_since_epoch().count();
+    header_out.width = width;
+    header_out.height = height;
+    header_out.components = components;
+    header_out.levelCount = levelCount;
+    return true;
+}
+
+/**
+ * Checks if a mapped mip file was written for an image as it is now and
+ * holds all of its levels.
+ *
+ * @param file The mapped mip file
+ * @param expected The header the file must have
+ *
+ * @returns true if the file is current, false otherwise
+ */
+static bool isMipFileCurrent(const MappedFile& file, const MipFileHeader& expected) {
+    if (file.GetSize() < sizeof(MipFileHeader) || memcmp(file.GetData(), &expected, sizeof(MipFileHeader)) != 0) {
+        return false;
+    }
+    size_t size = sizeof(MipFileHeader);
+    for (int i = 0; i < expected.levelCount; i++) {
+        size += (size_t)levelExtent(expected.width, i) * levelExtent(expected.height, i) * expected.components;
+    }
+    return file.GetSize() == size;
+}
+
+/**
+ * Writes the levels above the start level of an image to its mip file,
+ * unless the file is already current. Failing to write only means the
+ * levels are decoded from the image again when they are loaded.
+ *
+ * @param header The header of the file
+ * @param filename The file of the image
+ * @param levels The levels from the first level down
+ *
+ * @returns void
+ */
+static void writeMipFile(const MipFileHeader& header, const std::string& filename, const LoadedLevels& levels) {
+    std::string path = getMipPath(filename);
+    {
+        MappedFile file;
+        if (file.Open(path) && isMipFileCurrent(file, header)) {
+            return;
+        }
+    }
+    std::error_code error;
+    std::string temporaryPath = MappedFile::GetTemporaryPath(path);
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        out.write((const char*)&header, sizeof(header));
+        for (const auto& level : levels) {
+            out.write((const char*)level.data(), level.size());
+        }
+        if (!out) {
+            out.close();
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
+/**
+ * Copies levels of a streamed image out of its mip file.
+ *
+ * @param filename The file of the image
+ * @param firstLevel The highest level to load
+ * @param lastLevel The lowest level to load
+ * @param levels_out Output for the levels from firstLevel to lastLevel
+ *
+ * @returns true if the mip file is current and holds the levels, false otherwise
+ */
+static bool readMipFile(const std::string& filename, int firstLevel, int lastLevel, LoadedLevels& levels_out) {
+    MappedFile file;
+    if (!file.Open(getMipPath(filename)) || file.GetSize() < sizeof(MipFileHeader)) {
+        return false;
+    }
+    MipFileHeader stored;
+    memcpy(&stored, file.GetData(), sizeof(stored));
+    MipFileHeader expected;
+    if (!makeMipHeader(filename, stored.width, stored.height, stored.components, stored.levelCount, expected) ||
+        !isMipFileCurrent(file, expected) || lastLevel >= stored.levelCount) {
+        return false;
+    }
+    size_t offset = sizeof(MipFileHeader);
+    for (int i = 0; i <= lastLevel; i++) {
+        size_t size = (size_t)levelExtent(stored.width, i) * levelExtent(stored.height, i) * stored.components;
+        if (i >= firstLevel) {
+            levels_out.emplace_back(file.GetData() + offset, file.GetData() + offset + size);
+        }
+        offset += size;
+    }
+    return true;
+}
+
+/**
+ * Gets the level an image starts at when it is streamed, the first
+ * level no larger than STREAMING_START_SIZE.
+ *
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param levelCount The number of levels of the image
+ *
+ * @returns The start level, 0 if the image is too small to be streamed
+ */
+static int getStartLevel(int width, int height, int levelCount) {
+    int level = 0;
+    while (level + 1 < levelCount && std::max(levelExtent(width, level), levelExtent(height, level)) > STREAMING_START_SIZE) {
+        level++;
+    }
+    return level;
+}
+
+/**
+ * Gets the formats of an uncompressed image.
+ *
+ * @param components The bytes per pixel
+ * @param internalFormat_out Output for the internal format
+ * @param format_out Output for the pixel format
+ *
+ * @returns void
+ */
+static void getPixelFormats(int components, GLenum& internalFormat_out, GLenum& format_out) {
+    internalFormat_out = GL_RGBA8;
+    format_out = GL_RGBA;
+    if (components == 1) {
+        internalFormat_out = GL_R8;
+        format_out = GL_RED;
+    } else if (components == 2) {
+        internalFormat_out = GL_RG8;
+        format_out = GL_RG;
+    } else if (components == 3) {
+        internalFormat_out = GL_RGB8;
+        format_out = GL_RGB;
+    }
+}
+
+/**
+ * Loads levels of a texture from its file, on the streaming thread.
+ * Compressed files are mapped and the blocks of the levels copied out.
+ * The levels of images are copied out of the mip file written when the
+ * image was prepared, only without a current mip file is the image
+ * decoded again and halved down to the last level.
+ *
+ * @param filename The file of the texture
+ * @param compressed true if the file is KTX2 or DDS
+ * @param firstLevel The highest level to load
+ * @param lastLevel The lowest level to load
+ *
+ * @returns The levels from firstLevel to lastLevel, empty if the file can't be read
+ */
+static LoadedLevels loadLevels(const std::string& filename, bool compressed, int firstLevel, int lastLevel) {
+    LoadedLevels levels;
+    if (compressed) {
+        CompressedTexture file;
+        if (!file.Open(filename) || lastLevel >= (int)file.GetLevelCount()) {
+            return levels;
+        }
+        for (int i = firstLevel; i <= lastLevel; i++) {
+            const unsigned char* data = (const unsigned char*)file.GetLevelData(i);
+            levels.emplace_back(data, data + file.GetLevel(i).size);
+        }
+        return levels;
+    }
+    if (readMipFile(filename, firstLevel, lastLevel, levels)) {
+        return levels;
+    }
+
+    int width, height, components;
+    std::unique_ptr<unsigned char, void (*)(void*)> pixels(
+        stbi_load(filename.c_str(), &width, &height, &components, 0), stbi_image_free);
+    if (!pixels) {
+        return levels;
+    }
+    std::vector<unsigned char> level(pixels.get(), pixels.get() + (size_t)width * height * components);
+    pixels.reset();
+    for (int i = 0; i <= lastLevel; i++) {
+        if (i > 0) {
+            std::vector<unsigned char> half((size_t)levelExtent(width, i) * levelExtent(height, i) * components);
+            halveImage(level.data(), levelExtent(width, i - 1), levelExtent(height, i - 1), components, half.data());
+            level.swap(half);
+        }
+        if (i >= firstLevel) {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+/**
+ * Specifies a level of a streamed texture, which must be bound to
+ * GL_TEXTURE_2D. A level without data and of size 0 frees its memory.
+ *
+ * @param texture The streamed texture
+ * @param level The level to specify
+ * @param data The pixels or blocks of the level, nullptr to free it
+ *
+ * @returns void
+ */
+static void specifyLevel(const StreamedTexture& texture, int level, const void* data) {
+    GLsizei width = data ? levelExtent(texture.width, level) : 0;
+    GLsizei height = data ? levelExtent(texture.height, level) : 0;
+    if (texture.compressed) {
+        GLsizei size = data ? (GLsizei)texture.levelSizes[level] : 0;
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, width, height, 0, size, data);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, width, height, 0,
+            texture.format, GL_UNSIGNED_BYTE, data);
+    }
+}
+
+/**
+ * Gets the estimated size of the resident levels of a texture.
+ *
+ * @param texture The streamed texture
+ *
+ * @returns The size in bytes
+ */
+static size_t getResidentBytes(const StreamedTexture& texture) {
+    size_t bytes = 0;
+    for (int i = texture.residentLevel; i < texture.levelCount; i++) {
+        bytes += texture.levelSizes[i];
+    }
+    return bytes;
+}
+
+/**
+ * Frees the highest resident level of a texture.
+ *
+ * @param id The texture
+ * @param texture The streamed texture
+ *
+ * @returns void
+ */
+static void evictLevel(GLuint id, StreamedTexture& texture) {
+    int level = texture.residentLevel;
+    texture.residentLevel++;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.residentLevel);
+    specifyLevel(texture, level, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    stats.residentBytes -= texture.levelSizes[level];
+    stats.evictions++;
+}
+
+/**
+ * Evicts top levels, least recently requested texture first, until the
+ * resident and pending levels fit in the budget with room for more.
+ * Textures requested this frame are only evicted if allowed.
+ *
+ * @param room The bytes that must fit in the budget besides the current levels
+ * @param reserved The bytes of the loads in flight
+ * @param evictRequested true to also evict textures requested this frame
+ *
+ * @returns true if everything fits, false if nothing more can be evicted
+ */
+static bool evictToFit(size_t room, size_t reserved, bool evictRequested) {
+    while (stats.residentBytes + reserved + room > budget) {
+        GLuint oldestID = 0;
+        StreamedTexture* oldest = nullptr;
+        for (auto& entry : textures) {
+            StreamedTexture& texture = entry.second;
+            if (texture.loading || texture.residentLevel >= texture.startLevel ||
+                (!evictRequested && texture.requestFrame == frame)) {
+                continue;
+            }
+            if (!oldest || texture.requestFrame < oldest->requestFrame) {
+                oldestID = entry.first;
+                oldest = &texture;
+            }
+        }
+        if (!oldest) {
+            return false;
+        }
+        evictLevel(oldestID, *oldest);
+    }
+    return true;
+}
+
+/**
+ * Enables or disables streaming. Only textures decoded afterwards are
+ * streamed, textures already uploaded keep how they were loaded. Streaming
+ * only applies while the material table is disabled, since its handles
+ * and arrays need immutable textures, a warning is printed if it is
+ * enabled.
+ *
+ * @param enabled true to stream new textures, false to load them whole
+ *
+ * @returns void
+ */
+void TextureStreamer::SetEnabled(bool enabled) {
+    if (enabled && MaterialTable::GetMode() != MATERIAL_MODE_BINDINGS) {
+        std::cout << "TextureStreamer::SetEnabled: textures are not streamed while the material table is enabled" << std::endl;
+    }
+    streamingEnabled = enabled;
+}
+
+/**
+ * Checks if textures decoded from now on are streamed.
+ *
+ * @returns true if streaming is enabled and textures are bound per mesh, false otherwise
+ */
+bool TextureStreamer::IsEnabled() {
+    return streamingEnabled && MaterialTable::GetMode() == MATERIAL_MODE_BINDINGS;
+}
+
+/**
+ * Sets the budget of the resident levels of all streamed textures. The
+ * levels textures start at are always resident and may exceed it on
+ * their own. Levels over a lowered budget are evicted in the next update.
+ *
+ * @param bytes The budget in bytes
+ *
+ * @returns void
+ */
+void TextureStreamer::SetBudget(size_t bytes) {
+    budget = bytes;
+}
+
+/**
+ * Gets the budget of the resident levels of streamed textures.
+ *
+ * @returns The budget in bytes
+ */
+size_t TextureStreamer::GetBudget() {
+    return budget;
+}
+
+/**
+ * Reduces a decoded image to the level its texture starts at, the first
+ * level no larger than STREAMING_START_SIZE, and remembers the file the
+ * higher levels are loaded from. Images are halved with a box filter and
+ * the levels above the start level are written to a mip file next to the
+ * image, unless it is already current, so that streaming never decodes
+ * the image again. Compressed images keep their mapped file and only
+ * have their level recorded. Images already small enough are left as they are and are
+ * not streamed. Makes no GL calls.
+ *
+ * @param image The decoded image, its width and height stay those of the full image
+ * @param filename The file the image was decoded from
+ *
+ * @returns void
+ */
+void TextureStreamer::PrepareImage(ImageData& image, const std::string& filename) {
+    int levelCount = 1;
+    if (image.compressed) {
+        levelCount = image.compressed->GetLevelCount();
+    } else if (image.pixels) {
+        for (int extent = std::max(image.width, image.height); extent > 1; extent /= 2) {
+            levelCount++;
+        }
+    } else {
+        return;
+    }
+    int startLevel = getStartLevel(image.width, image.height, levelCount);
+    if (startLevel == 0) {
+        return;
+    }
+
+    if (image.pixels) {
+        LoadedLevels levels;
+        levels.emplace_back(image.pixels.get(),
+            image.pixels.get() + (size_t)image.width * image.height * image.components);
+        for (int i = 1; i <= startLevel; i++) {
+            std::vector<unsigned char> half((size_t)levelExtent(image.width, i) * levelExtent(image.height, i) * image.components);
+            halveImage(levels.back().data(), levelExtent(image.width, i - 1), levelExtent(image.height, i - 1),
+                image.components, half.data());
+            levels.push_back(std::move(half));
+        }
+        std::vector<unsigned char> level = std::move(levels.back());
+        levels.pop_back();
+        MipFileHeader header;
+        if (makeMipHeader(filename, image.width, image.height, image.components, startLevel, header)) {
+            writeMipFile(header, filename, levels);
+        }
+        unsigned char* pixels = (unsigned char*)malloc(level.size());
+        memcpy(pixels, level.data(), level.size());
+        image.pixels = std::unique_ptr<unsigned char, void (*)(void*)>(pixels, free);
+    }
+    image.streamFilename = filename;
+    image.startLevel = startLevel;
+    image.levelCount = levelCount;
+}
+
+/**
+ * Uploads a prepared image to a texture with mutable storage and starts
+ * streaming it. The start level is the base level, images get the levels
+ * below it generated and compressed images get their stored levels. The
+ * pixels or mapped file of the image are freed. Binds the texture to
+ * GL_TEXTURE_2D of the active unit, so it must not be called while
+ * drawing through a state cache.
+ *
+ * @param texture The new texture without storage
+ * @param image The image prepared by PrepareImage
+ *
+ * @returns void
+ */
+void TextureStreamer::Upload(GLuint texture, ImageData& image) {
+    StreamedTexture streamed;
+    streamed.filename = image.streamFilename;
+    streamed.compressed = image.compressed != nullptr;
+    streamed.width = image.width;
+    streamed.height = image.height;
+    streamed.levelCount = image.levelCount;
+    streamed.startLevel = image.startLevel;
+    streamed.residentLevel = image.startLevel;
+    streamed.requestedLevel = image.startLevel;
+    if (streamed.compressed) {
+        streamed.internalFormat = image.compressed->GetFormat();
+        for (int i = 0; i < streamed.levelCount; i++) {
+            streamed.levelSizes.push_back(image.compressed->GetLevel(i).size);
+        }
+    } else {
+        getPixelFormats(image.components, streamed.internalFormat, streamed.format);
+        for (int i = 0; i < streamed.levelCount; i++) {
+            streamed.levelSizes.push_back((size_t)levelExtent(streamed.width, i) * levelExtent(streamed.height, i) * image.components);
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, streamed.startLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, streamed.levelCount - 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (streamed.compressed) {
+        for (int i = streamed.startLevel; i < streamed.levelCount; i++) {
+            specifyLevel(streamed, i, image.compressed->GetLevelData(i));
+        }
+    } else {
+        specifyLevel(streamed, streamed.startLevel, image.pixels.get());
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    image.pixels.reset();
+    image.compressed.reset();
+
+    stats.residentBytes += getResidentBytes(streamed);
+    textures[texture] = std::move(streamed);
+}
+
+/**
+ * Requests a streamed texture for this frame. The texture is wanted at
+ * the largest level no smaller than the size, several requests in a frame
+ * keep the largest. Textures that are not streamed are ignored.
+ *
+ * @param texture The texture
+ * @param screenSize The size in pixels the texture covers on screen
+ *
+ * @returns void
+ */
+void TextureStreamer::Request(GLuint texture, float screenSize) {
+    auto found = textures.find(texture);
+    if (found == textures.end()) {
+        return;
+    }
+    StreamedTexture& streamed = found->second;
+    if (streamed.requestFrame != frame) {
+        streamed.requestFrame = frame;
+        streamed.requestedLevel = streamed.startLevel;
+    }
+    int level = streamed.requestedLevel;
+    while (level > 0 && std::max(levelExtent(streamed.width, level), levelExtent(streamed.height, level)) < screenSize) {
+        level--;
+    }
+    streamed.requestedLevel = level;
+}
+
+/**
+ * Brings the streamed textures up to date with the requests of the
+ * frame. Loaded levels are uploaded and become the base level, levels
+ * over the budget are evicted from the least recently requested textures,
+ * and textures requested above their resident level start loading. A
+ * load takes all missing levels at once, or as many of them as the
+ * budget has room for after evicting textures not requested this frame.
+ * At most MAX_STREAMING_LOADS loads are in flight, the textures missing
+ * the most levels go first. Binds textures to GL_TEXTURE_2D of the active
+ * unit, so it must be called outside of drawing.
+ *
+ * @returns void
+ */
+void TextureStreamer::Update() {
+    stats.levelsLoaded = 0;
+    stats.evictions = 0;
+
+    // Upload finished loads
+    size_t reserved = 0;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < loads.size();) {
+        LevelLoad& load = loads[i];
+        if (load.levels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            reserved += load.bytes;
+            i++;
+            continue;
+        }
+        LoadedLevels levels = load.levels.get();
+        StreamedTexture& texture = textures[load.texture];
+        texture.loading = false;
+        if (levels.size() == (size_t)(load.lastLevel - load.firstLevel + 1)) {
+            glBindTexture(GL_TEXTURE_2D, load.texture);
+            for (int level = load.lastLevel; level >= load.firstLevel; level--) {
+                specifyLevel(texture, level, levels[level - load.firstLevel].data());
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, load.firstLevel);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            texture.residentLevel = load.firstLevel;
+            stats.residentBytes += load.bytes;
+            stats.levelsLoaded += levels.size();
+        } else {
+            // The file can't be read anymore, stay at the levels there are
+            texture.startLevel = 0;
+            texture.requestedLevel = texture.residentLevel;
+            texture.filename.clear();
+        }
+        loads.erase(loads.begin() + i);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    evictToFit(0, reserved, true);
+
+    // Start loads of the textures wanted above their resident level
+    std::vector<GLuint> wanted;
+    for (const auto& entry : textures) {
+        const StreamedTexture& texture = entry.second;
+        if (texture.requestFrame == frame && texture.requestedLevel < texture.residentLevel && !texture.filename.empty()) {
+            wanted.push_back(entry.first);
+        }
+    }
+    std::sort(wanted.begin(), wanted.end(), [](GLuint a, GLuint b) {
+        const StreamedTexture& first = textures[a];
+        const StreamedTexture& second = textures[b];
+        return first.residentLevel - first.requestedLevel > second.residentLevel - second.requestedLevel;
+    });
+    for (GLuint id : wanted) {
+        StreamedTexture& texture = textures[id];
+        if (texture.loading) {
+            continue;
+        }
+        if (loads.size() >= MAX_STREAMING_LOADS) {
+            break;
+        }
+        int lastLevel = texture.residentLevel - 1;
+        int firstLevel = lastLevel + 1;
+        size_t bytes = 0;
+        while (firstLevel > texture.requestedLevel &&
+                evictToFit(bytes + texture.levelSizes[firstLevel - 1], reserved, false)) {
+            firstLevel--;
+            bytes += texture.levelSizes[firstLevel];
+        }
+        if (firstLevel > lastLevel) {
+            continue;
+        }
+
+        LevelLoad load;
+        load.texture = id;
+        load.firstLevel = firstLevel;
+        load.lastLevel = lastLevel;
+        load.bytes = bytes;
+        std::string filename = texture.filename;
+        bool compressed = texture.compressed;
+        load.levels = getStreamingPool().Submit([filename, compressed, firstLevel, lastLevel]() {
+            return loadLevels(filename, compressed, firstLevel, lastLevel);
+        });
+        loads.push_back(std::move(load));
+        texture.loading = true;
+        reserved += bytes;
+    }
+
+    stats.pendingRequests = 0;
+    for (const auto& entry : textures) {
+        if (entry.second.requestFrame == frame && entry.second.requestedLevel < entry.second.residentLevel) {
+            stats.pendingRequests++;
+        }
+    }
+    stats.budgetBytes = budget;
+    stats.streamedTextures = textures.size();
+    frame++;
+}
+
+/**
+ * Stops streaming a texture, loads of its levels in flight are dropped.
+ * Must be called before the texture is deleted so that its name can be
+ * reused by another texture.
+ *
+ * @param texture The texture that is about to be deleted
+ *
+ * @returns void
+ */
+void TextureStreamer::ReleaseTexture(GLuint texture) {
+    auto found = textures.find(texture);
+    if (found == textures.end()) {
+        return;
+    }
+    stats.residentBytes -= getResidentBytes(found->second);
+    textures.erase(found);
+    loads.erase(std::remove_if(loads.begin(), loads.end(), [texture](const LevelLoad& load) {
+        return load.texture == texture;
+    }), loads.end());
+}
+
+/**
+ * Gets the counters of streaming. Levels loaded and evictions are
+ * counted by the last update, the other counters are current.
+ *
+ * @returns The streaming stats
+ */
+StreamingStats TextureStreamer::GetStats() {
+    StreamingStats current = stats;
+    current.budgetBytes = budget;
+    current.streamedTextures = textures.size();
+    return current;
+}
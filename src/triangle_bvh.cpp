@@ -0,0 +1,323 @@
+#include <triangle_bvh.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cfloat>
+#include <cstring>
+
+// Determinants below this are treated as rays parallel to the triangle
+const float TRIANGLE_EPSILON = 1e-8f;
+
+// Triangles per packet and per leaf of the tree
+const unsigned int PACKET_SIZE = 4;
+
+/**
+ * Tests a ray against a triangle with the Moller-Trumbore algorithm.
+ *
+ * @param rayOrigin The origin of the ray
+ * @param rayDir The direction of the ray
+ * @param v0 The first vertex of the triangle
+ * @param v1 The second vertex of the triangle
+ * @param v2 The third vertex of the triangle
+ * @param distance_out Output for the distance to the hit in units of
+ *                     rayDir, undefined if there's no hit
+ * @param barycentrics_out Output for the barycentric coordinates of the
+ *                         hit relative to v1 and v2
+ * 
+ * @returns true if the ray hits the triangle in front of its origin, false otherwise
+ */
+bool IntersectRayTriangle(
+    const glm::vec3& rayOrigin,
+    const glm::vec3& rayDir,
+    const glm::vec3& v0,
+    const glm::vec3& v1,
+    const glm::vec3& v2,
+    float& distance_out,
+    glm::vec2& barycentrics_out) {
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    glm::vec3 h = glm::cross(rayDir, edge2);
+    float determinant = glm::dot(edge1, h);
+    if (glm::abs(determinant) < TRIANGLE_EPSILON) {
+        return false;
+    }
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = rayOrigin - v0;
+    float u = inverse * glm::dot(s, h);
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = inverse * glm::dot(rayDir, q);
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    float t = inverse * glm::dot(edge2, q);
+    if (t <= 0.0f) {
+        return false;
+    }
+    distance_out = t;
+    barycentrics_out = glm::vec2(u, v);
+    return true;
+}
+
+/**
+ * Tests a ray against the four triangles of a packet and keeps the
+ * nearest hit. With SSE the four triangles are tested at once, otherwise
+ * one by one.
+ *
+ * @param packet The packet to test
+ * @param rayOrigin The origin of the ray
+ * @param rayDir The direction of the ray
+ * @param distance_inout The distance to the nearest hit so far, updated on a nearer hit
+ * @param lane_out Output for the lane of the nearer hit
+ * @param barycentrics_out Output for the barycentric coordinates of the nearer hit
+ * 
+ * @returns true if a hit nearer than distance_inout was found, false otherwise
+ */
+static bool intersectPacket(
+    const TrianglePacket& packet,
+    const glm::vec3& rayOrigin,
+    const glm::vec3& rayDir,
+    float& distance_inout,
+    unsigned int& lane_out,
+    glm::vec2& barycentrics_out) {
+    bool hit = false;
+#if defined(__SSE2__)
+    const __m128 dx = _mm_set1_ps(rayDir.x);
+    const __m128 dy = _mm_set1_ps(rayDir.y);
+    const __m128 dz = _mm_set1_ps(rayDir.z);
+    const __m128 e1x = _mm_loadu_ps(packet.e1x);
+    const __m128 e1y = _mm_loadu_ps(packet.e1y);
+    const __m128 e1z = _mm_loadu_ps(packet.e1z);
+    const __m128 e2x = _mm_loadu_ps(packet.e2x);
+    const __m128 e2y = _mm_loadu_ps(packet.e2y);
+    const __m128 e2z = _mm_loadu_ps(packet.e2z);
+
+    // h = dir x edge2, determinant = edge1 . h
+    __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+    __m128 absDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+    __m128 mask = _mm_cmpge_ps(absDeterminant, _mm_set1_ps(TRIANGLE_EPSILON));
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+    // s = origin - v0, u = (s . h) / determinant
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(rayOrigin.x), _mm_loadu_ps(packet.v0x));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(rayOrigin.y), _mm_loadu_ps(packet.v0y));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(rayOrigin.z), _mm_loadu_ps(packet.v0z));
+    __m128 u = _mm_mul_ps(inverse, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+
+    // q = s x edge1, v = (dir . q) / determinant, t = (edge2 . q) / determinant
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(inverse, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+    __m128 t = _mm_mul_ps(inverse, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+    const __m128 zero = _mm_setzero_ps();
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(distance_inout)));
+    int hits = _mm_movemask_ps(mask);
+    if (hits == 0) {
+        return false;
+    }
+
+    float tLanes[4], uLanes[4], vLanes[4];
+    _mm_storeu_ps(tLanes, t);
+    _mm_storeu_ps(uLanes, u);
+    _mm_storeu_ps(vLanes, v);
+    for (unsigned int lane = 0; lane < PACKET_SIZE; lane++) {
+        if ((hits & (1 << lane)) && tLanes[lane] < distance_inout) {
+            distance_inout = tLanes[lane];
+            lane_out = lane;
+            barycentrics_out = glm::vec2(uLanes[lane], vLanes[lane]);
+            hit = true;
+        }
+    }
+#else
+    for (unsigned int lane = 0; lane < PACKET_SIZE; lane++) {
+        glm::vec3 v0(packet.v0x[lane], packet.v0y[lane], packet.v0z[lane]);
+        glm::vec3 edge1(packet.e1x[lane], packet.e1y[lane], packet.e1z[lane]);
+        glm::vec3 edge2(packet.e2x[lane], packet.e2y[lane], packet.e2z[lane]);
+        float distance;
+        glm::vec2 barycentrics;
+        if (IntersectRayTriangle(rayOrigin, rayDir, v0, v0 + edge1, v0 + edge2, distance, barycentrics) &&
+            distance < distance_inout) {
+            distance_inout = distance;
+            lane_out = lane;
+            barycentrics_out = barycentrics;
+            hit = true;
+        }
+    }
+#endif
+    return hit;
+}
+
+/**
+ * Builds the tree over the triangles of indexed vertices. The tree is
+ * built over the triangle bounds with BVH, then the triangles of each
+ * leaf are copied into packets in leaf order so that traversal reads
+ * them sequentially.
+ *
+ * @param vertices The vertices of the mesh
+ * @param indices The indices of the triangles of the mesh
+ * 
+ * @returns void
+ */
+void TriangleBVH::Build(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    Build(vertices.data(), indices.data(), indices.size());
+}
+
+/**
+ * Builds the tree over the triangles of indexed vertices in memory.
+ *
+ * @param vertices The vertices of the mesh
+ * @param indices The indices of the triangles of the mesh
+ * @param indexCount The number of indices
+ * 
+ * @returns void
+ */
+void TriangleBVH::Build(const Vertex* vertices, const unsigned int* indices, size_t indexCount) {
+    triangleCount = indexCount / 3;
+    BoundsArray bounds;
+    for (size_t i = 0; i < triangleCount; i++) {
+        const glm::vec3& v0 = vertices[indices[3 * i]].Position;
+        const glm::vec3& v1 = vertices[indices[3 * i + 1]].Position;
+        const glm::vec3& v2 = vertices[indices[3 * i + 2]].Position;
+        glm::vec3 triangleMin = glm::min(v0, glm::min(v1, v2));
+        glm::vec3 triangleMax = glm::max(v0, glm::max(v1, v2));
+        bounds.Add((triangleMin + triangleMax) * 0.5f, (triangleMax - triangleMin) * 0.5f);
+    }
+
+    BVH bvh;
+    bvh.Build(bounds, PACKET_SIZE);
+    nodes = bvh.GetNodes();
+    const std::vector<unsigned int>& triangles = bvh.GetIndices();
+
+    packets.clear();
+    packets.reserve(triangleCount / PACKET_SIZE + nodes.size());
+    for (auto& node : nodes) {
+        if (node.count == 0) {
+            continue;
+        }
+        unsigned int firstPacket = packets.size();
+        for (unsigned int i = 0; i < node.count; i += PACKET_SIZE) {
+            TrianglePacket packet;
+            memset(&packet, 0, sizeof(packet));
+            for (unsigned int lane = 0; lane < PACKET_SIZE && i + lane < node.count; lane++) {
+                unsigned int triangle = triangles[node.leftOrFirst + i + lane];
+                const glm::vec3& v0 = vertices[indices[3 * triangle]].Position;
+                glm::vec3 edge1 = vertices[indices[3 * triangle + 1]].Position - v0;
+                glm::vec3 edge2 = vertices[indices[3 * triangle + 2]].Position - v0;
+                packet.v0x[lane] = v0.x;
+                packet.v0y[lane] = v0.y;
+                packet.v0z[lane] = v0.z;
+                packet.e1x[lane] = edge1.x;
+                packet.e1y[lane] = edge1.y;
+                packet.e1z[lane] = edge1.z;
+                packet.e2x[lane] = edge2.x;
+                packet.e2y[lane] = edge2.y;
+                packet.e2z[lane] = edge2.z;
+                packet.triangle[lane] = triangle;
+            }
+            packets.push_back(packet);
+        }
+        node.count = packets.size() - firstPacket;
+        node.leftOrFirst = firstPacket;
+    }
+}
+
+/**
+ * Finds the nearest triangle hit by a ray. Nodes are visited near to far
+ * and skipped when they are further away than the nearest hit so far.
+ *
+ * @param rayOrigin The origin of the ray
+ * @param rayDir The direction of the ray
+ * @param tMax Hits further away than this are ignored
+ * @param triangle_out Output for the index of the triangle that was hit
+ * @param barycentrics_out Output for the barycentric coordinates of the hit
+ * @param distance_out Output for the distance to the hit in units of rayDir
+ * 
+ * @returns true if a triangle was hit, false otherwise
+ */
+bool TriangleBVH::Intersect(
+    const glm::vec3& rayOrigin,
+    const glm::vec3& rayDir,
+    float tMax,
+    unsigned int& triangle_out,
+    glm::vec2& barycentrics_out,
+    float& distance_out) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    glm::vec3 invDir = 1.0f / rayDir;
+    float nearestDistance = tMax;
+    bool hit = false;
+
+    unsigned int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BVHNode& node = nodes[stack[--stackSize]];
+        if (IntersectRayAABB(rayOrigin, invDir, node.aabbMin, node.aabbMax, nearestDistance) < 0.0f) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+                unsigned int lane;
+                if (intersectPacket(packets[i], rayOrigin, rayDir, nearestDistance, lane, barycentrics_out)) {
+                    triangle_out = packets[i].triangle[lane];
+                    hit = true;
+                }
+            }
+            continue;
+        }
+
+        // Push the far child first so that the near child is visited first
+        unsigned int left = node.leftOrFirst;
+        unsigned int right = node.leftOrFirst + 1;
+        float leftDistance = IntersectRayAABB(rayOrigin, invDir, nodes[left].aabbMin, nodes[left].aabbMax, nearestDistance);
+        float rightDistance = IntersectRayAABB(rayOrigin, invDir, nodes[right].aabbMin, nodes[right].aabbMax, nearestDistance);
+        if (leftDistance > rightDistance) {
+            std::swap(left, right);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance >= 0.0f && stackSize < 64) {
+            stack[stackSize++] = right;
+        }
+        if (leftDistance >= 0.0f && stackSize < 64) {
+            stack[stackSize++] = left;
+        }
+    }
+
+    if (hit) {
+        distance_out = nearestDistance;
+    }
+    return hit;
+}
+
+/**
+ * Gets the number of triangles in the tree.
+ * 
+ * @returns The triangle count
+ */
+size_t TriangleBVH::GetTriangleCount() const {
+    return triangleCount;
+}
+
+/**
+ * Gets the number of nodes in the tree.
+ * 
+ * @returns The node count
+ */
+size_t TriangleBVH::GetNodeCount() const {
+    return nodes.size();
+}
@@ -0,0 +1,132 @@
+#include <upload_ring.h>
+
+// Alignment of staging ranges, enough for any pixel or vertex format
+const GLsizeiptr UPLOAD_RING_ALIGNMENT = 256;
+
+UploadRing::UploadRing(GLsizeiptr size) : size(size) {}
+
+UploadRing::~UploadRing() {
+    for (auto& range : ranges) {
+        if (range.fence) {
+            glClientWaitSync(range.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(range.fence);
+        }
+    }
+    if (buffer) {
+        glUnmapNamedBuffer(buffer);
+    }
+}
+
+/**
+ * Allocates a staging range after the last allocated range, wrapping to
+ * the start of the buffer when the end is reached. Fails instead of
+ * waiting when the GPU still reads the space the range would need.
+ *
+ * @param rangeSize The size of the range in bytes
+ *
+ * @returns The offset of the range in the buffer, -1 if there is no room
+ */
+GLintptr UploadRing::Allocate(GLsizeiptr rangeSize) {
+    rangeSize = ((rangeSize + UPLOAD_RING_ALIGNMENT - 1) / UPLOAD_RING_ALIGNMENT) * UPLOAD_RING_ALIGNMENT;
+    if (rangeSize > size) {
+        return -1;
+    }
+    if (!buffer) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffer = GLBuffer::Create();
+        glNamedBufferStorage(buffer, size, NULL, flags);
+        mapped = (unsigned char*)glMapNamedBufferRange(buffer, 0, size, flags);
+    }
+    retire();
+
+    GLintptr offset = -1;
+    if (ranges.empty()) {
+        offset = 0;
+    } else {
+        GLintptr tail = ranges.front().offset;
+        if (head > tail) {
+            // The used space doesn't wrap, take the end or wrap to the start
+            if (head + rangeSize <= size) {
+                offset = head;
+            } else if (rangeSize <= tail) {
+                offset = 0;
+            }
+        } else if (head + rangeSize <= tail) {
+            offset = head;
+        }
+    }
+    if (offset < 0) {
+        return -1;
+    }
+    head = offset + rangeSize;
+    ranges.push_back({offset, 0, false});
+    return offset;
+}
+
+/**
+ * Fences the ranges allocated since the last commit. Call it after the
+ * commands reading the ranges have been issued.
+ *
+ * @returns void
+ */
+void UploadRing::Commit() {
+    if (ranges.empty() || ranges.back().committed) {
+        return;
+    }
+    // The newest range holds the fence for all ranges committed with it
+    ranges.back().fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    for (auto it = ranges.rbegin(); it != ranges.rend() && !it->committed; it++) {
+        it->committed = true;
+    }
+}
+
+/**
+ * Gets a CPU pointer to a range in the mapped buffer.
+ *
+ * @param offset The offset of the range
+ *
+ * @returns A pointer to the range
+ */
+void* UploadRing::GetPointer(GLintptr offset) {
+    return mapped + offset;
+}
+
+/**
+ * Gets the GL buffer backing the ring.
+ *
+ * @returns The buffer name
+ */
+GLuint UploadRing::GetBuffer() {
+    return buffer;
+}
+
+/**
+ * Gets the size of the ring.
+ *
+ * @returns The size in bytes
+ */
+GLsizeiptr UploadRing::GetSize() const {
+    return size;
+}
+
+/**
+ * Frees the oldest ranges whose fences have signaled. Fences are polled
+ * without waiting.
+ *
+ * @returns void
+ */
+void UploadRing::retire() {
+    while (!ranges.empty() && ranges.front().committed) {
+        // Find the fence of the oldest range, it may be held by a newer range
+        size_t owner = 0;
+        while (!ranges[owner].fence) {
+            owner++;
+        }
+        GLenum status = glClientWaitSync(ranges[owner].fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            return;
+        }
+        glDeleteSync(ranges[owner].fence);
+        ranges.erase(ranges.begin(), ranges.begin() + owner + 1);
+    }
+}
@@ -0,0 +1,254 @@
+#include <vertex_format.h>
+#include <mesh.h>
+
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstring>
+
+static VertexLayout vertexLayout = VERTEX_LAYOUT_FLOAT;
+static bool positionStream = false;
+
+/**
+ * Gets the size of a vertex in a layout, the stride of vertex buffers
+ * holding it.
+ *
+ * @param layout The vertex layout
+ *
+ * @returns The size in bytes
+ */
+size_t VertexFormat::GetStride(VertexLayout layout) {
+    switch (layout) {
+        case VERTEX_LAYOUT_QUANTIZED_OCT8:
+            return sizeof(QuantizedVertexOct8);
+        case VERTEX_LAYOUT_QUANTIZED_OCT16:
+            return sizeof(QuantizedVertexOct16);
+        default:
+            return sizeof(Vertex);
+    }
+}
+
+/**
+ * Gets the size of the position of a vertex in a layout, which is also
+ * the stride of a stream holding only positions.
+ *
+ * @param layout The vertex layout
+ *
+ * @returns The size in bytes
+ */
+size_t VertexFormat::GetPositionSize(VertexLayout layout) {
+    return layout == VERTEX_LAYOUT_FLOAT ? sizeof(glm::vec3) : 3 * sizeof(uint16_t);
+}
+
+/**
+ * Gets the offset of the attributes that follow the position in a
+ * vertex of a layout, skipping the padding after quantized positions.
+ * The attribute stream of split vertices starts each vertex here.
+ *
+ * @param layout The vertex layout
+ *
+ * @returns The offset in bytes
+ */
+size_t VertexFormat::GetAttributesOffset(VertexLayout layout) {
+    switch (layout) {
+        case VERTEX_LAYOUT_QUANTIZED_OCT8:
+            return offsetof(QuantizedVertexOct8, normal);
+        case VERTEX_LAYOUT_QUANTIZED_OCT16:
+            return offsetof(QuantizedVertexOct16, normal);
+        default:
+            return offsetof(Vertex, Normal);
+    }
+}
+
+/**
+ * Encodes vertices into a layout. Positions are stored relative to the
+ * given bounds, which must contain all of them, so that each axis spans
+ * the full 16-bit range. Texture coordinates become half floats, which
+ * keep the texel accuracy of textures up to 2048 texels wide over [0, 1].
+ *
+ * @param vertices The vertices to encode
+ * @param count The number of vertices
+ * @param layout The layout to encode into
+ * @param aabbMin The min coordinates of the vertices
+ * @param aabbMax The max coordinates of the vertices
+ *
+ * @returns The encoded vertices, count * GetStride(layout) bytes
+ */
+std::vector<uint8_t> VertexFormat::Encode(const Vertex* vertices, size_t count, VertexLayout layout,
+    glm::vec3 aabbMin, glm::vec3 aabbMax) {
+    std::vector<uint8_t> output(count * GetStride(layout));
+    if (layout == VERTEX_LAYOUT_FLOAT) {
+        if (count > 0) {
+            memcpy(output.data(), vertices, output.size());
+        }
+        return output;
+    }
+
+    // Flat axes are all encoded as 0 and decoded to the min coordinate
+    glm::vec3 extent = aabbMax - aabbMin;
+    glm::vec3 scale;
+    for (int axis = 0; axis < 3; axis++) {
+        scale[axis] = extent[axis] > 0.0f ? 1.0f / extent[axis] : 0.0f;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        glm::vec3 position = glm::clamp((vertex.Position - aabbMin) * scale, 0.0f, 1.0f);
+        glm::vec2 normal = EncodeOctahedral(vertex.Normal);
+        if (layout == VERTEX_LAYOUT_QUANTIZED_OCT8) {
+            QuantizedVertexOct8& encoded = ((QuantizedVertexOct8*)output.data())[i];
+            for (int axis = 0; axis < 3; axis++) {
+                encoded.position[axis] = glm::packUnorm1x16(position[axis]);
+            }
+            encoded.normal[0] = (int8_t)glm::packSnorm1x8(normal.x);
+            encoded.normal[1] = (int8_t)glm::packSnorm1x8(normal.y);
+            encoded.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+            encoded.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+        } else {
+            QuantizedVertexOct16& encoded = ((QuantizedVertexOct16*)output.data())[i];
+            for (int axis = 0; axis < 3; axis++) {
+                encoded.position[axis] = glm::packUnorm1x16(position[axis]);
+            }
+            encoded.padding = 0;
+            encoded.normal[0] = (int16_t)glm::packSnorm1x16(normal.x);
+            encoded.normal[1] = (int16_t)glm::packSnorm1x16(normal.y);
+            encoded.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+            encoded.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+        }
+    }
+    return output;
+}
+
+/**
+ * Splits vertices encoded in a layout into a stream of tightly packed
+ * positions and a stream of the other attributes of each vertex, which
+ * keep their order and are GetAttributesOffset bytes closer to the start
+ * of the vertex.
+ *
+ * @param encoded The vertices encoded with Encode
+ * @param layout The layout of the vertices
+ * @param positions_out The positions, GetPositionSize bytes per vertex
+ * @param attributes_out The other attributes
+ *
+ * @returns void
+ */
+void VertexFormat::SplitPositions(const std::vector<uint8_t>& encoded, VertexLayout layout,
+    std::vector<uint8_t>& positions_out, std::vector<uint8_t>& attributes_out) {
+    size_t stride = GetStride(layout);
+    size_t positionSize = GetPositionSize(layout);
+    size_t attributesOffset = GetAttributesOffset(layout);
+    size_t attributesSize = stride - attributesOffset;
+    size_t count = encoded.size() / stride;
+    positions_out.resize(count * positionSize);
+    attributes_out.resize(count * attributesSize);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* vertex = encoded.data() + i * stride;
+        memcpy(positions_out.data() + i * positionSize, vertex, positionSize);
+        memcpy(attributes_out.data() + i * attributesSize, vertex + attributesOffset, attributesSize);
+    }
+}
+
+/**
+ * Gets the matrix that maps positions encoded in a layout back to model
+ * space. Quantized positions are read as [0, 1] on each axis and scaled
+ * and translated onto the bounds they were encoded with.
+ *
+ * @param layout The vertex layout
+ * @param aabbMin The min coordinates the positions were encoded with
+ * @param aabbMax The max coordinates the positions were encoded with
+ *
+ * @returns The decode matrix, identity for float vertices
+ */
+glm::mat4 VertexFormat::GetPositionDecode(VertexLayout layout, glm::vec3 aabbMin, glm::vec3 aabbMax) {
+    if (layout == VERTEX_LAYOUT_FLOAT) {
+        return glm::mat4(1.0f);
+    }
+    glm::mat4 decode = glm::translate(glm::mat4(1.0f), aabbMin);
+    return glm::scale(decode, aabbMax - aabbMin);
+}
+
+/**
+ * Encodes a unit vector by projecting it onto the octahedron
+ * |x| + |y| + |z| = 1 and folding the lower half over the upper half,
+ * which spreads the precision of two values evenly over the sphere.
+ *
+ * @param normal The unit vector
+ *
+ * @returns The coordinates on the unfolded octahedron
+ */
+glm::vec2 VertexFormat::EncodeOctahedral(glm::vec3 normal) {
+    float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if (length == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+    glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+    if (normal.z < 0.0f) {
+        glm::vec2 folded = 1.0f - glm::abs(glm::vec2(encoded.y, encoded.x));
+        encoded.x = encoded.x >= 0.0f ? folded.x : -folded.x;
+        encoded.y = encoded.y >= 0.0f ? folded.y : -folded.y;
+    }
+    return encoded;
+}
+
+/**
+ * Decodes a unit vector from the unfolded octahedron, the same way the
+ * vertex shaders decode octahedral normals.
+ *
+ * @param encoded The coordinates on the unfolded octahedron
+ *
+ * @returns The unit vector
+ */
+glm::vec3 VertexFormat::DecodeOctahedral(glm::vec2 encoded) {
+    glm::vec3 normal(encoded.x, encoded.y, 1.0f - fabsf(encoded.x) - fabsf(encoded.y));
+    float fold = glm::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    return glm::normalize(normal);
+}
+
+/**
+ * Sets the layout the meshes of models are uploaded in. Meshes keep the
+ * layout they were created with, so this applies to models loaded
+ * afterwards. Cooked models hold float vertices and are encoded as they
+ * are uploaded.
+ *
+ * @param layout The vertex layout
+ *
+ * @returns void
+ */
+void VertexFormat::SetLayout(VertexLayout layout) {
+    vertexLayout = layout;
+}
+
+/**
+ * Gets the layout the meshes of models are uploaded in.
+ *
+ * @returns The vertex layout
+ */
+VertexLayout VertexFormat::GetLayout() {
+    return vertexLayout;
+}
+
+/**
+ * Makes the meshes of models loaded afterwards store their positions in
+ * a buffer of their own, read from POSITION_BINDING, next to a buffer
+ * with the other attributes. Passes whose shaders only read positions,
+ * like depth and shadow passes, then fetch only the position buffer.
+ *
+ * @param enabled true to split off the positions
+ *
+ * @returns void
+ */
+void VertexFormat::SetPositionStream(bool enabled) {
+    positionStream = enabled;
+}
+
+/**
+ * Checks if the meshes of models are uploaded with a separate position
+ * stream.
+ *
+ * @returns true if positions are split off, false otherwise
+ */
+bool VertexFormat::IsPositionStreamEnabled() {
+    return positionStream;
+}
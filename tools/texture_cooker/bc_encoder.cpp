@@ -0,0 +1,662 @@
+#include "bc_encoder.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// Interpolation weights of the 4 bit indices of BC7, out of 64
+const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// Weight of the second endpoint for each BC1 index
+const float BC1_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+// Iterations of the endpoint fit after the initial guess
+const int REFINE_ITERATIONS = 2;
+
+// Colors a block is encoded with in component arrays, padded to a
+// multiple of four entries so they can be searched four at a time
+struct BlockPalette {
+    alignas(16) float r[16];
+    alignas(16) float g[16];
+    alignas(16) float b[16];
+    alignas(16) float a[16];
+    int size;
+};
+
+// Writes bits to a zeroed block, least significant bit first
+struct BitWriter {
+    uint8_t* data;
+    int position;
+
+    void Write(uint32_t value, int bits) {
+        for (int i = 0; i < bits; i++, position++) {
+            if ((value >> i) & 1) {
+                data[position >> 3] |= 1 << (position & 7);
+            }
+        }
+    }
+};
+
+/**
+ * Gets the size of an encoded 4x4 block.
+ *
+ * @param format The block format
+ *
+ * @returns The size in bytes
+ */
+size_t GetEncodedBlockSize(BlockFormat format) {
+    return format == BLOCK_BC1 ? 8 : 16;
+}
+
+/**
+ * Converts the pixels of a block to floats.
+ *
+ * @param pixels The RGBA pixels of the block
+ * @param pixels_out Output for the pixels as floats from 0 to 255
+ *
+ * @returns void
+ */
+static void loadBlock(const uint8_t pixels[64], float pixels_out[16][4]) {
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            pixels_out[i][c] = pixels[i * 4 + c];
+        }
+    }
+}
+
+/**
+ * Finds the mean of the pixels of a block and the axis along which they
+ * vary the most, by power iteration on their covariance matrix.
+ *
+ * @param pixels The pixels of the block
+ * @param channels The number of channels to consider, 3 or 4
+ * @param mean_out Output for the mean
+ * @param axis_out Output for the unit length axis, zero if all pixels are equal
+ *
+ * @returns void
+ */
+static void principalAxis(const float pixels[16][4], int channels, float mean_out[4], float axis_out[4]) {
+    for (int c = 0; c < 4; c++) {
+        mean_out[c] = 0.0f;
+        axis_out[c] = 0.0f;
+    }
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < channels; c++) {
+            mean_out[c] += pixels[i][c];
+        }
+    }
+    for (int c = 0; c < channels; c++) {
+        mean_out[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[4];
+        for (int c = 0; c < channels; c++) {
+            d[c] = pixels[i][c] - mean_out[c];
+        }
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++) {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    // Start from the row of the channel that varies the most
+    int largest = 0;
+    for (int c = 1; c < channels; c++) {
+        if (covariance[c][c] > covariance[largest][largest]) {
+            largest = c;
+        }
+    }
+    float axis[4] = {};
+    for (int c = 0; c < channels; c++) {
+        axis[c] = covariance[largest][c];
+    }
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float scale = 0.0f;
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            scale = std::max(scale, std::fabs(next[a]));
+        }
+        if (scale == 0.0f) {
+            return;
+        }
+        for (int c = 0; c < channels; c++) {
+            axis[c] = next[c] / scale;
+        }
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < channels; c++) {
+        length += axis[c] * axis[c];
+    }
+    if (length > 0.0f) {
+        length = std::sqrt(length);
+        for (int c = 0; c < channels; c++) {
+            axis_out[c] = axis[c] / length;
+        }
+    }
+}
+
+/**
+ * Finds the endpoints of the line through the pixels of a block along
+ * their principal axis.
+ *
+ * @param pixels The pixels of the block
+ * @param channels The number of channels to consider, 3 or 4
+ * @param e0_out Output for the endpoint at the low end of the axis
+ * @param e1_out Output for the endpoint at the high end of the axis
+ *
+ * @returns void
+ */
+static void principalEndpoints(const float pixels[16][4], int channels, float e0_out[4], float e1_out[4]) {
+    float mean[4];
+    float axis[4];
+    principalAxis(pixels, channels, mean, axis);
+    float minT = 0.0f;
+    float maxT = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            t += (pixels[i][c] - mean[c]) * axis[c];
+        }
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < 4; c++) {
+        e0_out[c] = mean[c] + axis[c] * minT;
+        e1_out[c] = mean[c] + axis[c] * maxT;
+    }
+}
+
+/**
+ * Finds the endpoints that best reproduce the pixels of a block with
+ * fixed indices, by least squares.
+ *
+ * @param pixels The pixels of the block
+ * @param indices The index of each pixel
+ * @param weights The weight of the second endpoint for each index
+ * @param channels The number of channels to fit
+ * @param e0_out Output for the first endpoint
+ * @param e1_out Output for the second endpoint
+ *
+ * @returns true if the endpoints were found, false if the indices don't determine them
+ */
+static bool fitEndpoints(const float pixels[16][4], const uint8_t indices[16], const float* weights, int channels,
+    float e0_out[4], float e1_out[4]) {
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = {};
+    float bx[4] = {};
+    for (int i = 0; i < 16; i++) {
+        float b = weights[indices[i]];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channels; c++) {
+            ax[c] += a * pixels[i][c];
+            bx[c] += b * pixels[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+    for (int c = 0; c < channels; c++) {
+        e0_out[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+        e1_out[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+    }
+    return true;
+}
+
+/**
+ * Finds the nearest palette color of each pixel of a block. With SSE the
+ * distances to four palette colors are computed at once. Ties go to the
+ * lowest index either way, so both paths give the same indices. That
+ * only holds while neither path is contracted into fused multiply-adds,
+ * the cooker is built with -ffp-contract=off.
+ *
+ * @param pixels The pixels of the block
+ * @param palette The colors to choose from
+ * @param useAlpha true to include alpha in the distance
+ * @param indices_out Output for the palette index of each pixel
+ *
+ * @returns The total squared error of the block
+ */
+static float selectIndices(const float pixels[16][4], const BlockPalette& palette, bool useAlpha, uint8_t indices_out[16]) {
+    float alphaWeight = useAlpha ? 1.0f : 0.0f;
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float bestDistance = FLT_MAX;
+        int bestIndex = 0;
+#if defined(__SSE2__)
+        __m128 r = _mm_set1_ps(pixels[i][0]);
+        __m128 g = _mm_set1_ps(pixels[i][1]);
+        __m128 b = _mm_set1_ps(pixels[i][2]);
+        __m128 a = _mm_set1_ps(pixels[i][3]);
+        __m128 weight = _mm_set1_ps(alphaWeight);
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestLanes = _mm_setzero_si128();
+        for (int e = 0; e < palette.size; e += 4) {
+            __m128 dr = _mm_sub_ps(_mm_load_ps(palette.r + e), r);
+            __m128 dg = _mm_sub_ps(_mm_load_ps(palette.g + e), g);
+            __m128 db = _mm_sub_ps(_mm_load_ps(palette.b + e), b);
+            __m128 da = _mm_sub_ps(_mm_load_ps(palette.a + e), a);
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db)),
+                _mm_mul_ps(_mm_mul_ps(da, da), weight));
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            __m128i lanes = _mm_set_epi32(e + 3, e + 2, e + 1, e);
+            bestLanes = _mm_or_si128(_mm_and_si128(closer, lanes), _mm_andnot_si128(closer, bestLanes));
+            best = _mm_min_ps(distance, best);
+        }
+        alignas(16) float distances[4];
+        alignas(16) int lanes[4];
+        _mm_store_ps(distances, best);
+        _mm_store_si128((__m128i*)lanes, bestLanes);
+        for (int lane = 0; lane < 4; lane++) {
+            if (distances[lane] < bestDistance || (distances[lane] == bestDistance && lanes[lane] < bestIndex)) {
+                bestDistance = distances[lane];
+                bestIndex = lanes[lane];
+            }
+        }
+#else
+        for (int e = 0; e < palette.size; e++) {
+            float dr = palette.r[e] - pixels[i][0];
+            float dg = palette.g[e] - pixels[i][1];
+            float db = palette.b[e] - pixels[i][2];
+            float da = palette.a[e] - pixels[i][3];
+            float distance = ((dr * dr + dg * dg) + db * db) + (da * da) * alphaWeight;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                bestIndex = e;
+            }
+        }
+#endif
+        indices_out[i] = bestIndex;
+        error += bestDistance;
+    }
+    return error;
+}
+
+/**
+ * Quantizes a color to 5:6:5 bits.
+ *
+ * @param color The color from 0 to 255
+ *
+ * @returns The packed color
+ */
+static uint16_t packColor565(const float color[4]) {
+    int r = std::min(std::max((int)std::floor(color[0] * 31.0f / 255.0f + 0.5f), 0), 31);
+    int g = std::min(std::max((int)std::floor(color[1] * 63.0f / 255.0f + 0.5f), 0), 63);
+    int b = std::min(std::max((int)std::floor(color[2] * 31.0f / 255.0f + 0.5f), 0), 31);
+    return (r << 11) | (g << 5) | b;
+}
+
+/**
+ * Expands a 5:6:5 color to 8 bits per channel as the hardware does.
+ *
+ * @param packed The packed color
+ * @param color_out Output for the color from 0 to 255
+ *
+ * @returns void
+ */
+static void unpackColor565(uint16_t packed, float color_out[4]) {
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color_out[0] = (r << 3) | (r >> 2);
+    color_out[1] = (g << 2) | (g >> 4);
+    color_out[2] = (b << 3) | (b >> 2);
+    color_out[3] = 255.0f;
+}
+
+/**
+ * Selects the BC1 indices of a block for a pair of endpoints. The
+ * endpoints are ordered for the four color mode, equal endpoints give
+ * a single color.
+ *
+ * @param pixels The pixels of the block
+ * @param c0 The first endpoint, may be swapped with the second
+ * @param c1 The second endpoint
+ * @param indices_out Output for the index of each pixel
+ *
+ * @returns The total squared error of the block
+ */
+static float evaluateBC1(const float pixels[16][4], uint16_t& c0, uint16_t& c1, uint8_t indices_out[16]) {
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    float e0[4];
+    float e1[4];
+    unpackColor565(c0, e0);
+    unpackColor565(c1, e1);
+    BlockPalette palette;
+    palette.size = 4;
+    float* channels[4] = {palette.r, palette.g, palette.b, palette.a};
+    for (int c = 0; c < 4; c++) {
+        channels[c][0] = e0[c];
+        channels[c][1] = e1[c];
+        channels[c][2] = c0 == c1 ? e0[c] : (2.0f * e0[c] + e1[c]) / 3.0f;
+        channels[c][3] = c0 == c1 ? e0[c] : (e0[c] + 2.0f * e1[c]) / 3.0f;
+    }
+    return selectIndices(pixels, palette, false, indices_out);
+}
+
+/**
+ * Encodes a block to BC1. The endpoints start at the ends of the
+ * principal axis of the colors, inset to reduce the error of the
+ * interpolated colors, and are then refined by least squares.
+ *
+ * @param pixels The RGBA pixels of the block row by row
+ * @param block_out Output for the 8 byte block
+ *
+ * @returns void
+ */
+void EncodeBC1Block(const uint8_t pixels[64], uint8_t block_out[8]) {
+    float block[16][4];
+    loadBlock(pixels, block);
+
+    float e0[4];
+    float e1[4];
+    principalEndpoints(block, 3, e0, e1);
+    for (int c = 0; c < 3; c++) {
+        float inset = (e1[c] - e0[c]) / 16.0f;
+        e0[c] += inset;
+        e1[c] -= inset;
+    }
+    uint16_t c0 = packColor565(e1);
+    uint16_t c1 = packColor565(e0);
+    uint8_t indices[16];
+    float error = evaluateBC1(block, c0, c1, indices);
+
+    for (int iteration = 0; iteration < REFINE_ITERATIONS && error > 0.0f; iteration++) {
+        if (!fitEndpoints(block, indices, BC1_WEIGHTS, 3, e0, e1)) {
+            break;
+        }
+        uint16_t fit0 = packColor565(e0);
+        uint16_t fit1 = packColor565(e1);
+        uint8_t fitIndices[16];
+        float fitError = evaluateBC1(block, fit0, fit1, fitIndices);
+        if (fitError >= error) {
+            break;
+        }
+        c0 = fit0;
+        c1 = fit1;
+        error = fitError;
+        memcpy(indices, fitIndices, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        bits |= (uint32_t)indices[i] << (2 * i);
+    }
+    block_out[0] = c0 & 0xFF;
+    block_out[1] = c0 >> 8;
+    block_out[2] = c1 & 0xFF;
+    block_out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        block_out[4 + i] = (bits >> (8 * i)) & 0xFF;
+    }
+}
+
+/**
+ * Encodes one channel of a block to a BC4 block. The endpoints are the
+ * extremes of the channel in the eight value mode and each pixel gets
+ * the nearest of the evenly spaced values between them. With SSE four
+ * pixels are placed at a time.
+ *
+ * @param pixels The RGBA pixels of the block row by row
+ * @param channel The channel to encode
+ * @param block_out Output for the 8 byte block
+ *
+ * @returns void
+ */
+static void encodeBC4Block(const uint8_t pixels[64], int channel, uint8_t block_out[8]) {
+    alignas(16) float values[16];
+    int low = 255;
+    int high = 0;
+    for (int i = 0; i < 16; i++) {
+        int value = pixels[i * 4 + channel];
+        values[i] = value;
+        low = std::min(low, value);
+        high = std::max(high, value);
+    }
+    memset(block_out, 0, 8);
+    block_out[0] = high;
+    block_out[1] = low;
+    if (high == low) {
+        return;
+    }
+
+    // Position of each pixel from the first endpoint in sevenths
+    float scale = 7.0f / (high - low);
+    alignas(16) int steps[16];
+#if defined(__SSE2__)
+    __m128 highValue = _mm_set1_ps((float)high);
+    __m128 scaleValue = _mm_set1_ps(scale);
+    __m128 half = _mm_set1_ps(0.5f);
+    for (int i = 0; i < 16; i += 4) {
+        __m128 step = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(highValue, _mm_load_ps(values + i)), scaleValue), half);
+        _mm_store_si128((__m128i*)(steps + i), _mm_cvttps_epi32(step));
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        steps[i] = (int)(((float)high - values[i]) * scale + 0.5f);
+    }
+#endif
+
+    // Index 0 and 1 are the endpoints, 2 to 7 the values between them
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        uint64_t index = steps[i] == 0 ? 0 : steps[i] == 7 ? 1 : steps[i] + 1;
+        bits |= index << (3 * i);
+    }
+    for (int i = 0; i < 6; i++) {
+        block_out[2 + i] = (bits >> (8 * i)) & 0xFF;
+    }
+}
+
+/**
+ * Encodes a block to BC5, the red channel followed by the green channel
+ * as two BC4 blocks.
+ *
+ * @param pixels The RGBA pixels of the block row by row
+ * @param block_out Output for the 16 byte block
+ *
+ * @returns void
+ */
+void EncodeBC5Block(const uint8_t pixels[64], uint8_t block_out[16]) {
+    encodeBC4Block(pixels, 0, block_out);
+    encodeBC4Block(pixels, 1, block_out + 8);
+}
+
+/**
+ * Quantizes a BC7 mode 6 endpoint to 7 bits per channel and a shared
+ * low bit, picking the low bit with the smallest error.
+ *
+ * @param endpoint The endpoint from 0 to 255
+ * @param quantized_out Output for the 7 bit channels
+ * @param pBit_out Output for the shared low bit
+ *
+ * @returns void
+ */
+static void quantizeBC7Endpoint(const float endpoint[4], int quantized_out[4], int& pBit_out) {
+    float bestError = FLT_MAX;
+    for (int p = 0; p < 2; p++) {
+        int quantized[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            quantized[c] = std::min(std::max((int)std::floor((endpoint[c] - p) / 2.0f + 0.5f), 0), 127);
+            float difference = (quantized[c] * 2 + p) - endpoint[c];
+            error += difference * difference;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit_out = p;
+            memcpy(quantized_out, quantized, sizeof(quantized));
+        }
+    }
+}
+
+/**
+ * Selects the BC7 mode 6 indices of a block for a pair of quantized
+ * endpoints, interpolating the palette exactly as the hardware does.
+ *
+ * @param pixels The pixels of the block
+ * @param q0 The 7 bit channels of the first endpoint
+ * @param p0 The low bit of the first endpoint
+ * @param q1 The 7 bit channels of the second endpoint
+ * @param p1 The low bit of the second endpoint
+ * @param indices_out Output for the index of each pixel
+ *
+ * @returns The total squared error of the block
+ */
+static float evaluateBC7(const float pixels[16][4], const int q0[4], int p0, const int q1[4], int p1, uint8_t indices_out[16]) {
+    BlockPalette palette;
+    palette.size = 16;
+    float* channels[4] = {palette.r, palette.g, palette.b, palette.a};
+    for (int c = 0; c < 4; c++) {
+        int e0 = q0[c] * 2 + p0;
+        int e1 = q1[c] * 2 + p1;
+        for (int k = 0; k < 16; k++) {
+            channels[c][k] = ((64 - BC7_WEIGHTS[k]) * e0 + BC7_WEIGHTS[k] * e1 + 32) >> 6;
+        }
+    }
+    return selectIndices(pixels, palette, true, indices_out);
+}
+
+/**
+ * Encodes a block to BC7 mode 6, one RGBA line with 7 bit endpoints, a
+ * shared low bit per endpoint and 4 bit indices. The endpoints start at
+ * the ends of the principal axis of the pixels and are then refined by
+ * least squares.
+ *
+ * @param pixels The RGBA pixels of the block row by row
+ * @param block_out Output for the 16 byte block
+ *
+ * @returns void
+ */
+void EncodeBC7Block(const uint8_t pixels[64], uint8_t block_out[16]) {
+    float block[16][4];
+    loadBlock(pixels, block);
+
+    float e0[4];
+    float e1[4];
+    principalEndpoints(block, 4, e0, e1);
+    int q0[4];
+    int q1[4];
+    int p0;
+    int p1;
+    quantizeBC7Endpoint(e0, q0, p0);
+    quantizeBC7Endpoint(e1, q1, p1);
+    uint8_t indices[16];
+    float error = evaluateBC7(block, q0, p0, q1, p1, indices);
+
+    float weights[16];
+    for (int k = 0; k < 16; k++) {
+        weights[k] = BC7_WEIGHTS[k] / 64.0f;
+    }
+    for (int iteration = 0; iteration < REFINE_ITERATIONS && error > 0.0f; iteration++) {
+        if (!fitEndpoints(block, indices, weights, 4, e0, e1)) {
+            break;
+        }
+        int fit0[4];
+        int fit1[4];
+        int fitP0;
+        int fitP1;
+        quantizeBC7Endpoint(e0, fit0, fitP0);
+        quantizeBC7Endpoint(e1, fit1, fitP1);
+        uint8_t fitIndices[16];
+        float fitError = evaluateBC7(block, fit0, fitP0, fit1, fitP1, fitIndices);
+        if (fitError >= error) {
+            break;
+        }
+        memcpy(q0, fit0, sizeof(q0));
+        memcpy(q1, fit1, sizeof(q1));
+        p0 = fitP0;
+        p1 = fitP1;
+        error = fitError;
+        memcpy(indices, fitIndices, sizeof(indices));
+    }
+
+    // The high bit of the first index is implied zero, swap the endpoints if it is set
+    if (indices[0] & 8) {
+        std::swap(q0, q1);
+        std::swap(p0, p1);
+        for (int i = 0; i < 16; i++) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(block_out, 0, 16);
+    BitWriter writer = {block_out, 0};
+    writer.Write(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.Write(q0[c], 7);
+        writer.Write(q1[c], 7);
+    }
+    writer.Write(p0, 1);
+    writer.Write(p1, 1);
+    writer.Write(indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+        writer.Write(indices[i], 4);
+    }
+}
+
+/**
+ * Encodes a range of block rows of an image. Blocks past the right or
+ * bottom edge repeat the last column or row. Each block only depends on
+ * its own pixels, so ranges can be encoded in parallel and the result
+ * doesn't depend on how the image was split.
+ *
+ * @param format The format to encode to
+ * @param rgba The RGBA pixels of the image row by row
+ * @param width The width of the image in pixels
+ * @param height The height of the image in pixels
+ * @param firstRow The first row of blocks to encode
+ * @param lastRow The row of blocks after the last one to encode
+ * @param blocks_out Output for the blocks of the whole image
+ *
+ * @returns void
+ */
+void EncodeBlockRows(BlockFormat format, const uint8_t* rgba, int width, int height,
+    int firstRow, int lastRow, uint8_t* blocks_out) {
+    int blocksWide = (width + 3) / 4;
+    size_t blockSize = GetEncodedBlockSize(format);
+    uint8_t pixels[64];
+    for (int by = firstRow; by < lastRow; by++) {
+        for (int bx = 0; bx < blocksWide; bx++) {
+            for (int y = 0; y < 4; y++) {
+                int sy = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx * 4 + x, width - 1);
+                    memcpy(pixels + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                }
+            }
+            uint8_t* block = blocks_out + ((size_t)by * blocksWide + bx) * blockSize;
+            switch (format) {
+                case BLOCK_BC1:
+                    EncodeBC1Block(pixels, block);
+                    break;
+                case BLOCK_BC5:
+                    EncodeBC5Block(pixels, block);
+                    break;
+                case BLOCK_BC7:
+                    EncodeBC7Block(pixels, block);
+                    break;
+            }
+        }
+    }
+}
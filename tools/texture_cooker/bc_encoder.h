@@ -0,0 +1,31 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Block compressed formats the encoder writes
+enum BlockFormat {
+    BLOCK_BC1,
+    BLOCK_BC5,
+    BLOCK_BC7
+};
+
+// Gets the size in bytes of an encoded 4x4 block
+size_t GetEncodedBlockSize(BlockFormat format);
+
+// Encodes a 4x4 block of RGBA pixels given row by row, BC1 ignores alpha
+void EncodeBC1Block(const uint8_t pixels[64], uint8_t block_out[8]);
+
+// Encodes the red and green channels of a 4x4 block of RGBA pixels
+void EncodeBC5Block(const uint8_t pixels[64], uint8_t block_out[16]);
+
+// Encodes a 4x4 block of RGBA pixels with BC7 mode 6
+void EncodeBC7Block(const uint8_t pixels[64], uint8_t block_out[16]);
+
+// Encodes the rows of blocks [firstRow, lastRow) of an RGBA image into
+// the blocks of the whole image, edge blocks repeat the last pixels
+void EncodeBlockRows(BlockFormat format, const uint8_t* rgba, int width, int height,
+    int firstRow, int lastRow, uint8_t* blocks_out);
+
+#endif  // BC_ENCODER_H
@@ -0,0 +1,153 @@
+#include "mip_chain.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Converts an sRGB encoded channel to linear light.
+ *
+ * @param value The encoded channel from 0 to 1
+ *
+ * @returns The linear channel from 0 to 1
+ */
+static float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+/**
+ * Converts a linear channel to sRGB encoding.
+ *
+ * @param value The linear channel from 0 to 1
+ *
+ * @returns The encoded channel from 0 to 1
+ */
+static float linearToSrgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * Converts a filtered channel back to 8 bits.
+ *
+ * @param value The channel from 0 to 1
+ *
+ * @returns The rounded channel from 0 to 255
+ */
+static uint8_t toByte(float value) {
+    return (uint8_t)std::min(std::max((int)(value * 255.0f + 0.5f), 0), 255);
+}
+
+/**
+ * Gets the pixels of the previous level a pixel of the next level
+ * averages along one axis. These are 2 pixels, and 3 for the last pixel
+ * of an odd size so that the last row or column is not dropped. A size
+ * of 1 stays 1 and averages its only pixel.
+ *
+ * @param index The pixel of the next level
+ * @param size The size of the previous level along the axis
+ * @param nextSize The size of the next level along the axis
+ * @param begin_out Set to the first pixel of the previous level
+ * @param end_out Set to one past the last pixel of the previous level
+ *
+ * @returns void
+ */
+static void getTaps(int index, int size, int nextSize, int& begin_out, int& end_out) {
+    begin_out = index * 2;
+    end_out = index == nextSize - 1 ? size : begin_out + 2;
+}
+
+/**
+ * Builds the mip chain of an image. Each level halves the size of the
+ * previous one, rounding down, and averages 2x2 pixels of it. Pixels at
+ * the end of odd sizes average 3 rows or columns instead, so that every
+ * pixel of the previous level contributes to the next. Levels are filtered from the
+ * previous level at full precision, not from its 8 bit pixels. Color of
+ * sRGB images is averaged in linear light so that mips keep the
+ * brightness of the image, normal maps are averaged as vectors and
+ * renormalized. Alpha is always averaged linearly.
+ *
+ * @param rgba The RGBA pixels of the image row by row
+ * @param width The width of the image in pixels
+ * @param height The height of the image in pixels
+ * @param filter How the color channels are filtered
+ *
+ * @returns The levels, the image itself first
+ */
+std::vector<MipLevel> BuildMipChain(const uint8_t* rgba, int width, int height, MipFilter filter) {
+    std::vector<MipLevel> levels(1);
+    levels[0].width = width;
+    levels[0].height = height;
+    levels[0].pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+    // Decoded channels of the current level, colors are linear or vectors
+    float table[256];
+    for (int i = 0; i < 256; i++) {
+        float value = i / 255.0f;
+        if (filter == MIP_FILTER_SRGB) {
+            table[i] = srgbToLinear(value);
+        } else if (filter == MIP_FILTER_NORMAL) {
+            table[i] = value * 2.0f - 1.0f;
+        } else {
+            table[i] = value;
+        }
+    }
+    std::vector<float> current((size_t)width * height * 4);
+    for (size_t i = 0; i < current.size(); i++) {
+        current[i] = (i & 3) == 3 ? rgba[i] / 255.0f : table[rgba[i]];
+    }
+
+    while (width > 1 || height > 1) {
+        int nextWidth = std::max(width / 2, 1);
+        int nextHeight = std::max(height / 2, 1);
+        std::vector<float> next((size_t)nextWidth * nextHeight * 4);
+        MipLevel level;
+        level.width = nextWidth;
+        level.height = nextHeight;
+        level.pixels.resize(next.size());
+
+        for (int y = 0; y < nextHeight; y++) {
+            int y0, y1;
+            getTaps(y, height, nextHeight, y0, y1);
+            for (int x = 0; x < nextWidth; x++) {
+                int x0, x1;
+                getTaps(x, width, nextWidth, x0, x1);
+                float* pixel = &next[((size_t)y * nextWidth + x) * 4];
+                float weight = 1.0f / ((y1 - y0) * (x1 - x0));
+                for (int c = 0; c < 4; c++) {
+                    float sum = 0.0f;
+                    for (int sy = y0; sy < y1; sy++) {
+                        for (int sx = x0; sx < x1; sx++) {
+                            sum += current[((size_t)sy * width + sx) * 4 + c];
+                        }
+                    }
+                    pixel[c] = sum * weight;
+                }
+                if (filter == MIP_FILTER_NORMAL) {
+                    float length = std::sqrt(pixel[0] * pixel[0] + pixel[1] * pixel[1] + pixel[2] * pixel[2]);
+                    if (length > 0.0f) {
+                        for (int c = 0; c < 3; c++) {
+                            pixel[c] /= length;
+                        }
+                    }
+                }
+
+                uint8_t* out = &level.pixels[((size_t)y * nextWidth + x) * 4];
+                for (int c = 0; c < 3; c++) {
+                    if (filter == MIP_FILTER_SRGB) {
+                        out[c] = toByte(linearToSrgb(pixel[c]));
+                    } else if (filter == MIP_FILTER_NORMAL) {
+                        out[c] = toByte(pixel[c] * 0.5f + 0.5f);
+                    } else {
+                        out[c] = toByte(pixel[c]);
+                    }
+                }
+                out[3] = toByte(pixel[3]);
+            }
+        }
+
+        levels.push_back(std::move(level));
+        current.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return levels;
+}
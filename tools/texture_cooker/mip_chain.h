@@ -0,0 +1,24 @@
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <cstdint>
+#include <vector>
+
+// A level of a mip chain, RGBA pixels row by row
+struct MipLevel {
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+};
+
+// How the channels of an image are filtered when building its mips
+enum MipFilter {
+    MIP_FILTER_LINEAR,
+    MIP_FILTER_SRGB,
+    MIP_FILTER_NORMAL
+};
+
+// Builds the full mip chain of an RGBA image down to 1x1, level 0 is a copy of the image
+std::vector<MipLevel> BuildMipChain(const uint8_t* rgba, int width, int height, MipFilter filter);
+
+#endif  // MIP_CHAIN_H
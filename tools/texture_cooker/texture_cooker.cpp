@@ -0,0 +1,273 @@
+#include <model.h>
+#include <compressed_texture.h>
+#include <thread_pool.h>
+#include <stb_image.h>
+
+#include "bc_encoder.h"
+#include "mip_chain.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Rows of blocks encoded by one task
+const int BAND_ROWS = 16;
+
+// Settings given on the command line
+struct CookerSettings {
+    std::string format = "auto";
+    bool linear = false;
+    bool flip = true;
+    bool force = false;
+    unsigned int threads = 0;
+};
+
+// A texture to cook, from its source image to the encoded levels
+struct CookJob {
+    std::string sourcePath;
+    std::string outputPath;
+    std::string type;
+    BlockFormat format;
+    uint32_t vkFormat;
+    MipFilter filter;
+    std::vector<MipLevel> mips;
+    std::vector<std::vector<unsigned char>> levels;
+    bool failed = false;
+};
+
+/**
+ * Checks if a path names an image the cooker can read.
+ *
+ * @param path The path to check
+ *
+ * @returns true if the path has the extension of an image, false otherwise
+ */
+bool isImage(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (const char* imageExtension : {".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif"}) {
+        if (extension == imageExtension) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Decodes the source image of a job and builds its mip chain. In auto
+ * mode the format is picked from the texture type and the image: BC5
+ * for normal maps, BC1 for opaque color and BC7 for color with alpha.
+ *
+ * @param job The job to load
+ * @param settings The settings to cook with
+ *
+ * @returns void
+ */
+void loadJob(CookJob& job, const CookerSettings& settings) {
+    int width;
+    int height;
+    int components;
+    unsigned char* pixels = stbi_load(job.sourcePath.c_str(), &width, &height, &components, 4);
+    if (!pixels) {
+        std::cout << "Texture failed to load at path: " << job.sourcePath << std::endl;
+        job.failed = true;
+        return;
+    }
+
+    bool normalMap = job.type.find("normal") != std::string::npos;
+    if (settings.format == "bc1") {
+        job.format = BLOCK_BC1;
+    } else if (settings.format == "bc5") {
+        job.format = BLOCK_BC5;
+    } else if (settings.format == "bc7") {
+        job.format = BLOCK_BC7;
+    } else if (normalMap) {
+        job.format = BLOCK_BC5;
+    } else {
+        bool opaque = true;
+        for (size_t i = 3; i < (size_t)width * height * 4 && opaque; i += 4) {
+            opaque = pixels[i] == 255;
+        }
+        job.format = opaque ? BLOCK_BC1 : BLOCK_BC7;
+    }
+
+    bool srgb = !settings.linear && job.format != BLOCK_BC5;
+    job.filter = job.format == BLOCK_BC5 ? MIP_FILTER_NORMAL : srgb ? MIP_FILTER_SRGB : MIP_FILTER_LINEAR;
+    if (job.format == BLOCK_BC1) {
+        job.vkFormat = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    } else if (job.format == BLOCK_BC7) {
+        job.vkFormat = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    } else {
+        job.vkFormat = VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+
+    job.mips = BuildMipChain(pixels, width, height, job.filter);
+    stbi_image_free(pixels);
+    job.levels.resize(job.mips.size());
+    for (size_t i = 0; i < job.mips.size(); i++) {
+        size_t blocks = (size_t)((job.mips[i].width + 3) / 4) * ((job.mips[i].height + 3) / 4);
+        job.levels[i].resize(blocks * GetEncodedBlockSize(job.format));
+    }
+}
+
+/**
+ * Cooks a batch of jobs on the pool. All images are decoded and get their
+ * mips in parallel, then every level is split into bands of block rows
+ * that are encoded in parallel. Each block is encoded on its own, so the
+ * files are the same whatever the number of threads.
+ *
+ * @param jobs The jobs to cook
+ * @param settings The settings to cook with
+ * @param pool The pool to run the work on
+ *
+ * @returns The number of textures written
+ */
+int cookBatch(std::vector<CookJob>& jobs, const CookerSettings& settings, ThreadPool& pool) {
+    std::vector<std::future<void>> tasks;
+    for (CookJob& job : jobs) {
+        tasks.push_back(pool.Submit([&job, &settings]() {
+            loadJob(job, settings);
+        }));
+    }
+    for (auto& task : tasks) {
+        task.get();
+    }
+
+    tasks.clear();
+    for (CookJob& job : jobs) {
+        if (job.failed) {
+            continue;
+        }
+        for (size_t i = 0; i < job.mips.size(); i++) {
+            const MipLevel& mip = job.mips[i];
+            unsigned char* blocks = job.levels[i].data();
+            int rows = (mip.height + 3) / 4;
+            for (int first = 0; first < rows; first += BAND_ROWS) {
+                int last = std::min(first + BAND_ROWS, rows);
+                tasks.push_back(pool.Submit([&job, &mip, blocks, first, last]() {
+                    EncodeBlockRows(job.format, mip.pixels.data(), mip.width, mip.height, first, last, blocks);
+                }));
+            }
+        }
+    }
+    for (auto& task : tasks) {
+        task.get();
+    }
+
+    const char* formatNames[] = {"BC1", "BC5", "BC7"};
+    int written = 0;
+    for (CookJob& job : jobs) {
+        if (job.failed) {
+            continue;
+        }
+        if (CompressedTexture::WriteKTX2(job.outputPath, job.vkFormat, job.mips[0].width, job.mips[0].height, job.levels)) {
+            std::cout << "  " << job.outputPath << " (" << formatNames[job.format] << ", "
+                << job.mips[0].width << "x" << job.mips[0].height << ", " << job.levels.size() << " levels)" << std::endl;
+            written++;
+        }
+        job.mips.clear();
+        job.levels.clear();
+    }
+    return written;
+}
+
+/**
+ * Cooks the textures of models, or images given directly, into KTX2
+ * files next to the images. The textures of a model are found through
+ * the same material traversal the engine loads them with.
+ */
+int main(int argc, char** argv) {
+    CookerSettings settings;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--format" && i + 1 < argc) {
+            settings.format = argv[++i];
+        } else if (argument == "--threads" && i + 1 < argc) {
+            settings.threads = std::stoi(argv[++i]);
+        } else if (argument == "--linear") {
+            settings.linear = true;
+        } else if (argument == "--no-flip") {
+            settings.flip = false;
+        } else if (argument == "--force") {
+            settings.force = true;
+        } else {
+            inputs.push_back(argument);
+        }
+    }
+    bool validFormat = settings.format == "auto" || settings.format == "bc1" ||
+        settings.format == "bc5" || settings.format == "bc7";
+    if (inputs.empty() || !validFormat) {
+        std::cout << "Usage: texture_cooker [options] <model or image>..." << std::endl;
+        std::cout << "  --format auto|bc1|bc5|bc7  block format, auto picks per texture" << std::endl;
+        std::cout << "  --linear                   treat color as linear instead of sRGB" << std::endl;
+        std::cout << "  --no-flip                  keep the first row at the top" << std::endl;
+        std::cout << "  --force                    cook textures that are up to date" << std::endl;
+        std::cout << "  --threads <count>          threads to use, all cores by default" << std::endl;
+        return -1;
+    }
+
+    // Rows are flipped as the engine flips decoded images
+    stbi_set_flip_vertically_on_load(settings.flip);
+
+    // Gather the images in order, each one once
+    std::vector<CookJob> jobs;
+    std::unordered_set<std::string> seen;
+    int skipped = 0;
+    auto addImage = [&](const std::string& path, const std::string& type) {
+        std::error_code error;
+        std::string key = std::filesystem::weakly_canonical(path, error).generic_string();
+        if (!seen.insert(error ? path : key).second) {
+            return;
+        }
+        CookJob job;
+        job.sourcePath = path;
+        job.outputPath = std::filesystem::path(path).replace_extension(".ktx2").string();
+        job.type = type;
+        std::error_code sourceError;
+        std::error_code outputError;
+        auto sourceTime = std::filesystem::last_write_time(path, sourceError);
+        auto outputTime = std::filesystem::last_write_time(job.outputPath, outputError);
+        if (!settings.force && !sourceError && !outputError && outputTime >= sourceTime) {
+            skipped++;
+            return;
+        }
+        jobs.push_back(std::move(job));
+    };
+    for (const std::string& input : inputs) {
+        if (isImage(input)) {
+            addImage(input, "texture_diffuse");
+            continue;
+        }
+        std::string directory = input.substr(0, input.find_last_of('/'));
+        for (const Texture& texture : Model::GetMaterialTextures(input)) {
+            addImage(directory + '/' + texture.path, texture.type);
+        }
+    }
+
+    unsigned int threads = settings.threads ? settings.threads : std::max(std::thread::hardware_concurrency(), 1u);
+    ThreadPool pool(threads);
+    std::cout << "Cooking " << jobs.size() << " textures on " << pool.GetThreadCount() << " threads" << std::endl;
+
+    // Batches bound the memory held by decoded images and mips
+    auto start = std::chrono::steady_clock::now();
+    int written = 0;
+    size_t batchSize = pool.GetThreadCount() * 2;
+    for (size_t first = 0; first < jobs.size(); first += batchSize) {
+        std::vector<CookJob> batch(std::make_move_iterator(jobs.begin() + first),
+            std::make_move_iterator(jobs.begin() + std::min(first + batchSize, jobs.size())));
+        written += cookBatch(batch, settings, pool);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "Cooked " << written << " textures in " << std::chrono::duration<double, std::milli>(end - start).count()
+        << " ms, " << skipped << " up to date" << std::endl;
+    return written == (int)jobs.size() ? 0 : -1;
+}